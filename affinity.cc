@@ -0,0 +1,146 @@
+#include "affinity.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace arrow
+{
+    namespace internal
+    {
+        namespace
+        {
+            // Parse a kernel cpulist such as "0-3,8,10-11"
+            std::vector<int> ParseCpuList(const std::string &list)
+            {
+                std::vector<int> cpus;
+                std::stringstream ss(list);
+                std::string range;
+                while (std::getline(ss, range, ','))
+                {
+                    try
+                    {
+                        auto dash = range.find('-');
+                        int first = std::stoi(range.substr(0, dash));
+                        int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+                        for (int cpu = first; cpu <= last; ++cpu)
+                        {
+                            cpus.push_back(cpu);
+                        }
+                    }
+                    catch (...)
+                    {
+                    }
+                }
+                return cpus;
+            }
+
+            // cpu -> node, read once from sysfs
+            struct NumaTopology
+            {
+                NumaTopology()
+                {
+#ifdef __linux__
+                    for (int node = 0;; ++node)
+                    {
+                        std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) +
+                                         "/cpulist");
+                        std::string list;
+                        if (!in || !std::getline(in, list))
+                        {
+                            break;
+                        }
+                        for (int cpu : ParseCpuList(list))
+                        {
+                            if (cpu >= static_cast<int>(cpu_nodes.size()))
+                            {
+                                cpu_nodes.resize(cpu + 1, 0);
+                            }
+                            cpu_nodes[cpu] = node;
+                        }
+                        num_nodes = node + 1;
+                    }
+#endif
+                }
+
+                int num_nodes = 1;
+                std::vector<int> cpu_nodes;
+            };
+
+            const NumaTopology &GetNumaTopology()
+            {
+                static const NumaTopology topology;
+                return topology;
+            }
+        }
+
+        std::vector<int> GetAllowedCpus()
+        {
+            std::vector<int> cpus;
+#ifdef __linux__
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            if (sched_getaffinity(0, sizeof(set), &set) == 0)
+            {
+                for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+                {
+                    if (CPU_ISSET(cpu, &set))
+                    {
+                        cpus.push_back(cpu);
+                    }
+                }
+            }
+#endif
+            if (cpus.empty())
+            {
+                const int n = static_cast<int>(std::thread::hardware_concurrency());
+                for (int cpu = 0; cpu < n; ++cpu)
+                {
+                    cpus.push_back(cpu);
+                }
+            }
+            return cpus;
+        }
+
+        int GetNumaNodeCount() { return GetNumaTopology().num_nodes; }
+
+        int GetCpuNumaNode(int cpu)
+        {
+            const auto &cpu_nodes = GetNumaTopology().cpu_nodes;
+            if (cpu < 0 || cpu >= static_cast<int>(cpu_nodes.size()))
+            {
+                return 0;
+            }
+            return cpu_nodes[cpu];
+        }
+
+        Status SetCurrentThreadAffinity(const std::vector<int> &cpus)
+        {
+#ifdef __linux__
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for (int cpu : cpus)
+            {
+                if (cpu < 0 || cpu >= CPU_SETSIZE)
+                {
+                    return Status::Invalid("CPU index out of range: " + std::to_string(cpu));
+                }
+                CPU_SET(cpu, &set);
+            }
+            if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+            {
+                return Status::Invalid("failed setting thread affinity");
+            }
+            return Status::OK();
+#else
+            return Status::Invalid("thread affinity is not supported on this platform");
+#endif
+        }
+    }
+}
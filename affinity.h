@@ -0,0 +1,25 @@
+#pragma once
+
+#include <vector>
+
+#include "status.h"
+#include "visibility.h"
+
+namespace arrow
+{
+    namespace internal
+    {
+        // CPUs the process may run on (sched_getaffinity, which containers
+        // restrict), in increasing order. Falls back to all online CPUs.
+        ARROW_EXPORT std::vector<int> GetAllowedCpus();
+
+        // Number of NUMA nodes, at least 1
+        ARROW_EXPORT int GetNumaNodeCount();
+
+        // NUMA node of a CPU, 0 if unknown
+        ARROW_EXPORT int GetCpuNumaNode(int cpu);
+
+        // Restrict the calling thread to the given CPUs
+        ARROW_EXPORT Status SetCurrentThreadAffinity(const std::vector<int> &cpus);
+    }
+}
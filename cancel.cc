@@ -1,6 +1,8 @@
 #include <atomic>
+#include <condition_variable>
 #include <mutex>
 #include "cancel.h"
+#include <thread>
 #include <utility>
 #include <sstream>
 
@@ -8,29 +10,96 @@
 
 namespace arrow
 {
+    struct StopCallbackNode
+    {
+        explicit StopCallbackNode(internal::FnOnce<void(const Status &)> cb) : callback(std::move(cb)) {}
+
+        internal::FnOnce<void(const Status &)> callback;
+        StopCallbackNode *prev = nullptr;
+        StopCallbackNode *next = nullptr;
+        bool linked = false;
+    };
 
-#if ATOMIC_INT_LOCK_FREE != 2
-#endif
     struct StopSourceImpl
     {
+        void Link(StopCallbackNode *node)
+        {
+            node->next = callbacks_;
+            if (callbacks_ != nullptr)
+            {
+                callbacks_->prev = node;
+            }
+            callbacks_ = node;
+            node->linked = true;
+        }
+
+        void Unlink(StopCallbackNode *node)
+        {
+            if (node->prev != nullptr)
+            {
+                node->prev->next = node->next;
+            }
+            else
+            {
+                callbacks_ = node->next;
+            }
+            if (node->next != nullptr)
+            {
+                node->next->prev = node->prev;
+            }
+            node->prev = node->next = nullptr;
+            node->linked = false;
+        }
+
+        // Called once the flag is set
+        void RunCallbacks(const Status &st)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (StopCallbackNode *node = callbacks_)
+            {
+                Unlink(node);
+                running_ = node;
+                running_thread_ = std::this_thread::get_id();
+                // The node may be freed by the callback itself
+                internal::FnOnce<void(const Status &)> callback = std::move(node->callback);
+                lock.unlock();
+                std::move(callback)(st);
+                lock.lock();
+                running_ = nullptr;
+                cv_.notify_all();
+            }
+        }
+
+        // 0, -1 after RequestStop(), or the signal number
         std::atomic<int> requested_{0};
         std::mutex mutex_;
         Status cancel_error_;
+        // Registered callbacks, guarded by mutex_
+        StopCallbackNode *callbacks_ = nullptr;
+        // The callback RequestStop() is running, and its thread; unregistering
+        // it from another thread waits on cv_
+        StopCallbackNode *running_ = nullptr;
+        std::thread::id running_thread_;
+        std::condition_variable cv_;
     };
 
     StopSource::StopSource() : impl_(new StopSourceImpl) {}
-    StopSource::_StopSource() = default;
+    StopSource::~StopSource() = default;
 
     void StopSource::RequestStop() { RequestStop(Status::Cancelled("optional cancelled")); }
     void StopSource::RequestStop(Status st)
     {
-        std::lock_guard<std::mutex> lock(impl_->mutex_);
         DCHECK_NOT_OK(st);
-        if (impl_->requested_)
         {
-            impl_->requested_ = -1;
-            impl_->cancel_error_ = std::move(st);
+            std::lock_guard<std::mutex> lock(impl_->mutex_);
+            if (impl_->requested_.load() != 0)
+            {
+                return;
+            }
+            impl_->cancel_error_ = st;
+            impl_->requested_.store(-1, std::memory_order_release);
         }
+        impl_->RunCallbacks(st);
     }
     void StopSource::RequestStopFromSignal(int signum)
     {
@@ -51,7 +120,7 @@ namespace arrow
         {
             return false;
         }
-        return impl_->requested_.load() != 0;
+        return impl_->requested_.load(std::memory_order_relaxed) != 0;
     }
 
     Status StopToken::Poll() const
@@ -60,7 +129,7 @@ namespace arrow
         {
             return Status::OK();
         }
-        if (!impl_->requested_.load())
+        if (!impl_->requested_.load(std::memory_order_acquire))
         {
             return Status::OK();
         }
@@ -75,4 +144,67 @@ namespace arrow
         return impl_->cancel_error_;
     }
 
-} 
\ No newline at end of file
+    StopRegistration StopToken::RegisterCallback(internal::FnOnce<void(const Status &)> callback) const
+    {
+        StopRegistration registration;
+        if (!impl_)
+        {
+            return registration;
+        }
+        {
+            std::lock_guard<std::mutex> lock(impl_->mutex_);
+            if (impl_->requested_.load() == 0)
+            {
+                registration.impl_ = impl_;
+                registration.node_ = new StopCallbackNode(std::move(callback));
+                impl_->Link(registration.node_);
+                return registration;
+            }
+        }
+        std::move(callback)(Poll());
+        return registration;
+    }
+
+    StopRegistration::StopRegistration(StopRegistration &&other) noexcept
+        : impl_(std::move(other.impl_)), node_(other.node_)
+    {
+        other.node_ = nullptr;
+    }
+
+    StopRegistration &StopRegistration::operator=(StopRegistration &&other) noexcept
+    {
+        if (this != &other)
+        {
+            Reset();
+            impl_ = std::move(other.impl_);
+            node_ = other.node_;
+            other.node_ = nullptr;
+        }
+        return *this;
+    }
+
+    void StopRegistration::Reset()
+    {
+        if (node_ == nullptr)
+        {
+            return;
+        }
+        {
+            std::unique_lock<std::mutex> lock(impl_->mutex_);
+            if (node_->linked)
+            {
+                impl_->Unlink(node_);
+            }
+            else if (impl_->running_ == node_ &&
+                     impl_->running_thread_ != std::this_thread::get_id())
+            {
+                impl_->cv_.wait(lock, [this]
+                                { return impl_->running_ != node_; });
+            }
+        }
+        delete node_;
+        node_ = nullptr;
+        impl_.reset();
+    }
+
+}
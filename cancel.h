@@ -3,20 +3,28 @@
 #include <functional>
 #include <memory>
 
+#include "functional.h"
 #include "status.h"
+#include "visibility.h"
 
 namespace arrow
 {
     class StopToken;
     struct StopSourceImpl;
+    struct StopCallbackNode;
 
     class ARROW_EXPORT StopSource
     {
     public:
         StopSource();
         ~StopSource();
+        // Trigger the tokens, then run the callbacks registered on them, on
+        // the calling thread; executors register one to drop their queued
+        // tasks, which may hand the tasks' own callbacks to helper threads
         void RequestStop();
         void RequestStop(Status error);
+        // Only sets the flag, as it must be async-signal-safe: callbacks do
+        // not run, and queued tasks are dropped when dequeued
         void RequestStopFromSignal(int signum);
 
         StopToken token();
@@ -25,17 +33,52 @@ namespace arrow
     protected:
         std::shared_ptr<StopSourceImpl> impl_;
     };
+
+    // A callback registered with StopToken::RegisterCallback(). Destroying it
+    // unregisters the callback, waiting for it to return if another thread
+    // is running it.
+    class ARROW_EXPORT StopRegistration
+    {
+    public:
+        StopRegistration() = default;
+        StopRegistration(StopRegistration &&other) noexcept;
+        StopRegistration &operator=(StopRegistration &&other) noexcept;
+        ~StopRegistration() { Reset(); }
+
+        StopRegistration(const StopRegistration &) = delete;
+        StopRegistration &operator=(const StopRegistration &) = delete;
+
+        // Unregister now
+        void Reset();
+
+    private:
+        friend class StopToken;
+
+        std::shared_ptr<StopSourceImpl> impl_;
+        StopCallbackNode *node_ = nullptr;
+    };
+
     class ARROW_EXPORT StopToken
     {
     public:
         StopToken() {}
         explicit StopToken(std::shared_ptr<StopSourceImpl> impl) : impl_(std::move(impl)) {}
-        static StopToken UnStopable() { return StopToken(); }
+        static StopToken Unstoppable() { return StopToken(); }
         Status Poll() const;
+        // A single relaxed load
         bool IsStopRequested() const;
 
+        // Have `callback` called with the stop status once stop is requested,
+        // or right away if it already was. Lets a running task abort promptly
+        // instead of polling.
+        StopRegistration RegisterCallback(internal::FnOnce<void(const Status &)> callback) const;
+
+        // Identifies the source of the token while the token is alive,
+        // nullptr if unstoppable
+        const void *source() const { return impl_.get(); }
+
     protected:
         std::shared_ptr<StopSourceImpl> impl_;
     };
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <utility>
+
+#include "mpmc_queue.h"
+
+namespace arrow
+{
+    // A bounded lock-free multi-producer multi-consumer channel of T values,
+    // closed by its producers once they are done.
+    //
+    // Besides TryPush(), producers may reserve room first (TryReserve(), then
+    // PushReserved() or CancelReservation()), so that they never compute a
+    // value that has nowhere to go.
+    template <typename T>
+    class Channel
+    {
+    public:
+        // capacity must be >= 1
+        explicit Channel(size_t capacity)
+            : ring_(capacity), capacity_(capacity), free_(static_cast<int64_t>(capacity)) {}
+
+        Channel(const Channel &) = delete;
+        Channel &operator=(const Channel &) = delete;
+
+        size_t capacity() const { return capacity_; }
+        // Values ready to be popped
+        size_t size() const { return static_cast<size_t>(size_.load()); }
+        bool HasRoom() const { return free_.load() > 0; }
+
+        // Returns false, leaving value alone, if the channel is full
+        bool TryPush(T &&value)
+        {
+            if (!TryReserve())
+            {
+                return false;
+            }
+            PushReserved(std::move(value));
+            return true;
+        }
+
+        bool TryReserve() { return TryAcquire(&free_); }
+
+        void PushReserved(T &&value)
+        {
+            // The room was freed by a pop, but the ring cell we get may be that
+            // of another pop still moving its value out
+            while (!ring_.TryPush(std::move(value)))
+            {
+                std::this_thread::yield();
+            }
+            size_.fetch_add(1);
+        }
+
+        void CancelReservation() { free_.fetch_add(1); }
+
+        // Returns false if the channel is empty
+        bool TryPop(T *out)
+        {
+            if (!TryAcquire(&size_))
+            {
+                return false;
+            }
+            // Likewise, the value may be behind another push still in progress
+            while (!ring_.TryPop(out))
+            {
+                std::this_thread::yield();
+            }
+            free_.fetch_add(1);
+            return true;
+        }
+
+        // No value will be pushed anymore
+        void Close() { closed_.store(true); }
+        bool closed() const { return closed_.load(); }
+        // Closed and empty for good
+        bool Done() const { return closed_.load() && size_.load() == 0; }
+
+    private:
+        static bool TryAcquire(std::atomic<int64_t> *count)
+        {
+            int64_t value = count->load();
+            while (value > 0)
+            {
+                if (count->compare_exchange_weak(value, value - 1))
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        internal::MpmcRing<T> ring_;
+        const size_t capacity_;
+        // Room left for values, and values pushed but not popped yet. Popping
+        // (pushing) claims one of the latter (former) first.
+        alignas(64) std::atomic<int64_t> free_;
+        alignas(64) std::atomic<int64_t> size_{0};
+        std::atomic<bool> closed_{false};
+    };
+}
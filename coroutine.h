@@ -0,0 +1,296 @@
+#pragma once
+
+// C++20 coroutine integration: co_await executor->Schedule(hints) to hop onto
+// an executor, Task<T> for awaitable coroutines, and co_await on Future<T>.
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "executor.h"
+#include "future.h"
+#include "status.h"
+
+namespace arrow
+{
+    namespace internal
+    {
+        // The ScheduleAwaitable::await_suspend() call spawning the resumption
+        // of `handle` on this thread, if any
+        struct SpawningResume
+        {
+            void *handle;
+            bool dropped;
+        };
+        inline thread_local SpawningResume *t_spawning_resume = nullptr;
+
+        // Spawned task resuming a suspended coroutine. It only holds the frame
+        // handle and where to report a drop, so it fits in FnOnce's inline
+        // storage: resuming costs no allocation besides the executor's queue
+        // node. If the executor drops it, the coroutine resumes on the
+        // dropping thread with a Cancelled status, rather than leaking its
+        // frame and hanging its awaiters.
+        class ResumeTask
+        {
+        public:
+            ResumeTask(std::coroutine_handle<> handle, Status *status) : handle_(handle), status_(status) {}
+            ResumeTask(ResumeTask &&other) noexcept
+                : handle_(std::exchange(other.handle_, nullptr)), status_(other.status_) {}
+
+            ~ResumeTask()
+            {
+                if (!handle_)
+                {
+                    return;
+                }
+                std::coroutine_handle<> handle = std::exchange(handle_, nullptr);
+                *status_ = Status::Cancelled("coroutine resumption dropped by the executor");
+                SpawningResume *spawning = t_spawning_resume;
+                if (spawning != nullptr && spawning->handle == handle.address())
+                {
+                    // Dropped within Spawn(): await_suspend() resumes it
+                    spawning->dropped = true;
+                    return;
+                }
+                handle.resume();
+            }
+
+            void operator()()
+            {
+                SpawningResume *spawning = t_spawning_resume;
+                if (spawning != nullptr && spawning->handle == handle_.address())
+                {
+                    // Run within Spawn(): the coroutine moves on from that hop
+                    spawning->handle = nullptr;
+                }
+                std::exchange(handle_, nullptr).resume();
+            }
+
+        private:
+            std::coroutine_handle<> handle_;
+            Status *status_;
+        };
+
+        // Fire-and-forget coroutine, started eagerly and destroyed on completion
+        struct DetachedCoroutine
+        {
+            struct promise_type
+            {
+                DetachedCoroutine get_return_object() noexcept { return {}; }
+                std::suspend_never initial_suspend() noexcept { return {}; }
+                std::suspend_never final_suspend() noexcept { return {}; }
+                void return_void() noexcept {}
+                void unhandled_exception() noexcept { std::terminate(); }
+            };
+        };
+    }
+
+    // Awaitable suspending the current coroutine and resuming it on a worker
+    // of the executor. co_await yields the Status of the spawn; if the spawn
+    // fails the coroutine continues on the current thread. A coroutine whose
+    // task is dropped (e.g. by a non-waiting shutdown) continues on the
+    // dropping thread and gets a Cancelled status.
+    class ScheduleAwaitable
+    {
+    public:
+        ScheduleAwaitable(Executor *executor, TaskHints hints) : executor_(executor), hints_(hints) {}
+
+        bool await_ready() const noexcept { return false; }
+
+        bool await_suspend(std::coroutine_handle<> handle)
+        {
+            internal::SpawningResume spawning{handle.address(), false};
+            internal::SpawningResume *outer = std::exchange(internal::t_spawning_resume, &spawning);
+            Status st = executor_->Spawn(hints_, internal::ResumeTask(handle, &status_));
+            internal::t_spawning_resume = outer;
+            if (st.ok() && !spawning.dropped)
+            {
+                // Don't touch *this: the coroutine may already run on a worker
+                return true;
+            }
+            if (!st.ok())
+            {
+                status_ = std::move(st);
+            }
+            return false;
+        }
+
+        Status await_resume() { return std::move(status_); }
+
+    private:
+        Executor *executor_;
+        TaskHints hints_;
+        Status status_;
+    };
+
+    inline ScheduleAwaitable Executor::Schedule(TaskHints hints)
+    {
+        return ScheduleAwaitable(this, hints);
+    }
+
+    // A lazily started coroutine producing a T. Awaiting it starts it and
+    // resumes the awaiter when it completes; both hops use symmetric transfer,
+    // so deep await chains run in constant stack space (provided the compiler
+    // emits the transfer as a tail call, as GCC and Clang do when optimizing).
+    template <typename T = void>
+    class Task
+    {
+    public:
+        struct promise_type;
+        using Handle = std::coroutine_handle<promise_type>;
+
+        struct PromiseBase
+        {
+            struct FinalAwaiter
+            {
+                bool await_ready() const noexcept { return false; }
+                template <typename Promise>
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+                {
+                    return handle.promise().continuation_;
+                }
+                void await_resume() noexcept {}
+            };
+
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            FinalAwaiter final_suspend() noexcept { return {}; }
+            void unhandled_exception() noexcept { exception_ = std::current_exception(); }
+
+            std::coroutine_handle<> continuation_ = std::noop_coroutine();
+            std::exception_ptr exception_;
+        };
+
+        struct ValuePromise : PromiseBase
+        {
+            template <typename U>
+            void return_value(U &&value)
+            {
+                value_.emplace(std::forward<U>(value));
+            }
+            T Take()
+            {
+                if (this->exception_)
+                {
+                    std::rethrow_exception(this->exception_);
+                }
+                return std::move(*value_);
+            }
+
+            std::optional<T> value_;
+        };
+
+        struct VoidPromise : PromiseBase
+        {
+            void return_void() noexcept {}
+            void Take()
+            {
+                if (this->exception_)
+                {
+                    std::rethrow_exception(this->exception_);
+                }
+            }
+        };
+
+        struct promise_type : std::conditional<std::is_void<T>::value, VoidPromise, ValuePromise>::type
+        {
+            Task get_return_object() noexcept { return Task(Handle::from_promise(*this)); }
+        };
+
+        Task(Task &&other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+        Task &operator=(Task &&other) noexcept
+        {
+            if (this != &other)
+            {
+                if (handle_)
+                {
+                    handle_.destroy();
+                }
+                handle_ = std::exchange(other.handle_, nullptr);
+            }
+            return *this;
+        }
+        ~Task()
+        {
+            if (handle_)
+            {
+                handle_.destroy();
+            }
+        }
+
+        auto operator co_await() && noexcept
+        {
+            struct Awaiter
+            {
+                bool await_ready() const noexcept { return false; }
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept
+                {
+                    handle.promise().continuation_ = awaiter;
+                    return handle;
+                }
+                T await_resume() { return handle.promise().Take(); }
+
+                Handle handle;
+            };
+            return Awaiter{handle_};
+        }
+
+        // Start the task on the current thread and return a future of its result
+        Future<T> ToFuture(Executor *executor = nullptr) &&
+        {
+            Future<T> future = Future<T>::Make(executor);
+            RunToFuture(std::move(*this), future);
+            return future;
+        }
+
+    private:
+        explicit Task(Handle handle) : handle_(handle) {}
+
+        static internal::DetachedCoroutine RunToFuture(Task task, Future<T> future)
+        {
+            try
+            {
+                if constexpr (std::is_void<T>::value)
+                {
+                    co_await std::move(task);
+                    future.MarkFinished();
+                }
+                else
+                {
+                    future.template MarkFinished<T>(co_await std::move(task));
+                }
+            }
+            catch (...)
+            {
+                future.MarkFinishedWithException(std::current_exception());
+            }
+        }
+
+        Handle handle_;
+    };
+
+    // co_await on a Future<T> yields its value (rethrowing on error), by
+    // value; the coroutine is resumed on the future's executor.
+    template <typename T>
+    auto operator co_await(Future<T> future)
+    {
+        struct Awaiter
+        {
+            bool await_ready() const { return future.is_finished(); }
+            void await_suspend(std::coroutine_handle<> handle)
+            {
+                future.OnComplete([handle](const Future<T> &)
+                                  { handle.resume(); });
+            }
+            T await_resume() { return std::move(future).get(); }
+
+            Future<T> future;
+        };
+        return Awaiter{std::move(future)};
+    }
+}
+
+#endif
@@ -1,22 +1,47 @@
 
 #pragma once
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
 #include "cancel.h"
+#include "functional.h"
+#include "future.h"
 #include "status.h"
+#include "visibility.h"
 
 namespace arrow
 {
+    class ScheduleAwaitable;
+
     struct TaskHints
     {
         int32_t priority = 0;
         int64_t io_size = -1;
         int64_t cpu_cost = -1;
+        // Tasks with the same id >= 0 run one at a time, in submission order,
+        // on executors that support it (ThreadPool)
         int64_t external_id = -1;
+        // Preferred NUMA node, see ThreadPool::SetAffinity()
+        int32_t numa_node = -1;
+        // Tenants >= 0 share the executor fairly with each other, whatever
+        // the number of tasks they queue, on executors that support it
+        // (ThreadPool, see SetTenantOptions())
+        int64_t tenant_id = -1;
     };
 
     class ARROW_EXPORT Executor
     {
     public:
         using StopCallback = internal::FnOnce<void(const Status &)>;
+        using TimerClock = std::chrono::steady_clock;
 
         virtual ~Executor();
 
@@ -54,54 +79,38 @@ namespace arrow
 
         template <typename Function, typename... Args,
                   typename ReturnType = typename std::result_of<Function(Args...)>::type>
-        std::future<ReturnType> Submit(TaskHints hints, StopToken stop_token,
-                                       StopCallback stop_callback, Function &&func,
-                                       Args &&...args)
+        Future<ReturnType> Submit(TaskHints hints, StopToken stop_token,
+                                  StopCallback stop_callback, Function &&func, Args &&...args)
         {
-            /**
-             * std::promise 和 std::future 提供了一种方便的方式，
-             * 在异步编程中进行线程间通信和结果传递。生产者线程使用 std::promise 设置结果或异常，
-             * 而消费者线程使用 std::future 获取结果或异常。
-             * 这种机制使得异步操作的结果可以方便地传递给其他线程进行处理。
-             */
-            std::promise<ReturnType> promise;
-            std::future<ReturnType> future = promise.get_future();
+            Future<ReturnType> future = Future<ReturnType>::Make(this);
             auto task = [func = std::forward<Function>(func),
                          tup = std::make_tuple(std::forward<Args>(args)...),
-                         promise = std::move(promise)]() mutable
+                         completer = FutureCompleter<ReturnType>(future)]() mutable
             {
-                try
-                {
-                    if constexpr (!std::is_void_v<ReturnType>)
-                    {
-                        ReturnType result = std::apply(std::move(func), std::move(tup));
-                        promise.set_value(result);
-                    }
-                    else
-                    {
-                        // 用于将一个函数和一组参数打包为一个
-                        // std::tuple，然后通过调用该函数来应用这组参数
-                        std::apply(std::move(func),
-                                   std::move(tup));
-                    }
-                }
-                catch (...)
+                completer.future.FinishWith([&]() -> decltype(auto)
+                                            { return std::apply(std::move(func), std::move(tup)); });
+            };
+            // If the task is cancelled, finish the future with the cancellation error
+            StopCallback on_stop = [future, stop_callback = std::move(stop_callback)](
+                                       const Status &st) mutable
+            {
+                if (stop_callback)
                 {
-                    promise.set_exception(std::current_exception());
+                    std::move(stop_callback)(st);
                 }
+                future.TryMarkFinished(st.ok() ? Status::Cancelled("task cancelled") : st);
             };
 
-            Status status = SpawnReal(hints, std::move(task), stop_token, std::move(stop_callback));
+            Status status = SpawnReal(hints, std::move(task), std::move(stop_token), std::move(on_stop));
             if (!status.ok())
             {
-                throw std::runtime_error("Failed to submit task");
+                return Future<ReturnType>::MakeFinished(std::move(status), this);
             }
-
             return future;
         }
         template <typename Function, typename... Args,
                   typename ReturnType = typename std::result_of<Function(Args...)>::type>
-        std::future<ReturnType> Submit(StopToken stop_token, Function &&func, Args &&...args)
+        Future<ReturnType> Submit(StopToken stop_token, Function &&func, Args &&...args)
         {
             return Submit(TaskHints{}, stop_token, StopCallback{}, std::forward<Function>(func),
                           std::forward<Args>(args)...);
@@ -109,7 +118,7 @@ namespace arrow
 
         template <typename Function, typename... Args,
                   typename ReturnType = typename std::result_of<Function(Args...)>::type>
-        std::future<ReturnType> Submit(TaskHints hints, Function &&func, Args &&...args)
+        Future<ReturnType> Submit(TaskHints hints, Function &&func, Args &&...args)
         {
             return Submit(std::move(hints), StopToken::Unstoppable(), StopCallback{},
                           std::forward<Function>(func), std::forward<Args>(args)...);
@@ -117,7 +126,7 @@ namespace arrow
 
         template <typename Function, typename... Args,
                   typename ReturnType = typename std::result_of<Function(Args...)>::type>
-        std::future<ReturnType> Submit(StopCallback stop_callback, Function &&func,
+        Future<ReturnType> Submit(StopCallback stop_callback, Function &&func,
                                        Args &&...args)
         {
             return Submit(TaskHints{}, StopToken::Unstoppable(), stop_callback,
@@ -126,14 +135,175 @@ namespace arrow
 
         template <typename Function, typename... Args,
                   typename ReturnType = typename std::result_of<Function(Args...)>::type>
-        std::future<ReturnType> Submit(Function &&func, Args &&...args)
+        Future<ReturnType> Submit(Function &&func, Args &&...args)
         {
             return Submit(TaskHints{}, StopToken::Unstoppable(), StopCallback{},
                           std::forward<Function>(func), std::forward<Args>(args)...);
         }
 
+        // Spawn func once `delay` has elapsed, or at `deadline`. A timer whose
+        // stop token is triggered before it is due never fires.
+        template <typename Function>
+        Status SpawnAfter(TaskHints hints, TimerClock::duration delay, Function &&func,
+                          StopToken stop_token = StopToken::Unstoppable())
+        {
+            return SpawnAtReal(hints, TimerClock::now() + delay, std::forward<Function>(func),
+                               std::move(stop_token));
+        }
+        template <typename Function>
+        Status SpawnAfter(TimerClock::duration delay, Function &&func,
+                          StopToken stop_token = StopToken::Unstoppable())
+        {
+            return SpawnAfter(TaskHints{}, delay, std::forward<Function>(func), std::move(stop_token));
+        }
+        template <typename Function>
+        Status SpawnAt(TaskHints hints, TimerClock::time_point deadline, Function &&func,
+                       StopToken stop_token = StopToken::Unstoppable())
+        {
+            return SpawnAtReal(hints, deadline, std::forward<Function>(func), std::move(stop_token));
+        }
+        template <typename Function>
+        Status SpawnAt(TimerClock::time_point deadline, Function &&func,
+                       StopToken stop_token = StopToken::Unstoppable())
+        {
+            return SpawnAt(TaskHints{}, deadline, std::forward<Function>(func), std::move(stop_token));
+        }
+        // Spawn func every `period`, starting one period from now, until
+        // stop_token is triggered. Runs do not overlap: the next one is
+        // scheduled when the current one returns, skipping missed periods.
+        template <typename Function>
+        Status SpawnEvery(TaskHints hints, TimerClock::duration period, Function &&func,
+                          StopToken stop_token = StopToken::Unstoppable())
+        {
+            return SpawnEveryReal(hints, period, std::forward<Function>(func), std::move(stop_token));
+        }
+        template <typename Function>
+        Status SpawnEvery(TimerClock::duration period, Function &&func,
+                          StopToken stop_token = StopToken::Unstoppable())
+        {
+            return SpawnEvery(TaskHints{}, period, std::forward<Function>(func), std::move(stop_token));
+        }
+
+        // A task with its own hints and cancellation, as passed to SpawnBatch()
+        struct BatchTask
+        {
+            TaskHints hints;
+            internal::FnOnce<void()> callable;
+            StopToken stop_token = StopToken::Unstoppable();
+            StopCallback stop_callback;
+        };
+
+        // Spawn several tasks at once. Executors may amortize locking and
+        // wakeups over the whole batch.
+        Status SpawnBatch(std::vector<BatchTask> tasks)
+        {
+            return SpawnBatchReal(std::move(tasks));
+        }
+
+        // Spawn each callable in [begin, end) with the same hints and stop token
+        template <typename Iterator>
+        Status SpawnBatch(TaskHints hints, Iterator begin, Iterator end,
+                          StopToken stop_token = StopToken::Unstoppable())
+        {
+            std::vector<BatchTask> tasks;
+            tasks.reserve(std::distance(begin, end));
+            for (; begin != end; ++begin)
+            {
+                tasks.push_back({hints, std::move(*begin), stop_token, StopCallback{}});
+            }
+            return SpawnBatchReal(std::move(tasks));
+        }
+
+        template <typename Iterator>
+        Status SpawnBatch(Iterator begin, Iterator end)
+        {
+            return SpawnBatch(TaskHints{}, begin, end);
+        }
+
+        // Submit each callable in [begin, end) and return one future per callable.
+        // If spawning fails part way, the tasks already spawned still run and
+        // the futures of the others finish as cancelled.
+        template <typename Iterator,
+                  typename Function = typename std::iterator_traits<Iterator>::value_type,
+                  typename ReturnType = typename std::result_of<Function()>::type>
+        std::vector<Future<ReturnType>> SubmitBatch(TaskHints hints, Iterator begin, Iterator end,
+                                                    StopToken stop_token = StopToken::Unstoppable())
+        {
+            std::vector<Future<ReturnType>> futures;
+            std::vector<BatchTask> tasks;
+            futures.reserve(std::distance(begin, end));
+            tasks.reserve(std::distance(begin, end));
+            for (; begin != end; ++begin)
+            {
+                Future<ReturnType> future = Future<ReturnType>::Make(this);
+                futures.push_back(future);
+                auto task = [func = std::move(*begin),
+                             completer = FutureCompleter<ReturnType>(future)]() mutable
+                {
+                    completer.future.FinishWith([&]() -> decltype(auto)
+                                                { return std::move(func)(); });
+                };
+                StopCallback on_stop = [future](const Status &st) mutable
+                {
+                    future.TryMarkFinished(st.ok() ? Status::Cancelled("task cancelled") : st);
+                };
+                tasks.push_back({hints, std::move(task), stop_token, std::move(on_stop)});
+            }
+            // The tasks not spawned finish their futures through their completers
+            ARROW_UNUSED(SpawnBatchReal(std::move(tasks)));
+            return futures;
+        }
+
+        template <typename Iterator,
+                  typename Function = typename std::iterator_traits<Iterator>::value_type,
+                  typename ReturnType = typename std::result_of<Function()>::type>
+        std::vector<Future<ReturnType>> SubmitBatch(Iterator begin, Iterator end)
+        {
+            return SubmitBatch(TaskHints{}, begin, end);
+        }
+
+        // co_await executor->Schedule(hints) resumes the calling coroutine on
+        // this executor (defined in coroutine.h, C++20 only)
+        ScheduleAwaitable Schedule(TaskHints hints = {});
+
+        // Return the level of parallelism (the number of tasks that may be
+        // executed concurrently), 1 unless the executor tells
+        virtual int GetCapacity() { return 1; }
+
+        // Run one queued task on the calling thread if the executor lets the
+        // caller help, return false if nothing was run. Waiters such as
+        // TaskGroup::Wait() use this to make progress instead of blocking.
+        virtual bool RunPendingTask() { return false; }
+
         // Subclassing API
         virtual Status SpawnReal(TaskHints hints, internal::FnOnce<void()> task, StopToken,
                                  StopCallback &&) = 0;
+        // Defaults to calling SpawnReal() for each task, stopping at the first error
+        virtual Status SpawnBatchReal(std::vector<BatchTask> tasks);
+        // Timers are not supported by default
+        virtual Status SpawnAtReal(TaskHints hints, TimerClock::time_point deadline,
+                                   internal::FnOnce<void()> task, StopToken stop_token);
+        virtual Status SpawnEveryReal(TaskHints hints, TimerClock::duration period,
+                                      std::function<void()> task, StopToken stop_token);
+
+    protected:
+        // Owned by a submitted task: finishes the future as cancelled if the
+        // task is destroyed without having run (e.g. dropped by a shutdown),
+        // unless its stop callback already did.
+        template <typename T>
+        struct FutureCompleter
+        {
+            explicit FutureCompleter(Future<T> f) : future(std::move(f)) {}
+            FutureCompleter(FutureCompleter &&) noexcept = default;
+            ~FutureCompleter()
+            {
+                if (future.valid())
+                {
+                    future.TryMarkFinished(Status::Cancelled("task was dropped before running"));
+                }
+            }
+
+            Future<T> future;
+        };
     };
 }
\ No newline at end of file
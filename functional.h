@@ -1,5 +1,11 @@
 #pragma once
 
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
 namespace arrow
 {
     namespace internal
@@ -7,42 +13,167 @@ namespace arrow
         template <typename Signature>
         class FnOnce;
 
-        template <typename R, typename A>
-        class FnOnce<R(A)...>
+        // A move-only callable that can be invoked at most once.
+        //
+        // Callables up to kInlineSize bytes (which covers a lambda capturing a
+        // handful of pointers) are stored inline, larger or throwing-move ones
+        // fall back to the heap. Dispatch goes through a static per-type vtable
+        // instead of a virtual base class.
+        template <typename R, typename... A>
+        class FnOnce<R(A...)>
         {
         public:
+            static constexpr size_t kInlineSize = 48;
+
             FnOnce() = default;
+
             template <typename Fn,
                       typename = typename std::enable_if<std::is_convertible<
-                          decltype(std::declval<Fn &&>()(std : declval<A>()...)), R>::value>::type>
-            FnOnce(Fn fn) : impl_(new FnImpl<Fn>(std::move(fn)))
+                          decltype(std::declval<Fn &&>()(std::declval<A>()...)), R>::value>::type>
+            FnOnce(Fn fn)
+            {
+                if constexpr (kStoredInline<Fn>)
+                {
+                    ::new (static_cast<void *>(storage_)) Fn(std::move(fn));
+                    vtable_ = &kInlineVTable<Fn>;
+                }
+                else
+                {
+                    ::new (static_cast<void *>(storage_)) Fn *(new Fn(std::move(fn)));
+                    vtable_ = &kHeapVTable<Fn>;
+                }
+            }
+
+            FnOnce(FnOnce &&other) noexcept : vtable_(other.vtable_)
+            {
+                if (vtable_ != nullptr)
+                {
+                    vtable_->relocate(storage_, other.storage_);
+                    other.vtable_ = nullptr;
+                }
+            }
+
+            FnOnce &operator=(FnOnce &&other) noexcept
             {
+                if (this != &other)
+                {
+                    Reset();
+                    vtable_ = other.vtable_;
+                    if (vtable_ != nullptr)
+                    {
+                        vtable_->relocate(storage_, other.storage_);
+                        other.vtable_ = nullptr;
+                    }
+                }
+                return *this;
             }
-            explicit operator bool() const { return impl_ != nullptr; }
+
+            FnOnce(const FnOnce &) = delete;
+            FnOnce &operator=(const FnOnce &) = delete;
+
+            ~FnOnce() { Reset(); }
+
+            explicit operator bool() const { return vtable_ != nullptr; }
+
+            // Identifies the type of the stored callable, nullptr if empty
+            const void *target_type() const { return vtable_; }
+
             R operator()(A... a) &&
             {
-                auto bye = std::move(impl_);
-                return bye->invoke(std::forward<A &&>(a)...);
+                // The callable is destroyed by invoke(), even if it throws
+                const VTable *bye = vtable_;
+                vtable_ = nullptr;
+                return bye->invoke(storage_, std::forward<A &&>(a)...);
             }
 
         private:
-            struct Impl
+            struct VTable
             {
-                virtual ~Impl() = default;
-                virtual R invoke(A &&...a) = 0;
+                R (*invoke)(void *, A &&...);
+                // Move-construct into dst and destroy src
+                void (*relocate)(void *dst, void *src) noexcept;
+                void (*destroy)(void *) noexcept;
             };
+
+            template <typename Fn>
+            static constexpr bool kStoredInline =
+                sizeof(Fn) <= kInlineSize && alignof(Fn) <= alignof(std::max_align_t) &&
+                std::is_nothrow_move_constructible<Fn>::value;
+
             template <typename Fn>
-            struct FnImpl : Impl
+            static Fn *InlineTarget(void *s)
             {
-                explicit FnImpl(Fn fn) : fn_(std::move(fn)) {}
-                // 用于显式地指示当前函数是覆盖（override）基类中的虚函数
-                // std::move 用于将对象的所有权从一个对象转移到另一个对象，标记对象为右值。
-                // std::forward 用于在函数模板中进行完美转发，保持参数的值类别不变
-                R invoke(A &&...a) override { return std::move(fn_)(std::forward<A &&>(a)...); }
-                Fn fn_;
-            };
+                return std::launder(static_cast<Fn *>(s));
+            }
+
+            template <typename Fn>
+            static Fn *&HeapTarget(void *s)
+            {
+                return *std::launder(static_cast<Fn **>(s));
+            }
+
+            template <typename Fn>
+            static R InvokeInline(void *s, A &&...a)
+            {
+                struct Destroy
+                {
+                    Fn *fn;
+                    ~Destroy() { fn->~Fn(); }
+                } guard{InlineTarget<Fn>(s)};
+                return std::move(*guard.fn)(std::forward<A &&>(a)...);
+            }
+
+            template <typename Fn>
+            static void RelocateInline(void *dst, void *src) noexcept
+            {
+                Fn *fn = InlineTarget<Fn>(src);
+                ::new (dst) Fn(std::move(*fn));
+                fn->~Fn();
+            }
+
+            template <typename Fn>
+            static void DestroyInline(void *s) noexcept
+            {
+                InlineTarget<Fn>(s)->~Fn();
+            }
+
+            template <typename Fn>
+            static R InvokeHeap(void *s, A &&...a)
+            {
+                std::unique_ptr<Fn> fn(HeapTarget<Fn>(s));
+                return std::move(*fn)(std::forward<A &&>(a)...);
+            }
+
+            template <typename Fn>
+            static void RelocateHeap(void *dst, void *src) noexcept
+            {
+                ::new (dst) Fn *(HeapTarget<Fn>(src));
+            }
+
+            template <typename Fn>
+            static void DestroyHeap(void *s) noexcept
+            {
+                delete HeapTarget<Fn>(s);
+            }
+
+            template <typename Fn>
+            static constexpr VTable kInlineVTable = {&InvokeInline<Fn>, &RelocateInline<Fn>,
+                                                     &DestroyInline<Fn>};
+            template <typename Fn>
+            static constexpr VTable kHeapVTable = {&InvokeHeap<Fn>, &RelocateHeap<Fn>,
+                                                   &DestroyHeap<Fn>};
+
+            void Reset()
+            {
+                if (vtable_ != nullptr)
+                {
+                    vtable_->destroy(storage_);
+                    vtable_ = nullptr;
+                }
+            }
 
-            std::unique_ptr<Impl> impl_;
+            const VTable *vtable_ = nullptr;
+            alignas(std::max_align_t) unsigned char storage_[kInlineSize];
         };
     }
-}
\ No newline at end of file
+}
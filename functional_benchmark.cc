@@ -0,0 +1,119 @@
+// Measures heap allocations made by the submitting thread per FnOnce and per
+// ThreadPool::Spawn, for a small (inline) and a large (heap) capture.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include "functional.h"
+#include "macros.h"
+#include "thread_pool.h"
+
+namespace
+{
+    thread_local int64_t thread_allocations = 0;
+}
+
+void *operator new(std::size_t size)
+{
+    ++thread_allocations;
+    if (void *p = std::malloc(size))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+namespace arrow
+{
+    namespace
+    {
+        constexpr int kIterations = 100000;
+
+        struct SmallCapture
+        {
+            void *a;
+            void *b;
+            std::atomic<int64_t> *counter;
+        };
+
+        struct LargeCapture
+        {
+            char payload[256];
+            std::atomic<int64_t> *counter;
+        };
+
+        template <typename Capture>
+        void BenchmarkFnOnce(const char *name)
+        {
+            std::atomic<int64_t> counter{0};
+            Capture capture{};
+            capture.counter = &counter;
+
+            const int64_t before = thread_allocations;
+            const auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < kIterations; ++i)
+            {
+                internal::FnOnce<void()> fn([capture]
+                                            { capture.counter->fetch_add(1, std::memory_order_relaxed); });
+                internal::FnOnce<void()> moved(std::move(fn));
+                std::move(moved)();
+            }
+            const auto elapsed = std::chrono::steady_clock::now() - start;
+            const int64_t allocations = thread_allocations - before;
+
+            std::printf("FnOnce/%s: %.3f allocs/call, %.1f ns/call\n", name,
+                        static_cast<double>(allocations) / kIterations,
+                        std::chrono::duration<double, std::nano>(elapsed).count() / kIterations);
+        }
+
+        template <typename Capture>
+        void BenchmarkSpawn(ThreadPool *pool, const char *name)
+        {
+            std::atomic<int64_t> counter{0};
+            Capture capture{};
+            capture.counter = &counter;
+
+            // Warm up so that worker threads and queue buffers are in place
+            for (int i = 0; i < 1000; ++i)
+            {
+                DCHECK_OK(pool->Spawn([capture]
+                                      { capture.counter->fetch_add(1, std::memory_order_relaxed); }));
+            }
+            pool->WaitForIdle();
+
+            const int64_t before = thread_allocations;
+            const auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < kIterations; ++i)
+            {
+                DCHECK_OK(pool->Spawn([capture]
+                                      { capture.counter->fetch_add(1, std::memory_order_relaxed); }));
+            }
+            const int64_t allocations = thread_allocations - before;
+            pool->WaitForIdle();
+            const auto elapsed = std::chrono::steady_clock::now() - start;
+
+            std::printf("Spawn/%s: %.3f allocs/spawn, %.1f ns/spawn\n", name,
+                        static_cast<double>(allocations) / kIterations,
+                        std::chrono::duration<double, std::nano>(elapsed).count() / kIterations);
+        }
+    }
+}
+
+int main()
+{
+    using namespace arrow;
+    BenchmarkFnOnce<SmallCapture>("small_capture");
+    BenchmarkFnOnce<LargeCapture>("large_capture");
+
+    auto pool = *ThreadPool::Make(4);
+    BenchmarkSpawn<SmallCapture>(pool.get(), "small_capture");
+    BenchmarkSpawn<LargeCapture>(pool.get(), "large_capture");
+    DCHECK_OK(pool->Shutdown());
+    return 0;
+}
@@ -0,0 +1,122 @@
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+#include "functional.h"
+#include "test_util.h"
+
+namespace arrow
+{
+    namespace internal
+    {
+        namespace
+        {
+            struct Counts
+            {
+                int live = 0;
+                int moves = 0;
+                int calls = 0;
+            };
+
+            // A callable of at least Size bytes counting its instances, moves
+            // and calls; NothrowMove false sends it to the heap whatever its size
+            template <size_t Size, bool NothrowMove = true>
+            struct Counted
+            {
+                explicit Counted(Counts *counts) : counts(counts) { ++counts->live; }
+                Counted(Counted &&other) noexcept(NothrowMove) : counts(other.counts)
+                {
+                    ++counts->live;
+                    ++counts->moves;
+                }
+                ~Counted() { --counts->live; }
+
+                int operator()(int x)
+                {
+                    ++counts->calls;
+                    return x + 1;
+                }
+
+                Counts *counts;
+                char padding[Size] = {};
+            };
+
+            // Moves of the callable when moving the FnOnce holding it
+            template <typename Fn>
+            int MovesOnRelocation()
+            {
+                Counts counts;
+                FnOnce<int(int)> fn{Fn(&counts)};
+                const int moves = counts.moves;
+                FnOnce<int(int)> moved(std::move(fn));
+                ASSERT_FALSE(fn);
+                ASSERT_TRUE(moved);
+                ASSERT_EQ(1, counts.live);
+                ASSERT_EQ(42, std::move(moved)(41));
+                ASSERT_EQ(0, counts.live);
+                return counts.moves - moves;
+            }
+        }
+
+        TEST(FnOnce, SmallCallablesAreStoredInline)
+        {
+            // Relocated along with the FnOnce
+            ASSERT_EQ(1, MovesOnRelocation<Counted<8>>());
+        }
+
+        TEST(FnOnce, LargeOrThrowingCallablesAreStoredOnTheHeap)
+        {
+            // Only the pointer moves
+            ASSERT_EQ(0, MovesOnRelocation<Counted<FnOnce<void()>::kInlineSize + 1>>());
+            ASSERT_EQ(0, (MovesOnRelocation<Counted<8, /*NothrowMove=*/false>>()));
+        }
+
+        TEST(FnOnce, CallDestroysTheCallable)
+        {
+            Counts counts;
+            FnOnce<int(int)> fn{Counted<8>(&counts)};
+            ASSERT_EQ(1, counts.live);
+            ASSERT_EQ(42, std::move(fn)(41));
+            ASSERT_EQ(1, counts.calls);
+            ASSERT_EQ(0, counts.live);
+            ASSERT_FALSE(fn);
+        }
+
+        TEST(FnOnce, DestroyWithoutCalling)
+        {
+            Counts small_counts;
+            Counts large_counts;
+            {
+                FnOnce<int(int)> small{Counted<8>(&small_counts)};
+                FnOnce<int(int)> large{Counted<256>(&large_counts)};
+            }
+            ASSERT_EQ(0, small_counts.live);
+            ASSERT_EQ(0, large_counts.live);
+            ASSERT_EQ(0, small_counts.calls + large_counts.calls);
+        }
+
+        TEST(FnOnce, MoveAssignmentReplacesTheCallable)
+        {
+            Counts old_counts;
+            Counts new_counts;
+            FnOnce<int(int)> fn{Counted<8>(&old_counts)};
+            fn = FnOnce<int(int)>(Counted<256>(&new_counts));
+            ASSERT_EQ(0, old_counts.live);
+            ASSERT_EQ(1, new_counts.live);
+            fn = FnOnce<int(int)>();
+            ASSERT_FALSE(fn);
+            ASSERT_EQ(0, new_counts.live);
+        }
+
+        TEST(FnOnce, MoveOnlyCallables)
+        {
+            auto value = std::make_unique<int>(7);
+            FnOnce<int()> fn([value = std::move(value)]
+                             { return *value; });
+            FnOnce<int()> moved(std::move(fn));
+            ASSERT_EQ(7, std::move(moved)());
+        }
+    }
+}
+
+int main() { return arrow::testing::RunAllTests(); }
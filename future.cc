@@ -0,0 +1,154 @@
+#include "future.h"
+
+#include <condition_variable>
+#include <mutex>
+
+#include "executor.h"
+
+namespace arrow
+{
+    namespace internal
+    {
+        namespace
+        {
+            // Runs the callback when invoked, or when destroyed without having
+            // been invoked (the executor refused or dropped the task), so that
+            // continuations are never lost.
+            struct ScheduledCallback
+            {
+                explicit ScheduledCallback(FnOnce<void()> callback) : callback_(std::move(callback)) {}
+                ScheduledCallback(ScheduledCallback &&) noexcept = default;
+                ~ScheduledCallback()
+                {
+                    if (callback_)
+                    {
+                        std::move(callback_)();
+                    }
+                }
+
+                void operator()() { std::move(callback_)(); }
+
+                FnOnce<void()> callback_;
+            };
+
+            struct Waiter
+            {
+                std::mutex mutex;
+                std::condition_variable cv;
+                bool finished = false;
+            };
+        }
+
+        FutureStateBase::~FutureStateBase()
+        {
+            CallbackNode *node = callbacks_.load();
+            while (node != nullptr && node != Finished())
+            {
+                CallbackNode *next = node->next;
+                delete node;
+                node = next;
+            }
+        }
+
+        void FutureStateBase::RunCallback(FnOnce<void()> callback, ShouldSchedule should_schedule)
+        {
+            if (should_schedule == ShouldSchedule::Always && executor_ != nullptr)
+            {
+                ARROW_UNUSED(executor_->Spawn(ScheduledCallback(std::move(callback))));
+            }
+            else
+            {
+                std::move(callback)();
+            }
+        }
+
+        void FutureStateBase::AddCallback(FnOnce<void()> callback, ShouldSchedule should_schedule)
+        {
+            CallbackNode *head = callbacks_.load(std::memory_order_acquire);
+            if (head == Finished())
+            {
+                RunCallback(std::move(callback), should_schedule);
+                return;
+            }
+            auto *node = new CallbackNode{std::move(callback), should_schedule, head};
+            while (!callbacks_.compare_exchange_weak(node->next, node, std::memory_order_release,
+                                                     std::memory_order_acquire))
+            {
+                if (node->next == Finished())
+                {
+                    RunCallback(std::move(node->callback), should_schedule);
+                    delete node;
+                    return;
+                }
+            }
+        }
+
+        void FutureStateBase::Finish(Status status, std::exception_ptr exception)
+        {
+            status_ = std::move(status);
+            exception_ = std::move(exception);
+            CallbackNode *head = callbacks_.exchange(Finished(), std::memory_order_acq_rel);
+            DCHECK_EQ(head == Finished(), false);
+            // Run callbacks in registration order
+            CallbackNode *ordered = nullptr;
+            while (head != nullptr)
+            {
+                CallbackNode *next = head->next;
+                head->next = ordered;
+                ordered = head;
+                head = next;
+            }
+            while (ordered != nullptr)
+            {
+                CallbackNode *next = ordered->next;
+                RunCallback(std::move(ordered->callback), ordered->should_schedule);
+                delete ordered;
+                ordered = next;
+            }
+        }
+
+        bool FutureStateBase::Wait(double timeout_seconds) const
+        {
+            if (IsFinished())
+            {
+                return true;
+            }
+            // The waiter may outlive this call if we time out
+            auto waiter = std::make_shared<Waiter>();
+            const_cast<FutureStateBase *>(this)->AddCallback(
+                [waiter]
+                {
+                    std::lock_guard<std::mutex> lock(waiter->mutex);
+                    waiter->finished = true;
+                    waiter->cv.notify_all();
+                },
+                ShouldSchedule::Never);
+            std::unique_lock<std::mutex> lock(waiter->mutex);
+            if (timeout_seconds < 0)
+            {
+                waiter->cv.wait(lock, [&]
+                                { return waiter->finished; });
+                return true;
+            }
+            return waiter->cv.wait_for(lock, std::chrono::duration<double>(timeout_seconds),
+                                       [&]
+                                       { return waiter->finished; });
+        }
+
+        Status StatusFromException(const std::exception_ptr &exception)
+        {
+            try
+            {
+                std::rethrow_exception(exception);
+            }
+            catch (const std::exception &e)
+            {
+                return Status::UnknownError(e.what());
+            }
+            catch (...)
+            {
+                return Status::UnknownError("unknown exception");
+            }
+        }
+    }
+}
@@ -0,0 +1,563 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <future>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "functional.h"
+#include "macros.h"
+#include "status.h"
+#include "visibility.h"
+
+namespace arrow
+{
+    class Executor;
+
+    template <typename T = void>
+    class Future;
+
+    // Where OnComplete()/Then() callbacks run
+    enum class ShouldSchedule
+    {
+        // Inline, on the thread that completes the future (or registers the
+        // callback if the future is already finished)
+        Never,
+        // As a task on the future's executor, inline if it has none
+        Always,
+    };
+
+    namespace internal
+    {
+        struct Empty
+        {
+        };
+
+        template <typename T>
+        using FutureStorage = typename std::conditional<std::is_void<T>::value, Empty, T>::type;
+
+        // Shared state of a Future, reference counted intrusively. Completion
+        // and callback registration are a single atomic exchange/CAS on the
+        // callback list; only blocking waits take a mutex.
+        class ARROW_EXPORT FutureStateBase
+        {
+        public:
+            explicit FutureStateBase(Executor *executor) : executor_(executor) {}
+            virtual ~FutureStateBase();
+
+            void AddRef() { refs_.fetch_add(1, std::memory_order_relaxed); }
+            void Release()
+            {
+                if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                {
+                    delete this;
+                }
+            }
+            bool HasOneRef() const { return refs_.load(std::memory_order_acquire) == 1; }
+
+            bool IsFinished() const
+            {
+                return callbacks_.load(std::memory_order_acquire) == Finished();
+            }
+
+            // Run `callback` once the future is finished
+            void AddCallback(FnOnce<void()> callback, ShouldSchedule should_schedule);
+
+            // Take the right to finish the future, before storing the value.
+            // Only the first caller gets it.
+            bool TryClaim() { return !claimed_.exchange(true, std::memory_order_acq_rel); }
+            // Publish the outcome and run the callbacks, once claimed. The
+            // value, if any, must have been stored before.
+            void Finish(Status status, std::exception_ptr exception = nullptr);
+
+            // Claim and finish; must be the only finisher
+            void MarkFinished(Status status, std::exception_ptr exception = nullptr)
+            {
+                const bool claimed = TryClaim();
+                DCHECK_EQ(claimed, true);
+                Finish(std::move(status), std::move(exception));
+            }
+            // Claim and finish, unless another finisher claimed the future first
+            bool TryMarkFinished(Status status, std::exception_ptr exception = nullptr)
+            {
+                if (!TryClaim())
+                {
+                    return false;
+                }
+                Finish(std::move(status), std::move(exception));
+                return true;
+            }
+
+            // Block until finished, or until `timeout_seconds` elapsed if >= 0.
+            // Returns whether the future is finished.
+            bool Wait(double timeout_seconds = -1) const;
+
+            Executor *executor() const { return executor_; }
+            const Status &status() const { return status_; }
+            const std::exception_ptr &exception() const { return exception_; }
+
+        private:
+            struct CallbackNode
+            {
+                FnOnce<void()> callback;
+                ShouldSchedule should_schedule;
+                CallbackNode *next;
+            };
+
+            static CallbackNode *Finished() { return reinterpret_cast<CallbackNode *>(1); }
+            void RunCallback(FnOnce<void()> callback, ShouldSchedule should_schedule);
+
+            std::atomic<int> refs_{1};
+            // Pending callbacks (most recent first), or Finished()
+            std::atomic<CallbackNode *> callbacks_{nullptr};
+            // Set by the finisher, before it stores the outcome
+            std::atomic<bool> claimed_{false};
+            Executor *const executor_;
+            Status status_;
+            std::exception_ptr exception_;
+        };
+
+        template <typename T>
+        class FutureState : public FutureStateBase
+        {
+        public:
+            using FutureStateBase::FutureStateBase;
+
+            std::optional<FutureStorage<T>> value_;
+        };
+
+        // Result of calling a continuation with the value of a Future<T>;
+        // continuations returning Status produce a Future<>.
+        template <typename T, typename Fn>
+        struct ContinuationTraits
+        {
+            using Raw = typename std::invoke_result<Fn, const T &>::type;
+            using Result =
+                typename std::conditional<std::is_same<Raw, Status>::value, void, Raw>::type;
+        };
+
+        template <typename Fn>
+        struct ContinuationTraits<void, Fn>
+        {
+            using Raw = typename std::invoke_result<Fn>::type;
+            using Result =
+                typename std::conditional<std::is_same<Raw, Status>::value, void, Raw>::type;
+        };
+
+        ARROW_EXPORT Status StatusFromException(const std::exception_ptr &exception);
+    }
+
+    // A pool-native future. Copies share the same state. Callbacks and
+    // continuations run on the executor the future is bound to, errors are
+    // carried as Status (and, for compatibility with std::future, exceptions
+    // thrown by the task are kept and rethrown by get()).
+    template <typename T>
+    class Future
+    {
+    public:
+        using ValueType = T;
+
+        Future() = default;
+        Future(const Future &other) : state_(other.state_)
+        {
+            if (state_ != nullptr)
+            {
+                state_->AddRef();
+            }
+        }
+        Future(Future &&other) noexcept : state_(other.state_) { other.state_ = nullptr; }
+        Future &operator=(const Future &other)
+        {
+            Future(other).swap(*this);
+            return *this;
+        }
+        Future &operator=(Future &&other) noexcept
+        {
+            Future(std::move(other)).swap(*this);
+            return *this;
+        }
+        ~Future()
+        {
+            if (state_ != nullptr)
+            {
+                state_->Release();
+            }
+        }
+
+        void swap(Future &other) noexcept { std::swap(state_, other.state_); }
+
+        // A pending future whose callbacks run on `executor`
+        static Future Make(Executor *executor = nullptr)
+        {
+            return Future(new internal::FutureState<T>(executor));
+        }
+
+        static Future MakeFinished(Status status, Executor *executor = nullptr)
+        {
+            Future fut = Make(executor);
+            fut.MarkFinished(std::move(status));
+            return fut;
+        }
+
+        template <typename U = T, typename = typename std::enable_if<!std::is_void<U>::value>::type>
+        static Future MakeFinished(internal::FutureStorage<T> value, Executor *executor = nullptr)
+        {
+            Future fut = Make(executor);
+            fut.MarkFinished(std::move(value));
+            return fut;
+        }
+
+        bool valid() const { return state_ != nullptr; }
+        bool is_finished() const { return state_->IsFinished(); }
+        Executor *executor() const { return state_->executor(); }
+
+        // Finish with an error, or successfully for Future<>
+        void MarkFinished(Status status = Status::OK())
+        {
+            const bool claimed = TryMarkFinished(std::move(status));
+            DCHECK_EQ(claimed, true);
+        }
+
+        template <typename U = T, typename = typename std::enable_if<!std::is_void<U>::value>::type>
+        void MarkFinished(internal::FutureStorage<T> value)
+        {
+            const bool claimed = TryMarkFinished<U>(std::move(value));
+            DCHECK_EQ(claimed, true);
+        }
+
+        // As MarkFinished(), but returns false, leaving the future alone, if
+        // another finisher got to it first
+        bool TryMarkFinished(Status status = Status::OK())
+        {
+            if constexpr (!std::is_void<T>::value)
+            {
+                DCHECK_NOT_OK(status);
+            }
+            if (!state_->TryClaim())
+            {
+                return false;
+            }
+            if constexpr (std::is_void<T>::value)
+            {
+                if (status.ok())
+                {
+                    state_->value_.emplace();
+                }
+            }
+            state_->Finish(std::move(status));
+            return true;
+        }
+
+        template <typename U = T, typename = typename std::enable_if<!std::is_void<U>::value>::type>
+        bool TryMarkFinished(internal::FutureStorage<T> value)
+        {
+            if (!state_->TryClaim())
+            {
+                return false;
+            }
+            state_->value_.emplace(std::move(value));
+            state_->Finish(Status::OK());
+            return true;
+        }
+
+        void MarkFinishedWithException(std::exception_ptr exception)
+        {
+            state_->MarkFinished(internal::StatusFromException(exception), exception);
+        }
+
+        // Finish with the outcome of another, finished, future
+        void MarkFinishedFrom(const Future &other)
+        {
+            const bool claimed = state_->TryClaim();
+            DCHECK_EQ(claimed, true);
+            if (other.state_->status().ok())
+            {
+                state_->value_ = other.state_->value_;
+            }
+            state_->Finish(other.state_->status(), other.state_->exception());
+        }
+
+        // Finish with the error, and exception if any, of another, failed,
+        // future of another type
+        template <typename U, typename = typename std::enable_if<!std::is_same<U, T>::value>::type>
+        void MarkFinishedFrom(const Future<U> &other)
+        {
+            DCHECK_NOT_OK(other.state_->status());
+            state_->MarkFinished(other.state_->status(), other.state_->exception());
+        }
+
+        void Wait() const { state_->Wait(); }
+        // Returns whether the future finished within `seconds`
+        bool Wait(double seconds) const { return state_->Wait(seconds); }
+
+        const Status &status() const
+        {
+            Wait();
+            return state_->status();
+        }
+
+        template <typename U = T, typename = typename std::enable_if<!std::is_void<U>::value>::type>
+        const U &value() const
+        {
+            Wait();
+            if (!state_->status().ok())
+            {
+                state_->status().Abort("Future::value() called on a failed future");
+            }
+            return *state_->value_;
+        }
+
+        // std::future compatible accessors
+        void wait() const { Wait(); }
+
+        template <typename Rep, typename Period>
+        std::future_status wait_for(const std::chrono::duration<Rep, Period> &timeout) const
+        {
+            return Wait(std::chrono::duration<double>(timeout).count()) ? std::future_status::ready
+                                                                        : std::future_status::timeout;
+        }
+
+        // Wait and return the value, rethrowing the task's exception or throwing
+        // std::runtime_error on error. The reference lives as long as the
+        // future's state; see the rvalue overload for temporaries.
+        decltype(auto) get() const &
+        {
+            WaitAndThrowIfFailed();
+            if constexpr (!std::is_void<T>::value)
+            {
+                return static_cast<const T &>(*state_->value_);
+            }
+        }
+
+        // As get(), but returns the value itself, moved out of the state when
+        // no other future shares it (or T cannot be copied), so that it works
+        // for move-only types and on temporaries
+        T get() &&
+        {
+            WaitAndThrowIfFailed();
+            if constexpr (!std::is_void<T>::value)
+            {
+                if constexpr (std::is_copy_constructible<T>::value)
+                {
+                    if (!state_->HasOneRef())
+                    {
+                        return *state_->value_;
+                    }
+                }
+                return std::move(*state_->value_);
+            }
+        }
+
+        // Call fn(const Future&) once finished
+        template <typename Fn>
+        void OnComplete(Fn fn, ShouldSchedule should_schedule = ShouldSchedule::Always) const
+        {
+            state_->AddCallback(
+                [self = *this, fn = std::move(fn)]() mutable
+                { fn(self); },
+                should_schedule);
+        }
+
+        // Call fn(value) (fn() for Future<>) once finished successfully and
+        // return a future of its result. Errors skip fn and propagate.
+        template <typename Fn,
+                  typename Result = typename internal::ContinuationTraits<T, Fn>::Result>
+        Future<Result> Then(Fn fn, ShouldSchedule should_schedule = ShouldSchedule::Always) const
+        {
+            Future<Result> next = Future<Result>::Make(executor());
+            OnComplete(
+                [next, fn = std::move(fn)](const Future &self) mutable
+                {
+                    if (!self.state_->status().ok())
+                    {
+                        next.state_->MarkFinished(self.state_->status(), self.state_->exception());
+                        return;
+                    }
+                    next.FinishWith(
+                        [&]() -> decltype(auto)
+                        {
+                            if constexpr (std::is_void<T>::value)
+                            {
+                                return fn();
+                            }
+                            else
+                            {
+                                return fn(static_cast<const T &>(*self.state_->value_));
+                            }
+                        });
+                },
+                should_schedule);
+            return next;
+        }
+
+        // Finish with the result of thunk(), capturing Status and exceptions
+        template <typename Thunk>
+        void FinishWith(Thunk &&thunk)
+        {
+            using Raw = decltype(thunk());
+            try
+            {
+                if constexpr (!std::is_void<T>::value)
+                {
+                    MarkFinished<T>(thunk());
+                }
+                else if constexpr (std::is_same<Raw, Status>::value)
+                {
+                    MarkFinished(thunk());
+                }
+                else
+                {
+                    thunk();
+                    MarkFinished();
+                }
+            }
+            catch (...)
+            {
+                MarkFinishedWithException(std::current_exception());
+            }
+        }
+
+    private:
+        template <typename U>
+        friend class Future;
+
+        void WaitAndThrowIfFailed() const
+        {
+            Wait();
+            if (!state_->status().ok())
+            {
+                if (state_->exception())
+                {
+                    std::rethrow_exception(state_->exception());
+                }
+                throw std::runtime_error(state_->status().ToString());
+            }
+        }
+
+        explicit Future(internal::FutureState<T> *state) : state_(state) {}
+
+        internal::FutureState<T> *state_ = nullptr;
+    };
+
+    // A future finishing with all the values once all `futures` succeeded, or
+    // with the first error
+    template <typename T, typename = typename std::enable_if<!std::is_void<T>::value>::type>
+    Future<std::vector<T>> All(std::vector<Future<T>> futures)
+    {
+        if (futures.empty())
+        {
+            return Future<std::vector<T>>::MakeFinished(std::vector<T>{});
+        }
+        struct AllState
+        {
+            std::vector<Future<T>> futures;
+            std::atomic<size_t> remaining;
+            Future<std::vector<T>> out;
+        };
+        auto state = std::make_shared<AllState>();
+        state->remaining = futures.size();
+        state->out = Future<std::vector<T>>::Make(futures.front().executor());
+        state->futures = std::move(futures);
+        for (const auto &fut : state->futures)
+        {
+            fut.OnComplete(
+                [state](const Future<T> &)
+                {
+                    if (state->remaining.fetch_sub(1) != 1)
+                    {
+                        return;
+                    }
+                    std::vector<T> values;
+                    values.reserve(state->futures.size());
+                    for (const auto &f : state->futures)
+                    {
+                        if (!f.status().ok())
+                        {
+                            state->out.MarkFinishedFrom(f);
+                            return;
+                        }
+                        values.push_back(f.value());
+                    }
+                    state->out.MarkFinished(std::move(values));
+                },
+                ShouldSchedule::Never);
+        }
+        return state->out;
+    }
+
+    inline Future<> All(std::vector<Future<>> futures)
+    {
+        if (futures.empty())
+        {
+            return Future<>::MakeFinished(Status::OK());
+        }
+        struct AllState
+        {
+            std::vector<Future<>> futures;
+            std::atomic<size_t> remaining;
+            Future<> out;
+        };
+        auto state = std::make_shared<AllState>();
+        state->remaining = futures.size();
+        state->out = Future<>::Make(futures.front().executor());
+        state->futures = std::move(futures);
+        for (const auto &fut : state->futures)
+        {
+            fut.OnComplete(
+                [state](const Future<> &)
+                {
+                    if (state->remaining.fetch_sub(1) != 1)
+                    {
+                        return;
+                    }
+                    for (const auto &f : state->futures)
+                    {
+                        if (!f.status().ok())
+                        {
+                            state->out.MarkFinishedFrom(f);
+                            return;
+                        }
+                    }
+                    state->out.MarkFinished();
+                },
+                ShouldSchedule::Never);
+        }
+        return state->out;
+    }
+
+    // A future finishing like the first of `futures` to finish
+    template <typename T>
+    Future<T> Any(std::vector<Future<T>> futures)
+    {
+        if (futures.empty())
+        {
+            return Future<T>::MakeFinished(Status::Invalid("Any() of no futures"));
+        }
+        struct AnyState
+        {
+            std::atomic<bool> done{false};
+            Future<T> out;
+        };
+        auto state = std::make_shared<AnyState>();
+        state->out = Future<T>::Make(futures.front().executor());
+        for (const auto &fut : futures)
+        {
+            fut.OnComplete(
+                [state](const Future<T> &self)
+                {
+                    if (!state->done.exchange(true))
+                    {
+                        state->out.MarkFinishedFrom(self);
+                    }
+                },
+                ShouldSchedule::Never);
+        }
+        return state->out;
+    }
+}
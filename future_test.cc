@@ -0,0 +1,75 @@
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "future.h"
+#include "test_util.h"
+#include "thread_pool.h"
+
+namespace arrow
+{
+    namespace
+    {
+        std::shared_ptr<ThreadPool> MakePool() { return *ThreadPool::Make(2); }
+    }
+
+    TEST(Future, AllKeepsTheException)
+    {
+        auto pool = MakePool();
+        std::vector<Future<int>> futures;
+        futures.push_back(pool->Submit([]
+                                       { return 1; }));
+        futures.push_back(pool->Submit([]() -> int
+                                       { throw std::out_of_range("out of range"); }));
+        Future<std::vector<int>> all = All(std::move(futures));
+        ASSERT_STATUS(StatusCode::UnknownError, all.status());
+        bool rethrown = false;
+        try
+        {
+            all.get();
+        }
+        catch (const std::out_of_range &)
+        {
+            rethrown = true;
+        }
+        ASSERT_TRUE(rethrown);
+    }
+
+    TEST(Future, GetOnATemporaryReturnsTheValue)
+    {
+        auto pool = MakePool();
+        std::unique_ptr<int> moved = pool->Submit([]
+                                                  { return std::make_unique<int>(7); })
+                                         .get();
+        ASSERT_EQ(7, *moved);
+
+        // Shared with another future: copied, not moved out
+        Future<std::string> fut = pool->Submit([]
+                                               { return std::string("shared"); });
+        Future<std::string> copy = fut;
+        const std::string &value = std::move(copy).get();
+        ASSERT_TRUE(value == "shared");
+        ASSERT_TRUE(fut.get() == "shared");
+    }
+
+    TEST(Future, OnlyTheFirstFinisherWins)
+    {
+        for (int round = 0; round < 1000; ++round)
+        {
+            Future<int> fut = Future<int>::Make();
+            std::atomic<int> winners{0};
+            std::thread other([&]
+                              { winners += fut.TryMarkFinished(Status::Cancelled("cancelled")); });
+            winners += fut.TryMarkFinished(round);
+            other.join();
+            ASSERT_EQ(winners.load(), 1);
+            ASSERT_TRUE(fut.is_finished());
+            ASSERT_FALSE(fut.TryMarkFinished(Status::Cancelled("late")));
+        }
+    }
+}
+
+int main() { return arrow::testing::RunAllTests(); }
@@ -1,7 +1,7 @@
 #pragma once
 
-#include<optional>
-#include <iostream>
+#include <optional>
+#include <string>
 
 #include "status.h"
 #include "visibility.h"
@@ -11,4 +11,4 @@ std::optional<std::string> GetEnvVar(const char* name);
 ARROW_EXPORT
 Status SetEnvVar(const char* name, const char* value);
 ARROW_EXPORT
-Status SetEnvVar(const std::string& name, const std::string& value);
\ No newline at end of file
+Status SetEnvVar(const std::string& name, const std::string& value);
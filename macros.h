@@ -1,4 +1,6 @@
-#pargma once
+#pragma once
+
+#include <cstdlib>
 
 #define ARROW_UNUSED(x) (void)(x)
 
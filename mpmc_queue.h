@@ -0,0 +1,152 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+
+namespace arrow
+{
+    namespace internal
+    {
+        // A bounded lock-free multi-producer multi-consumer FIFO of T values
+        // (Dmitry Vyukov's array-based queue). Each cell carries a sequence
+        // number telling producers and consumers whose turn it is, so pushes
+        // and pops only contend on their own index.
+        template <typename T>
+        class MpmcRing
+        {
+        public:
+            // capacity is rounded up to a power of two
+            explicit MpmcRing(size_t capacity)
+            {
+                size_t rounded = 2;
+                while (rounded < capacity)
+                {
+                    rounded *= 2;
+                }
+                mask_ = rounded - 1;
+                cells_.reset(new Cell[rounded]);
+                for (size_t i = 0; i < rounded; ++i)
+                {
+                    cells_[i].sequence.store(i, std::memory_order_relaxed);
+                }
+            }
+
+            ~MpmcRing()
+            {
+                const size_t end = enqueue_pos_.load(std::memory_order_relaxed);
+                for (size_t pos = dequeue_pos_.load(std::memory_order_relaxed); pos != end; ++pos)
+                {
+                    std::launder(reinterpret_cast<T *>(cells_[pos & mask_].storage))->~T();
+                }
+            }
+
+            MpmcRing(const MpmcRing &) = delete;
+            MpmcRing &operator=(const MpmcRing &) = delete;
+
+            size_t capacity() const { return mask_ + 1; }
+
+            // Returns false, leaving value alone, if the queue is full
+            bool TryPush(T &&value)
+            {
+                size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+                Cell *cell;
+                while (true)
+                {
+                    cell = &cells_[pos & mask_];
+                    const size_t seq = cell->sequence.load(std::memory_order_acquire);
+                    const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+                    if (diff == 0)
+                    {
+                        if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        {
+                            break;
+                        }
+                    }
+                    else if (diff < 0)
+                    {
+                        return false;
+                    }
+                    else
+                    {
+                        pos = enqueue_pos_.load(std::memory_order_relaxed);
+                    }
+                }
+                new (cell->storage) T(std::move(value));
+                cell->sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+
+            // Returns false if the queue is empty
+            bool TryPop(T *out)
+            {
+                size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+                Cell *cell;
+                while (true)
+                {
+                    cell = &cells_[pos & mask_];
+                    const size_t seq = cell->sequence.load(std::memory_order_acquire);
+                    const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+                    if (diff == 0)
+                    {
+                        if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        {
+                            break;
+                        }
+                    }
+                    else if (diff < 0)
+                    {
+                        return false;
+                    }
+                    else
+                    {
+                        pos = dequeue_pos_.load(std::memory_order_relaxed);
+                    }
+                }
+                T *value = std::launder(reinterpret_cast<T *>(cell->storage));
+                *out = std::move(*value);
+                value->~T();
+                cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+                return true;
+            }
+
+        private:
+            struct Cell
+            {
+                std::atomic<size_t> sequence;
+                alignas(T) unsigned char storage[sizeof(T)];
+            };
+
+            std::unique_ptr<Cell[]> cells_;
+            size_t mask_;
+            alignas(64) std::atomic<size_t> enqueue_pos_{0};
+            alignas(64) std::atomic<size_t> dequeue_pos_{0};
+        };
+
+        // An MpmcRing of T*
+        template <typename T>
+        class MpmcQueue
+        {
+        public:
+            // capacity is rounded up to a power of two
+            explicit MpmcQueue(size_t capacity) : ring_(capacity) {}
+
+            // Returns false if the queue is full
+            bool TryPush(T *item) { return ring_.TryPush(std::move(item)); }
+
+            // Returns nullptr if the queue is empty
+            T *TryPop()
+            {
+                T *item = nullptr;
+                ring_.TryPop(&item);
+                return item;
+            }
+
+        private:
+            MpmcRing<T *> ring_;
+        };
+    }
+}
@@ -0,0 +1,260 @@
+#include "parallel_for.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+
+#include "macros.h"
+
+namespace arrow
+{
+    namespace internal
+    {
+        namespace
+        {
+            // Aim for chunks well above the cost of dispatching a task
+            constexpr int64_t kTargetChunkNanos = 50000;
+            // Time spent measuring the body when no cost hint is given
+            constexpr int64_t kProbeNanos = 5000;
+
+            constexpr uint32_t kClosed = 1u << 31;
+
+            int64_t NowNanos()
+            {
+                return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::steady_clock::now().time_since_epoch())
+                    .count();
+            }
+
+            struct LoopState
+            {
+                LoopState(int64_t begin, int64_t end, int participants, ParallelChunkFn fn,
+                          void *ctx)
+                    : end_(end), participants_(participants), fn_(fn), ctx_(ctx), next_(begin)
+                {
+                }
+
+                // Set the chunk sizes for the iterations not handed out yet
+                void Partition(Partitioning partitioning, int64_t grain)
+                {
+                    partitioning_ = partitioning;
+                    grain_ = std::max<int64_t>(1, grain);
+                    const int64_t remaining = end_ - next_.load();
+                    static_chunk_ =
+                        std::max(grain_, (remaining + participants_ - 1) / participants_);
+                }
+
+                bool ClaimChunk(int64_t *chunk_begin, int64_t *chunk_end)
+                {
+                    if (stop_.load(std::memory_order_relaxed))
+                    {
+                        return false;
+                    }
+                    if (partitioning_ == Partitioning::kDynamic)
+                    {
+                        const int64_t begin = next_.fetch_add(grain_);
+                        if (begin >= end_)
+                        {
+                            return false;
+                        }
+                        *chunk_begin = begin;
+                        *chunk_end = std::min(end_, begin + grain_);
+                        return true;
+                    }
+                    int64_t begin = next_.load(std::memory_order_relaxed);
+                    while (begin < end_)
+                    {
+                        int64_t size = static_chunk_;
+                        if (partitioning_ == Partitioning::kGuided)
+                        {
+                            size = std::max(grain_, (end_ - begin) / (2 * participants_));
+                        }
+                        const int64_t end = std::min(end_, begin + size);
+                        if (next_.compare_exchange_weak(begin, end))
+                        {
+                            *chunk_begin = begin;
+                            *chunk_end = end;
+                            return true;
+                        }
+                    }
+                    return false;
+                }
+
+                // Run [begin, end) right away on the calling thread
+                bool RunChunk(int participant, int64_t begin, int64_t end)
+                {
+                    try
+                    {
+                        if (!fn_(ctx_, participant, begin, end))
+                        {
+                            stop_ = true;
+                            return false;
+                        }
+                        return true;
+                    }
+                    catch (...)
+                    {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        if (!error_)
+                        {
+                            error_ = std::current_exception();
+                        }
+                        stop_ = true;
+                        return false;
+                    }
+                }
+
+                void Run(int participant)
+                {
+                    int64_t begin, end;
+                    while (ClaimChunk(&begin, &end) && RunChunk(participant, begin, end))
+                    {
+                    }
+                }
+
+                // Register a helper, unless the calling thread has already finished
+                bool Enter(int *participant)
+                {
+                    uint32_t entered = entered_.load();
+                    do
+                    {
+                        if (entered & kClosed)
+                        {
+                            return false;
+                        }
+                    } while (!entered_.compare_exchange_weak(entered, entered + 1));
+                    *participant = next_participant_.fetch_add(1);
+                    return true;
+                }
+
+                void Leave()
+                {
+                    if (entered_.fetch_sub(1) == (kClosed | 1))
+                    {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        cv_.notify_one();
+                    }
+                }
+
+                // Turn away helpers that have not started yet and wait for the
+                // ones that are running chunks.
+                void CloseAndWait()
+                {
+                    if (entered_.fetch_or(kClosed) != 0)
+                    {
+                        std::unique_lock<std::mutex> lock(mutex_);
+                        cv_.wait(lock, [this]
+                                 { return entered_.load() == kClosed; });
+                    }
+                }
+
+                const int64_t end_;
+                const int participants_;
+                const ParallelChunkFn fn_;
+                void *const ctx_;
+
+                Partitioning partitioning_ = Partitioning::kDynamic;
+                int64_t grain_ = 1;
+                int64_t static_chunk_ = 1;
+
+                std::atomic<int64_t> next_;
+                std::atomic<bool> stop_{false};
+                // Number of running helpers, plus kClosed once the caller is done
+                std::atomic<uint32_t> entered_{0};
+                std::atomic<int> next_participant_{1};
+
+                std::mutex mutex_;
+                std::condition_variable cv_;
+                std::exception_ptr error_;
+            };
+        }
+
+        int ParallelParticipants(Executor *executor, const ParallelOptions &options)
+        {
+            int participants = executor != nullptr ? executor->GetCapacity() : 1;
+            if (options.max_parallelism > 0)
+            {
+                participants = std::min(participants, options.max_parallelism);
+            }
+            return std::max(1, participants);
+        }
+
+        void ParallelLoop(Executor *executor, int64_t begin, int64_t end,
+                          const ParallelOptions &options, int participants, ParallelChunkFn fn,
+                          void *ctx)
+        {
+            if (begin >= end)
+            {
+                return;
+            }
+            auto state = std::make_shared<LoopState>(begin, end, participants, fn, ctx);
+
+            int64_t grain = options.grain_size;
+            if (grain <= 0 && options.hints.cpu_cost > 0)
+            {
+                grain = kTargetChunkNanos / options.hints.cpu_cost;
+            }
+            if (grain <= 0 && participants > 1)
+            {
+                // Time exponentially growing chunks on the calling thread
+                int64_t done = 0, elapsed = 0;
+                for (int64_t size = 1; elapsed < kProbeNanos; size *= 2)
+                {
+                    const int64_t chunk_begin = state->next_.load();
+                    const int64_t chunk_end = std::min(end, chunk_begin + size);
+                    if (chunk_begin >= end)
+                    {
+                        break;
+                    }
+                    state->next_ = chunk_end;
+                    const int64_t start = NowNanos();
+                    if (!state->RunChunk(0, chunk_begin, chunk_end))
+                    {
+                        break;
+                    }
+                    elapsed += NowNanos() - start;
+                    done += chunk_end - chunk_begin;
+                }
+                grain = kTargetChunkNanos * done / std::max<int64_t>(1, elapsed);
+            }
+            state->Partition(options.partitioning, grain);
+
+            const int64_t remaining = end - state->next_.load();
+            const int64_t chunks = (remaining + state->grain_ - 1) / state->grain_;
+            const int helpers = static_cast<int>(std::min<int64_t>(participants - 1, chunks - 1));
+            if (helpers > 0 && !state->stop_)
+            {
+                std::vector<Executor::BatchTask> tasks;
+                tasks.reserve(helpers);
+                for (int i = 0; i < helpers; ++i)
+                {
+                    Executor::BatchTask task;
+                    task.hints = options.hints;
+                    task.callable = [state]
+                    {
+                        int participant;
+                        if (state->Enter(&participant))
+                        {
+                            state->Run(participant);
+                            state->Leave();
+                        }
+                    };
+                    tasks.push_back(std::move(task));
+                }
+                // If spawning fails the calling thread simply does all the work
+                ARROW_UNUSED(executor->SpawnBatch(std::move(tasks)));
+            }
+
+            state->Run(0);
+            state->CloseAndWait();
+            if (state->error_)
+            {
+                std::rethrow_exception(state->error_);
+            }
+        }
+    }
+}
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <iterator>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "executor.h"
+#include "status.h"
+#include "visibility.h"
+
+namespace arrow
+{
+    // How a parallel loop range is split into chunks
+    enum class Partitioning
+    {
+        // One chunk per participant
+        kStatic,
+        // Chunks of grain_size iterations
+        kDynamic,
+        // Chunks proportional to the remaining work, never below grain_size
+        kGuided,
+    };
+
+    struct ParallelOptions
+    {
+        Partitioning partitioning = Partitioning::kGuided;
+        // Minimum number of iterations per chunk, 0 to choose automatically:
+        // from hints.cpu_cost (estimated nanoseconds per iteration) if given,
+        // otherwise by timing the first iterations on the calling thread.
+        int64_t grain_size = 0;
+        // Maximum number of threads working on the loop, the calling thread
+        // included. 0 means the executor's capacity.
+        int max_parallelism = 0;
+        // Hints for the helper tasks spawned on the executor
+        TaskHints hints;
+    };
+
+    namespace internal
+    {
+        // Run chunk [begin, end) on behalf of `participant`, return false to
+        // stop handing out further chunks.
+        using ParallelChunkFn = bool (*)(void *ctx, int participant, int64_t begin, int64_t end);
+
+        // Number of participants a loop run with these options may use
+        ARROW_EXPORT int ParallelParticipants(Executor *executor, const ParallelOptions &options);
+
+        // Run [begin, end) in chunks on the calling thread (participant 0) and on
+        // helper tasks spawned on `executor`. Helpers that have not started by
+        // the time the calling thread runs out of chunks do nothing, so this
+        // never waits on queued tasks and is safe to call from a pool worker.
+        // Exceptions thrown by `fn` are rethrown on the calling thread.
+        ARROW_EXPORT void ParallelLoop(Executor *executor, int64_t begin, int64_t end,
+                                       const ParallelOptions &options, int participants,
+                                       ParallelChunkFn fn, void *ctx);
+
+        // Pads per-participant state to its own cache line
+        template <typename T>
+        struct alignas(64) ParallelSlot
+        {
+            std::optional<T> value;
+        };
+    }
+
+    // Call body(i) for each i in [begin, end). body may return void or Status;
+    // the first error stops the loop and is returned.
+    template <typename Body>
+    Status ParallelFor(Executor *executor, int64_t begin, int64_t end, Body &&body,
+                       const ParallelOptions &options = {})
+    {
+        using BodyResult = decltype(body(begin));
+        struct Context
+        {
+            Body &body;
+            std::atomic<bool> failed;
+            Status status;
+        } ctx{body, {false}, Status::OK()};
+
+        const int participants = internal::ParallelParticipants(executor, options);
+        internal::ParallelLoop(
+            executor, begin, end, options, participants,
+            [](void *raw, int, int64_t chunk_begin, int64_t chunk_end) -> bool
+            {
+                auto *ctx = static_cast<Context *>(raw);
+                for (int64_t i = chunk_begin; i < chunk_end; ++i)
+                {
+                    if constexpr (std::is_same<BodyResult, Status>::value)
+                    {
+                        Status st = ctx->body(i);
+                        if (!st.ok())
+                        {
+                            if (!ctx->failed.exchange(true))
+                            {
+                                ctx->status = std::move(st);
+                            }
+                            return false;
+                        }
+                    }
+                    else
+                    {
+                        ctx->body(i);
+                    }
+                }
+                return true;
+            },
+            &ctx);
+        return ctx.status;
+    }
+
+    // Call body(*it) for each element of the random-access range [first, last)
+    template <typename Iterator, typename Body>
+    Status ParallelForEach(Executor *executor, Iterator first, Iterator last, Body &&body,
+                           const ParallelOptions &options = {})
+    {
+        static_assert(std::is_base_of<std::random_access_iterator_tag,
+                                      typename std::iterator_traits<Iterator>::iterator_category>::value,
+                      "ParallelForEach requires random-access iterators");
+        return ParallelFor(
+            executor, 0, static_cast<int64_t>(std::distance(first, last)),
+            [&](int64_t i)
+            { return body(first[i]); },
+            options);
+    }
+
+    // Store fn(*it) into the output range starting at `out` for each element of
+    // the random-access range [first, last)
+    template <typename InputIterator, typename OutputIterator, typename Fn>
+    Status ParallelTransform(Executor *executor, InputIterator first, InputIterator last,
+                             OutputIterator out, Fn &&fn, const ParallelOptions &options = {})
+    {
+        return ParallelFor(
+            executor, 0, static_cast<int64_t>(std::distance(first, last)),
+            [&](int64_t i)
+            { out[i] = fn(first[i]); },
+            options);
+    }
+
+    // Fold map(i) for each i in [begin, end) into `identity` with combine(T, T).
+    // Each participant folds its chunks into a private accumulator, the
+    // accumulators are then combined on the calling thread, so combine must be
+    // associative and commutative.
+    template <typename T, typename Map, typename Combine>
+    T ParallelReduce(Executor *executor, int64_t begin, int64_t end, T identity, Map &&map,
+                     Combine &&combine, const ParallelOptions &options = {})
+    {
+        const int participants = internal::ParallelParticipants(executor, options);
+        struct Context
+        {
+            Map &map;
+            Combine &combine;
+            const T &identity;
+            std::vector<internal::ParallelSlot<T>> partials;
+        } ctx{map, combine, identity, std::vector<internal::ParallelSlot<T>>(participants)};
+
+        internal::ParallelLoop(
+            executor, begin, end, options, participants,
+            [](void *raw, int participant, int64_t chunk_begin, int64_t chunk_end) -> bool
+            {
+                auto *ctx = static_cast<Context *>(raw);
+                auto &partial = ctx->partials[participant].value;
+                T acc = partial.has_value() ? std::move(*partial) : ctx->identity;
+                for (int64_t i = chunk_begin; i < chunk_end; ++i)
+                {
+                    acc = ctx->combine(std::move(acc), ctx->map(i));
+                }
+                partial = std::move(acc);
+                return true;
+            },
+            &ctx);
+
+        T result = std::move(identity);
+        for (auto &slot : ctx.partials)
+        {
+            if (slot.value.has_value())
+            {
+                result = combine(std::move(result), std::move(*slot.value));
+            }
+        }
+        return result;
+    }
+}
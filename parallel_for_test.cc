@@ -0,0 +1,207 @@
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+#include "macros.h"
+#include "parallel_for.h"
+#include "test_util.h"
+#include "thread_pool.h"
+
+namespace arrow
+{
+    namespace
+    {
+        std::shared_ptr<ThreadPool> MakePool(int threads) { return *ThreadPool::Make(threads); }
+
+        ParallelOptions Options(Partitioning partitioning, int64_t grain_size)
+        {
+            ParallelOptions options;
+            options.partitioning = partitioning;
+            options.grain_size = grain_size;
+            return options;
+        }
+
+        // Run ParallelFor over [0, n) and check every index is visited once
+        void CheckVisitsEachIndexOnce(Executor *executor, int64_t n, const ParallelOptions &options)
+        {
+            std::vector<std::atomic<int>> visits(n);
+            ASSERT_OK(ParallelFor(
+                executor, 0, n, [&](int64_t i)
+                { visits[i].fetch_add(1); },
+                options));
+            for (int64_t i = 0; i < n; ++i)
+            {
+                ASSERT_EQ(1, visits[i].load());
+            }
+        }
+    }
+
+    TEST(ParallelFor, StaticPartitioning)
+    {
+        auto pool = MakePool(4);
+        CheckVisitsEachIndexOnce(pool.get(), 10007, Options(Partitioning::kStatic, 1));
+        CheckVisitsEachIndexOnce(pool.get(), 3, Options(Partitioning::kStatic, 1));
+        ASSERT_OK(pool->Shutdown());
+    }
+
+    TEST(ParallelFor, DynamicPartitioning)
+    {
+        auto pool = MakePool(4);
+        CheckVisitsEachIndexOnce(pool.get(), 10007, Options(Partitioning::kDynamic, 64));
+        // Grain larger than the range
+        CheckVisitsEachIndexOnce(pool.get(), 10, Options(Partitioning::kDynamic, 1000));
+        ASSERT_OK(pool->Shutdown());
+    }
+
+    TEST(ParallelFor, GuidedPartitioning)
+    {
+        auto pool = MakePool(4);
+        CheckVisitsEachIndexOnce(pool.get(), 10007, Options(Partitioning::kGuided, 16));
+        CheckVisitsEachIndexOnce(pool.get(), 10007, Options(Partitioning::kGuided, 1));
+        ASSERT_OK(pool->Shutdown());
+    }
+
+    TEST(ParallelFor, AutomaticGrainSize)
+    {
+        auto pool = MakePool(4);
+        // Timed on the calling thread
+        CheckVisitsEachIndexOnce(pool.get(), 100003, Options(Partitioning::kDynamic, 0));
+        CheckVisitsEachIndexOnce(pool.get(), 100003, Options(Partitioning::kGuided, 0));
+        // Derived from the cost hint
+        ParallelOptions options = Options(Partitioning::kDynamic, 0);
+        options.hints.cpu_cost = 100;
+        CheckVisitsEachIndexOnce(pool.get(), 100003, options);
+        ASSERT_OK(pool->Shutdown());
+    }
+
+    TEST(ParallelFor, WithoutAnExecutor)
+    {
+        CheckVisitsEachIndexOnce(nullptr, 1000, ParallelOptions());
+    }
+
+    TEST(ParallelFor, EmptyAndNegativeRanges)
+    {
+        auto pool = MakePool(2);
+        std::atomic<int> calls{0};
+        auto body = [&](int64_t)
+        { calls.fetch_add(1); };
+        ASSERT_OK(ParallelFor(pool.get(), 5, 5, body));
+        ASSERT_OK(ParallelFor(pool.get(), 5, -5, body));
+        ASSERT_EQ(0, calls.load());
+
+        // Negative bounds are fine as long as begin < end
+        std::vector<std::atomic<int>> visits(20);
+        ASSERT_OK(ParallelFor(pool.get(), -10, 10, [&](int64_t i)
+                              { visits[i + 10].fetch_add(1); }));
+        for (auto &v : visits)
+        {
+            ASSERT_EQ(1, v.load());
+        }
+        ASSERT_EQ(7, ParallelReduce(
+                         pool.get(), 3, -3, 7, [](int64_t)
+                         { return 1; },
+                         [](int a, int b)
+                         { return a + b; }));
+        ASSERT_OK(pool->Shutdown());
+    }
+
+    TEST(ParallelFor, ErrorStopsTheLoop)
+    {
+        auto pool = MakePool(4);
+        const int64_t n = 1000000;
+        std::atomic<int64_t> calls{0};
+        Status st = ParallelFor(
+            pool.get(), 0, n, [&](int64_t i) -> Status
+            {
+                calls.fetch_add(1);
+                if (i == 100)
+                {
+                    return Status::Invalid("bad index");
+                }
+                return Status::OK(); },
+            Options(Partitioning::kDynamic, 1));
+        ASSERT_STATUS(StatusCode::INVALID, st);
+        ASSERT_TRUE(calls.load() < n);
+        ASSERT_OK(pool->Shutdown());
+    }
+
+    TEST(ParallelFor, ExceptionIsRethrown)
+    {
+        auto pool = MakePool(4);
+        bool caught = false;
+        try
+        {
+            ARROW_UNUSED(ParallelFor(
+                pool.get(), 0, 100000, [](int64_t i)
+                {
+                    if (i == 5000)
+                    {
+                        throw std::runtime_error("boom");
+                    } },
+                Options(Partitioning::kGuided, 1)));
+        }
+        catch (const std::runtime_error &)
+        {
+            caught = true;
+        }
+        ASSERT_TRUE(caught);
+        ASSERT_OK(pool->Shutdown());
+    }
+
+    TEST(ParallelForEach, VisitsEachElement)
+    {
+        auto pool = MakePool(4);
+        std::vector<int> values(5000, 1);
+        ASSERT_OK(ParallelForEach(pool.get(), values.begin(), values.end(), [](int &v)
+                                  { v *= 3; }));
+        ASSERT_EQ(15000, std::accumulate(values.begin(), values.end(), 0));
+
+        Status st = ParallelForEach(pool.get(), values.begin(), values.end(), [](int &v) -> Status
+                                    { return v == 3 ? Status::Invalid("three") : Status::OK(); });
+        ASSERT_STATUS(StatusCode::INVALID, st);
+        ASSERT_OK(pool->Shutdown());
+    }
+
+    TEST(ParallelTransform, WritesEachOutput)
+    {
+        auto pool = MakePool(4);
+        std::vector<int> in(5000);
+        std::iota(in.begin(), in.end(), 0);
+        std::vector<int64_t> out(in.size(), -1);
+        ASSERT_OK(ParallelTransform(
+            pool.get(), in.begin(), in.end(), out.begin(), [](int v)
+            { return int64_t{v} * v; },
+            Options(Partitioning::kStatic, 0)));
+        for (size_t i = 0; i < in.size(); ++i)
+        {
+            ASSERT_EQ(int64_t(i) * int64_t(i), out[i]);
+        }
+        ASSERT_OK(pool->Shutdown());
+    }
+
+    TEST(ParallelReduce, SumsTheRange)
+    {
+        auto pool = MakePool(4);
+        const int64_t n = 100000;
+        for (Partitioning partitioning :
+             {Partitioning::kStatic, Partitioning::kDynamic, Partitioning::kGuided})
+        {
+            for (int64_t grain : {int64_t{0}, int64_t{1}, int64_t{257}})
+            {
+                const int64_t sum = ParallelReduce(
+                    pool.get(), 0, n, int64_t{0}, [](int64_t i)
+                    { return i; },
+                    [](int64_t a, int64_t b)
+                    { return a + b; },
+                    Options(partitioning, grain));
+                ASSERT_EQ(n * (n - 1) / 2, sum);
+            }
+        }
+        ASSERT_OK(pool->Shutdown());
+    }
+}
+
+int main() { return arrow::testing::RunAllTests(); }
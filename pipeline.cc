@@ -0,0 +1,288 @@
+#include "pipeline.h"
+
+#include <exception>
+#include <mutex>
+#include <vector>
+
+#include "macros.h"
+
+namespace arrow
+{
+    struct Pipeline::State : std::enable_shared_from_this<State>
+    {
+        struct Stage
+        {
+            std::unique_ptr<internal::PipelineStage> impl;
+            StageOptions options;
+            bool has_output = false;
+            int upstream = -1;
+            int downstream = -1;
+            // Activations spawned and not ended yet
+            std::atomic<int> active{0};
+            std::atomic<bool> finished{false};
+        };
+
+        // A spawned activation of a stage. If the executor drops it without
+        // running it, the pipeline fails, but the activation still ends.
+        struct Activation
+        {
+            Activation(std::shared_ptr<State> state, int stage) : state(std::move(state)), stage(stage) {}
+            Activation(Activation &&) noexcept = default;
+
+            ~Activation()
+            {
+                if (state)
+                {
+                    state->Fail(Status::Cancelled("pipeline activation dropped by the executor"));
+                    state->EndActivation(stage);
+                }
+            }
+
+            void operator()()
+            {
+                std::shared_ptr<State> self = std::move(state);
+                self->RunActivation(stage);
+            }
+
+            std::shared_ptr<State> state;
+            int stage;
+        };
+
+        explicit State(Executor *executor)
+            : executor_(executor), stop_token_(stop_source_.token()), done_(Future<>::Make(executor)) {}
+
+        void Start(const StopToken &stop_token);
+        // Spawn activations while the stage has input and room, or finish it
+        // once its input is done (or the pipeline stopped) and no activation
+        // is left
+        void TryActivate(int index);
+        void RunActivation(int index);
+        void EndActivation(int index);
+        void Finish(int index);
+        // Record the first error and stop the pipeline
+        void Fail(const Status &status);
+
+        Executor *const executor_;
+        std::vector<std::unique_ptr<Stage>> stages_;
+        // First error found while adding stages
+        Status build_status_;
+        bool started_ = false;
+
+        // Stages not finished yet
+        std::atomic<int> remaining_{0};
+        StopSource stop_source_;
+        const StopToken stop_token_;
+        StopRegistration caller_stop_;
+        std::mutex mutex_;
+        Status status_;
+        Future<> done_;
+    };
+
+    void Pipeline::State::Start(const StopToken &stop_token)
+    {
+        remaining_.store(static_cast<int>(stages_.size()));
+        caller_stop_ = stop_token.RegisterCallback([this](const Status &status)
+                                                   { Fail(status); });
+        for (size_t i = 0; i < stages_.size(); ++i)
+        {
+            TryActivate(static_cast<int>(i));
+        }
+    }
+
+    void Pipeline::State::TryActivate(int index)
+    {
+        Stage &stage = *stages_[index];
+        // The channel counters and `active` are sequentially consistent: a
+        // stage either sees the items (room) a neighbour made, or the
+        // neighbour sees it active and the ending activation checks again
+        while (true)
+        {
+            if (stop_token_.IsStopRequested() || stage.impl->InputDone())
+            {
+                // Only now, as an activation may have taken the last item
+                if (stage.active.load() == 0)
+                {
+                    Finish(index);
+                }
+                return;
+            }
+            int active = stage.active.load();
+            // One activation per batch of backlog
+            if (active >= stage.options.parallelism || !stage.impl->HasRoom() ||
+                stage.impl->Backlog() <= int64_t{active} * stage.options.batch_size)
+            {
+                return;
+            }
+            if (stage.active.compare_exchange_weak(active, active + 1))
+            {
+                // A dropped activation ends through its destructor
+                ARROW_UNUSED(executor_->Spawn(stage.options.hints, Activation(shared_from_this(), index),
+                                              stop_token_));
+            }
+        }
+    }
+
+    void Pipeline::State::RunActivation(int index)
+    {
+        Stage &stage = *stages_[index];
+        if (!stop_token_.IsStopRequested())
+        {
+            Status status;
+            try
+            {
+                status = stage.impl->Process(stage.options.batch_size);
+            }
+            catch (const std::exception &e)
+            {
+                status = Status::UnknownError(e.what());
+            }
+            catch (...)
+            {
+                status = Status::UnknownError("unknown exception in pipeline stage");
+            }
+            if (!status.ok())
+            {
+                Fail(status);
+            }
+        }
+        EndActivation(index);
+    }
+
+    void Pipeline::State::EndActivation(int index)
+    {
+        Stage &stage = *stages_[index];
+        stage.active.fetch_sub(1);
+        // The activation may have made room upstream and items downstream
+        if (stage.upstream >= 0)
+        {
+            TryActivate(stage.upstream);
+        }
+        if (stage.downstream >= 0)
+        {
+            TryActivate(stage.downstream);
+        }
+        TryActivate(index);
+    }
+
+    void Pipeline::State::Finish(int index)
+    {
+        Stage &stage = *stages_[index];
+        if (stage.finished.exchange(true))
+        {
+            return;
+        }
+        stage.impl->Finish();
+        if (stage.downstream >= 0)
+        {
+            TryActivate(stage.downstream);
+        }
+        if (remaining_.fetch_sub(1) == 1)
+        {
+            caller_stop_.Reset();
+            Status result;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                result = status_;
+            }
+            done_.MarkFinished(std::move(result));
+        }
+    }
+
+    void Pipeline::State::Fail(const Status &status)
+    {
+        // Stopping may drop the last activations holding the state
+        std::shared_ptr<State> self = shared_from_this();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!status_.ok())
+            {
+                return;
+            }
+            status_ = status;
+        }
+        stop_source_.RequestStop(status);
+        // Finish the idle stages, the others finish as their activations end
+        for (size_t i = 0; i < stages_.size(); ++i)
+        {
+            TryActivate(static_cast<int>(i));
+        }
+    }
+
+    Pipeline::Pipeline(Executor *executor, PipelineOptions options)
+        : options_(options), state_(std::make_shared<State>(executor)) {}
+
+    Pipeline::~Pipeline() = default;
+
+    int Pipeline::AddStage(std::unique_ptr<internal::PipelineStage> stage, bool has_input,
+                           const Pipeline *upstream_pipeline, int upstream, bool has_output,
+                           StageOptions options)
+    {
+        State *state = state_.get();
+        if (state->started_)
+        {
+            return -1;
+        }
+        const int index = static_cast<int>(state->stages_.size());
+        if (state->build_status_.ok())
+        {
+            if (options.parallelism < 1 || options.batch_size < 1)
+            {
+                state->build_status_ = Status::Invalid("pipeline stage needs parallelism and batch_size >= 1");
+            }
+            else if (has_input && (upstream_pipeline != this || upstream < 0))
+            {
+                state->build_status_ = Status::Invalid("pipeline stream empty or from another pipeline");
+            }
+            else if (upstream >= 0 && state->stages_[upstream]->downstream >= 0)
+            {
+                state->build_status_ = Status::Invalid("pipeline stream consumed twice");
+            }
+        }
+        auto record = std::make_unique<State::Stage>();
+        record->impl = std::move(stage);
+        record->options = options;
+        record->has_output = has_output;
+        if (has_input && upstream_pipeline == this && upstream >= 0 && state->stages_[upstream]->downstream < 0)
+        {
+            record->upstream = upstream;
+            state->stages_[upstream]->downstream = index;
+        }
+        state->stages_.push_back(std::move(record));
+        return index;
+    }
+
+    Future<> Pipeline::Run(StopToken stop_token)
+    {
+        State *state = state_.get();
+        Executor *executor = state->executor_;
+        if (state->started_)
+        {
+            return Future<>::MakeFinished(Status::Invalid("pipeline already ran"), executor);
+        }
+        state->started_ = true;
+        if (options_.channel_capacity < 1)
+        {
+            return Future<>::MakeFinished(Status::Invalid("pipeline channel_capacity must be >= 1"),
+                                          executor);
+        }
+        if (!state->build_status_.ok())
+        {
+            return Future<>::MakeFinished(state->build_status_, executor);
+        }
+        for (const auto &stage : state->stages_)
+        {
+            if (stage->has_output && stage->downstream < 0)
+            {
+                return Future<>::MakeFinished(Status::Invalid("pipeline stream without a consumer"),
+                                              executor);
+            }
+        }
+        if (state->stages_.empty())
+        {
+            return Future<>::MakeFinished(Status::OK(), executor);
+        }
+        Future<> done = state->done_;
+        state->Start(stop_token);
+        return done;
+    }
+}
@@ -0,0 +1,274 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "cancel.h"
+#include "channel.h"
+#include "executor.h"
+#include "future.h"
+#include "status.h"
+#include "visibility.h"
+
+namespace arrow
+{
+    class Pipeline;
+
+    struct PipelineOptions
+    {
+        // Capacity of the channels between stages, >= 1
+        size_t channel_capacity = 256;
+    };
+
+    struct StageOptions
+    {
+        // Activations of the stage that may run at once; the stage function
+        // is called concurrently when > 1
+        int parallelism = 1;
+        // Items an activation processes at most before giving the thread back
+        int batch_size = 32;
+        TaskHints hints;
+    };
+
+    namespace internal
+    {
+        // The typed half of a pipeline stage, scheduled by Pipeline
+        class PipelineStage
+        {
+        public:
+            virtual ~PipelineStage() = default;
+
+            // Items waiting for the stage, unbounded for sources until exhausted
+            virtual int64_t Backlog() const = 0;
+            // No item will come anymore
+            virtual bool InputDone() const = 0;
+            // Room in the output channel, always for sinks
+            virtual bool HasRoom() const = 0;
+            // Process up to max_items items, fewer when out of input or room
+            virtual Status Process(int max_items) = 0;
+            // Called once, after the last activation
+            virtual void Finish() = 0;
+        };
+
+        template <typename T, typename Fn>
+        class SourceStage : public PipelineStage
+        {
+        public:
+            SourceStage(Fn fn, std::shared_ptr<Channel<T>> output)
+                : fn_(std::move(fn)), output_(std::move(output)) {}
+
+            int64_t Backlog() const override
+            {
+                return exhausted_.load() ? 0 : std::numeric_limits<int64_t>::max();
+            }
+            bool InputDone() const override { return exhausted_.load(); }
+            bool HasRoom() const override { return output_->HasRoom(); }
+
+            Status Process(int max_items) override
+            {
+                for (int i = 0; i < max_items && !exhausted_.load(); ++i)
+                {
+                    if (!output_->TryReserve())
+                    {
+                        break;
+                    }
+                    std::optional<T> item = fn_();
+                    if (!item)
+                    {
+                        output_->CancelReservation();
+                        exhausted_.store(true);
+                        break;
+                    }
+                    output_->PushReserved(std::move(*item));
+                }
+                return Status::OK();
+            }
+
+            void Finish() override { output_->Close(); }
+
+        private:
+            Fn fn_;
+            std::shared_ptr<Channel<T>> output_;
+            std::atomic<bool> exhausted_{false};
+        };
+
+        template <typename In, typename Out, typename Fn>
+        class TransformStage : public PipelineStage
+        {
+        public:
+            TransformStage(Fn fn, std::shared_ptr<Channel<In>> input, std::shared_ptr<Channel<Out>> output)
+                : fn_(std::move(fn)), input_(std::move(input)), output_(std::move(output)) {}
+
+            int64_t Backlog() const override { return static_cast<int64_t>(input_->size()); }
+            bool InputDone() const override { return input_->Done(); }
+            bool HasRoom() const override { return output_->HasRoom(); }
+
+            Status Process(int max_items) override
+            {
+                for (int i = 0; i < max_items; ++i)
+                {
+                    if (!output_->TryReserve())
+                    {
+                        break;
+                    }
+                    In item;
+                    if (!input_->TryPop(&item))
+                    {
+                        output_->CancelReservation();
+                        break;
+                    }
+                    output_->PushReserved(fn_(std::move(item)));
+                }
+                return Status::OK();
+            }
+
+            void Finish() override { output_->Close(); }
+
+        private:
+            Fn fn_;
+            std::shared_ptr<Channel<In>> input_;
+            std::shared_ptr<Channel<Out>> output_;
+        };
+
+        template <typename In, typename Fn>
+        class SinkStage : public PipelineStage
+        {
+        public:
+            SinkStage(Fn fn, std::shared_ptr<Channel<In>> input)
+                : fn_(std::move(fn)), input_(std::move(input)) {}
+
+            int64_t Backlog() const override { return static_cast<int64_t>(input_->size()); }
+            bool InputDone() const override { return input_->Done(); }
+            bool HasRoom() const override { return true; }
+
+            Status Process(int max_items) override
+            {
+                for (int i = 0; i < max_items; ++i)
+                {
+                    In item;
+                    if (!input_->TryPop(&item))
+                    {
+                        break;
+                    }
+                    if constexpr (std::is_same<decltype(fn_(std::move(item))), Status>::value)
+                    {
+                        Status status = fn_(std::move(item));
+                        if (!status.ok())
+                        {
+                            return status;
+                        }
+                    }
+                    else
+                    {
+                        fn_(std::move(item));
+                    }
+                }
+                return Status::OK();
+            }
+
+            void Finish() override {}
+
+        private:
+            Fn fn_;
+            std::shared_ptr<Channel<In>> input_;
+        };
+    }
+
+    // The output of a pipeline stage, to be consumed by exactly one other
+    // stage of the same pipeline
+    template <typename T>
+    class Stream
+    {
+    public:
+        Stream() = default;
+
+    private:
+        friend class Pipeline;
+
+        Stream(const Pipeline *pipeline, int stage, std::shared_ptr<Channel<T>> channel)
+            : pipeline_(pipeline), stage_(stage), channel_(std::move(channel)) {}
+
+        const Pipeline *pipeline_ = nullptr;
+        int stage_ = -1;
+        std::shared_ptr<Channel<T>> channel_;
+    };
+
+    // Chains of streaming stages (source -> transforms -> sink) connected by
+    // bounded channels, run as executor tasks rather than threads, so that
+    // many pipelines can share one pool.
+    //
+    // A stage is activated, as a task processing up to batch_size items, only
+    // while it has input and its output channel has room, with up to
+    // `parallelism` activations at once. An activation ending wakes its
+    // neighbours: downstream for the items it pushed, upstream for the room
+    // it freed. A full channel thus stalls its producers without holding any
+    // thread, back to the source. Items of one stage keep their order only
+    // when its parallelism, and that of the stages before it, is 1.
+    //
+    // The first error returned (by sinks) or thrown by a stage function, or
+    // the triggering of the run's stop token, stops the pipeline; items still
+    // in channels are dropped. Item types must be default constructible and
+    // movable.
+    class ARROW_EXPORT Pipeline
+    {
+    public:
+        explicit Pipeline(Executor *executor, PipelineOptions options = {});
+        // A running pipeline keeps running
+        ~Pipeline();
+
+        Pipeline(const Pipeline &) = delete;
+        Pipeline &operator=(const Pipeline &) = delete;
+
+        // fn() returns std::optional<T>, std::nullopt ending the stream
+        template <typename Fn, typename T = typename std::invoke_result<Fn &>::type::value_type>
+        Stream<T> AddSource(Fn fn, StageOptions options = {})
+        {
+            auto output = std::make_shared<Channel<T>>(options_.channel_capacity);
+            const int stage = AddStage(
+                std::make_unique<internal::SourceStage<T, Fn>>(std::move(fn), output), /*has_input=*/false,
+                nullptr, -1, /*has_output=*/true, options);
+            return Stream<T>(this, stage, std::move(output));
+        }
+
+        // fn(In&&) returns the item to pass on
+        template <typename In, typename Fn,
+                  typename Out = typename std::decay<typename std::invoke_result<Fn &, In &&>::type>::type>
+        Stream<Out> AddTransform(const Stream<In> &input, Fn fn, StageOptions options = {})
+        {
+            auto output = std::make_shared<Channel<Out>>(options_.channel_capacity);
+            const int stage = AddStage(
+                std::make_unique<internal::TransformStage<In, Out, Fn>>(std::move(fn), input.channel_, output),
+                /*has_input=*/true, input.pipeline_, input.stage_, /*has_output=*/true, options);
+            return Stream<Out>(this, stage, std::move(output));
+        }
+
+        // fn(In&&) may return void or Status
+        template <typename In, typename Fn>
+        void AddSink(const Stream<In> &input, Fn fn, StageOptions options = {})
+        {
+            AddStage(std::make_unique<internal::SinkStage<In, Fn>>(std::move(fn), input.channel_),
+                     /*has_input=*/true, input.pipeline_, input.stage_, /*has_output=*/false, options);
+        }
+
+        // Start the stages on the executor. The future finishes once every
+        // stage is done, with the first error. Invalid if a stream is not
+        // consumed, or consumed twice, if an option is out of range, or if the
+        // pipeline already ran. Stages cannot be added afterwards.
+        Future<> Run(StopToken stop_token = StopToken::Unstoppable());
+
+        struct State;
+
+    private:
+        // Returns the index of the new stage, -1 once running
+        int AddStage(std::unique_ptr<internal::PipelineStage> stage, bool has_input,
+                     const Pipeline *upstream_pipeline, int upstream, bool has_output, StageOptions options);
+
+        const PipelineOptions options_;
+        std::shared_ptr<State> state_;
+    };
+}
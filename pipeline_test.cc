@@ -0,0 +1,253 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "channel.h"
+#include "pipeline.h"
+#include "test_util.h"
+#include "thread_pool.h"
+
+namespace arrow
+{
+    namespace
+    {
+        std::shared_ptr<ThreadPool> MakePool() { return *ThreadPool::Make(4); }
+
+        // A source of 0, 1, ... up to `count` (forever if < 0)
+        auto Counter(int count)
+        {
+            auto next = std::make_shared<std::atomic<int>>(0);
+            return [next, count]() -> std::optional<int>
+            {
+                const int value = next->fetch_add(1);
+                if (count >= 0 && value >= count)
+                {
+                    return std::nullopt;
+                }
+                return value;
+            };
+        }
+    }
+
+    TEST(Channel, Bounded)
+    {
+        Channel<std::string> channel(3);
+        ASSERT_TRUE(channel.TryPush("a"));
+        ASSERT_TRUE(channel.TryPush("b"));
+        ASSERT_TRUE(channel.TryPush("c"));
+        std::string rejected = "d";
+        ASSERT_FALSE(channel.TryPush(std::move(rejected)));
+        ASSERT_TRUE(rejected == "d");
+        std::string out;
+        ASSERT_TRUE(channel.TryPop(&out));
+        ASSERT_TRUE(out == "a");
+        ASSERT_TRUE(channel.TryReserve());
+        ASSERT_FALSE(channel.HasRoom());
+        channel.CancelReservation();
+        ASSERT_TRUE(channel.TryPush("e"));
+        channel.Close();
+        ASSERT_FALSE(channel.Done());
+        while (channel.TryPop(&out))
+        {
+        }
+        ASSERT_TRUE(out == "e");
+        ASSERT_TRUE(channel.Done());
+    }
+
+    TEST(Pipeline, KeepsOrder)
+    {
+        auto pool = MakePool();
+        constexpr int kItems = 20000;
+        Pipeline pipeline(pool.get(), PipelineOptions{8});
+        auto source = pipeline.AddSource(Counter(kItems));
+        auto doubled = pipeline.AddTransform(source, [](int x)
+                                             { return int64_t{x} * 2; });
+        auto text = pipeline.AddTransform(doubled, [](int64_t x)
+                                          { return std::to_string(x); });
+        int64_t expected = 0;
+        bool ordered = true;
+        pipeline.AddSink(text, [&](std::string s)
+                         {
+            ordered = ordered && std::stoll(s) == expected;
+            expected += 2; });
+        ASSERT_OK(pipeline.Run().status());
+        ASSERT_TRUE(ordered);
+        ASSERT_EQ(int64_t{2} * kItems, expected);
+    }
+
+    TEST(Pipeline, Backpressure)
+    {
+        auto pool = MakePool();
+        constexpr int kItems = 5000;
+        constexpr int kCapacity = 16;
+        Pipeline pipeline(pool.get(), PipelineOptions{kCapacity});
+        StageOptions parallel;
+        parallel.parallelism = 4;
+        parallel.batch_size = 4;
+        std::atomic<int> produced{0};
+        std::atomic<int> consumed{0};
+        std::atomic<int> max_in_flight{0};
+        auto counter = Counter(kItems);
+        auto source = pipeline.AddSource([&]() -> std::optional<int>
+                                         {
+            std::optional<int> value = counter();
+            if (value)
+            {
+                produced.fetch_add(1);
+            }
+            return value; },
+                                         parallel);
+        auto incremented = pipeline.AddTransform(source, [](int x)
+                                                 { return x + 1; },
+                                                 parallel);
+        std::atomic<int64_t> sum{0};
+        pipeline.AddSink(incremented, [&](int x)
+                         {
+            sum.fetch_add(x);
+            const int in_flight = produced.load() - consumed.fetch_add(1) - 1;
+            max_in_flight.store(std::max(max_in_flight.load(), in_flight));
+            if (x % 500 == 0)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            } });
+        ASSERT_OK(pipeline.Run().status());
+        ASSERT_EQ(int64_t{kItems} * (kItems + 1) / 2, sum.load());
+        // Two channels, plus the items held by the running activations
+        ASSERT_TRUE(max_in_flight.load() <= 2 * kCapacity + 2 * parallel.parallelism);
+    }
+
+    TEST(Pipeline, Errors)
+    {
+        auto pool = MakePool();
+        {
+            Pipeline pipeline(pool.get());
+            auto source = pipeline.AddSource(Counter(-1));
+            pipeline.AddSink(source, [](int x)
+                             { return x == 1000 ? Status::Invalid("bad") : Status::OK(); });
+            ASSERT_STATUS(StatusCode::INVALID, pipeline.Run().status());
+        }
+        {
+            Pipeline pipeline(pool.get());
+            auto source = pipeline.AddSource(Counter(-1));
+            auto checked = pipeline.AddTransform(source, [](int x)
+                                                 {
+                if (x == 77)
+                {
+                    throw std::runtime_error("thrown");
+                }
+                return x; });
+            pipeline.AddSink(checked, [](int) {});
+            ASSERT_STATUS(StatusCode::UnknownError, pipeline.Run().status());
+        }
+    }
+
+    TEST(Pipeline, StopToken)
+    {
+        auto pool = MakePool();
+        Pipeline pipeline(pool.get());
+        std::atomic<int> seen{0};
+        auto source = pipeline.AddSource(Counter(-1));
+        pipeline.AddSink(source, [&](int)
+                         { seen.fetch_add(1); });
+        StopSource stop;
+        Future<> run = pipeline.Run(stop.token());
+        while (seen.load() < 10000)
+        {
+            std::this_thread::yield();
+        }
+        stop.RequestStop(Status::Cancelled("enough"));
+        ASSERT_STATUS(StatusCode::Cancelled, run.status());
+    }
+
+    TEST(Pipeline, InvalidWiring)
+    {
+        auto pool = MakePool();
+        auto empty = []() -> std::optional<int>
+        { return std::nullopt; };
+        {
+            Pipeline pipeline(pool.get());
+            pipeline.AddSource(empty);
+            ASSERT_STATUS(StatusCode::INVALID, pipeline.Run().status());
+        }
+        {
+            Pipeline pipeline(pool.get());
+            auto source = pipeline.AddSource(empty);
+            pipeline.AddSink(source, [](int) {});
+            pipeline.AddSink(source, [](int) {});
+            ASSERT_STATUS(StatusCode::INVALID, pipeline.Run().status());
+        }
+        {
+            Pipeline pipeline(pool.get());
+            Pipeline other(pool.get());
+            auto source = other.AddSource(empty);
+            pipeline.AddSink(source, [](int) {});
+            ASSERT_STATUS(StatusCode::INVALID, pipeline.Run().status());
+        }
+        {
+            Pipeline pipeline(pool.get());
+            pipeline.AddSink(Stream<int>(), [](int) {});
+            ASSERT_STATUS(StatusCode::INVALID, pipeline.Run().status());
+        }
+        {
+            Pipeline pipeline(pool.get(), PipelineOptions{0});
+            auto source = pipeline.AddSource(empty);
+            pipeline.AddSink(source, [](int) {});
+            ASSERT_STATUS(StatusCode::INVALID, pipeline.Run().status());
+        }
+        {
+            Pipeline pipeline(pool.get());
+            auto source = pipeline.AddSource(empty);
+            pipeline.AddSink(source, [](int) {});
+            ASSERT_OK(pipeline.Run().status());
+            ASSERT_STATUS(StatusCode::INVALID, pipeline.Run().status());
+        }
+    }
+
+    TEST(Pipeline, ManyPipelinesShareAPool)
+    {
+        auto pool = MakePool();
+        constexpr int kPipelines = 12;
+        constexpr int kItems = 10000;
+        std::vector<std::atomic<int64_t>> sums(kPipelines);
+        std::vector<Future<>> runs;
+        for (int i = 0; i < kPipelines; ++i)
+        {
+            // Destroyed while running
+            Pipeline pipeline(pool.get(), PipelineOptions{32});
+            auto source = pipeline.AddSource(Counter(kItems));
+            auto tripled = pipeline.AddTransform(source, [](int x)
+                                                 { return x * 3; });
+            pipeline.AddSink(tripled, [&sums, i](int x)
+                             { sums[i].fetch_add(x); });
+            runs.push_back(pipeline.Run());
+        }
+        for (auto &run : runs)
+        {
+            ASSERT_OK(run.status());
+        }
+        for (auto &sum : sums)
+        {
+            ASSERT_EQ(int64_t{3} * (kItems - 1) * kItems / 2, sum.load());
+        }
+    }
+
+    TEST(Pipeline, PoolShutdownFailsTheRun)
+    {
+        auto pool = MakePool();
+        Pipeline pipeline(pool.get());
+        auto source = pipeline.AddSource(Counter(-1));
+        pipeline.AddSink(source, [](int) {});
+        Future<> run = pipeline.Run();
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        ASSERT_OK(pool->Shutdown());
+        ASSERT_FALSE(run.status().ok());
+    }
+}
+
+int main() { return arrow::testing::RunAllTests(); }
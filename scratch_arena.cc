@@ -0,0 +1,47 @@
+#include "scratch_arena.h"
+
+#include <algorithm>
+
+namespace arrow
+{
+    namespace internal
+    {
+        void ScratchArena::Reset(Mark mark)
+        {
+            current_ = mark.chunk;
+            offset_ = mark.offset;
+            if (current_ == 0 && offset_ == 0 && chunks_.size() > kMaxRetainedChunks)
+            {
+                // Give back what an unusually hungry task used
+                chunks_.erase(chunks_.begin() + kMaxRetainedChunks, chunks_.end());
+            }
+        }
+
+        void *ScratchArena::Allocate(size_t size, size_t alignment)
+        {
+            for (;; ++current_, offset_ = 0)
+            {
+                if (current_ == chunks_.size() || chunks_[current_].size < size + alignment)
+                {
+                    if (current_ < chunks_.size() && offset_ == 0)
+                    {
+                        // Too small even when empty: put a larger one before it
+                        chunks_.emplace(chunks_.begin() + current_, std::max(kChunkSize, size + alignment));
+                    }
+                    else if (current_ == chunks_.size())
+                    {
+                        chunks_.emplace_back(std::max(kChunkSize, size + alignment));
+                    }
+                }
+                Chunk &chunk = chunks_[current_];
+                const uintptr_t base = reinterpret_cast<uintptr_t>(chunk.data.get());
+                const uintptr_t start = (base + offset_ + alignment - 1) & ~(alignment - 1);
+                if (start + size <= base + chunk.size)
+                {
+                    offset_ = start + size - base;
+                    return reinterpret_cast<void *>(start);
+                }
+            }
+        }
+    }
+}
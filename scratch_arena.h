@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "visibility.h"
+
+namespace arrow
+{
+    namespace internal
+    {
+        // Bump allocator for scratch memory of the running task, see
+        // ThreadPool::AllocateScratch(). Tasks release their allocations by
+        // rolling back to the mark taken when they started, so that nested
+        // runs (inline tasks, RunPendingTask()) keep their caller's. Not
+        // thread-safe.
+        class ARROW_EXPORT ScratchArena
+        {
+        public:
+            struct Mark
+            {
+                size_t chunk;
+                size_t offset;
+            };
+
+            static constexpr size_t kChunkSize = 64 * 1024;
+            // Chunks kept once rolled back to the start
+            static constexpr size_t kMaxRetainedChunks = 4;
+
+            Mark GetMark() const { return {current_, offset_}; }
+            // Rolling back to the start also frees the chunks beyond the
+            // first kMaxRetainedChunks
+            void Reset(Mark mark);
+            // alignment is a power of 2
+            void *Allocate(size_t size, size_t alignment);
+
+            size_t num_chunks() const { return chunks_.size(); }
+
+        private:
+            struct Chunk
+            {
+                explicit Chunk(size_t n) : data(new char[n]), size(n) {}
+
+                std::unique_ptr<char[]> data;
+                size_t size;
+            };
+
+            std::vector<Chunk> chunks_;
+            size_t current_ = 0;
+            size_t offset_ = 0;
+        };
+    }
+}
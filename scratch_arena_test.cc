@@ -0,0 +1,59 @@
+#include <cstdint>
+
+#include "scratch_arena.h"
+#include "test_util.h"
+
+namespace arrow
+{
+    namespace internal
+    {
+        TEST(ScratchArena, AlignsAllocations)
+        {
+            ScratchArena arena;
+            arena.Allocate(1, 1);
+            for (size_t alignment : {2, 8, 64, 4096})
+            {
+                void *p = arena.Allocate(3, alignment);
+                ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(p) % alignment);
+            }
+        }
+
+        TEST(ScratchArena, ResetReusesTheMemory)
+        {
+            ScratchArena arena;
+            const ScratchArena::Mark start = arena.GetMark();
+            void *first = arena.Allocate(100, 8);
+            void *second = arena.Allocate(100, 8);
+            ASSERT_TRUE(first != second);
+            const ScratchArena::Mark middle = arena.GetMark();
+            void *third = arena.Allocate(100, 8);
+            // Rolling back to a mark keeps what was allocated before it
+            arena.Reset(middle);
+            ASSERT_TRUE(arena.Allocate(100, 8) == third);
+            arena.Reset(start);
+            ASSERT_TRUE(arena.Allocate(100, 8) == first);
+            ASSERT_EQ(1u, arena.num_chunks());
+        }
+
+        TEST(ScratchArena, SpillsToNewChunks)
+        {
+            ScratchArena arena;
+            const ScratchArena::Mark start = arena.GetMark();
+            // Larger than a chunk
+            arena.Allocate(2 * ScratchArena::kChunkSize, 16);
+            for (size_t i = 0; i < ScratchArena::kMaxRetainedChunks + 2; ++i)
+            {
+                arena.Allocate(ScratchArena::kChunkSize / 2 + 1, 8);
+            }
+            ASSERT_TRUE(arena.num_chunks() > ScratchArena::kMaxRetainedChunks);
+            // Back at the start, the arena keeps a few chunks only
+            arena.Reset(start);
+            ASSERT_EQ(ScratchArena::kMaxRetainedChunks, arena.num_chunks());
+            void *large = arena.Allocate(2 * ScratchArena::kChunkSize, 16);
+            ASSERT_TRUE(large != nullptr);
+            ASSERT_EQ(ScratchArena::kMaxRetainedChunks, arena.num_chunks());
+        }
+    }
+}
+
+int main() { return arrow::testing::RunAllTests(); }
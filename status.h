@@ -1,14 +1,18 @@
 #pragma once
 
-#include <iostream>
+#include <cstdlib>
 #include <cstring>
+#include <iostream>
+#include <string>
 
 enum class StatusCode
 {
     INVALID = -1,
     OK = 0,
     Cancelled = 1,
-    KeyError = 2
+    KeyError = 2,
+    UnknownError = 3,
+    CapacityError = 4
 };
 
 class Status
@@ -17,10 +21,10 @@ public:
     Status() : code_(StatusCode::OK) {}
     explicit Status(StatusCode code) : code_(code) {}
     Status(StatusCode code, std::string msg) : code_(code), msg_(msg) {}
-    StatusCode code() const { return code_ }
+    StatusCode code() const { return code_; }
     // const function，means the function of side dot not edit the member variable
-    const std::string &message() { return msg_ }
-    bool ok() cosnt
+    const std::string &message() const { return msg_; }
+    bool ok() const
     {
         return code_ == StatusCode::OK;
     }
@@ -40,7 +44,17 @@ public:
         return Status(StatusCode::KeyError, msg);
     }
 
-    std::string ToString()
+    static Status UnknownError(const std::string &msg)
+    {
+        return Status(StatusCode::UnknownError, msg);
+    }
+
+    static Status CapacityError(const std::string &msg)
+    {
+        return Status(StatusCode::CapacityError, msg);
+    }
+
+    std::string ToString() const
     {
         std::string statusString;
         switch (code_)
@@ -51,13 +65,16 @@ public:
         case StatusCode::Cancelled:
             statusString = "cancelled";
             break;
+        case StatusCode::CapacityError:
+            statusString = "capacity error";
+            break;
         default:
             statusString =  "unknown";
             break;
         }
         if (!empty(msg_))
         {
-            statusString = ":" + msg_;
+            statusString += ": " + msg_;
         }
         return statusString;
     }
@@ -75,4 +92,4 @@ public:
 private:
     StatusCode code_;
     std::string msg_;
-}
\ No newline at end of file
+};
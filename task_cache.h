@@ -0,0 +1,146 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace arrow
+{
+    namespace internal
+    {
+        // Recycles the nodes of one owner thread, each holding a T, allocated
+        // in slabs. The owner allocates from and frees to its own list without
+        // atomics; other threads hand nodes back through a lock-free stack
+        // that the owner takes over whole once its list runs dry, so that
+        // nodes are reused by the core that last wrote them and freeing never
+        // touches the allocator.
+        template <typename T>
+        class SlabCache
+        {
+        public:
+            // A T and its allocation header, on its own cache lines
+            struct alignas(64) Node
+            {
+                alignas(T) unsigned char storage[sizeof(T)];
+                // Cache the node belongs to, nullptr for heap nodes
+                SlabCache *owner;
+                Node *next;
+            };
+
+            static constexpr int kSlabSize = 64;
+
+            // `pool` identifies the owner's pool, see pool()
+            explicit SlabCache(const void *pool) : pool_(pool) {}
+
+            SlabCache(const SlabCache &) = delete;
+            SlabCache &operator=(const SlabCache &) = delete;
+
+            // Owner only
+            Node *Allocate()
+            {
+                if (free_ == nullptr)
+                {
+                    free_ = remote_.exchange(nullptr, std::memory_order_acquire);
+                    if (free_ == nullptr)
+                    {
+                        AddSlab();
+                    }
+                }
+                Node *node = free_;
+                free_ = node->next;
+                return node;
+            }
+
+            // Owner only
+            void Free(Node *node)
+            {
+                node->next = free_;
+                free_ = node;
+            }
+
+            // Any thread: give back the nodes from first to last, linked
+            // through next
+            void FreeRemote(Node *first, Node *last)
+            {
+                Node *head = remote_.load(std::memory_order_relaxed);
+                do
+                {
+                    last->next = head;
+                } while (!remote_.compare_exchange_weak(head, first, std::memory_order_release,
+                                                        std::memory_order_relaxed));
+            }
+
+            const void *pool() const { return pool_; }
+            // Owner only
+            size_t num_slabs() const { return slabs_.size(); }
+
+        private:
+            void AddSlab()
+            {
+                slabs_.emplace_back(new Node[kSlabSize]);
+                Node *slab = slabs_.back().get();
+                for (int i = 0; i < kSlabSize; ++i)
+                {
+                    slab[i].owner = this;
+                    slab[i].next = i + 1 < kSlabSize ? &slab[i + 1] : nullptr;
+                }
+                free_ = slab;
+            }
+
+            const void *const pool_;
+            Node *free_ = nullptr;
+            std::vector<std::unique_ptr<Node[]>> slabs_;
+            alignas(64) std::atomic<Node *> remote_{nullptr};
+        };
+
+        // Nodes a thread freed for the cache of another, handed back
+        // kBatchSize at a time, or sooner when a node of another cache comes.
+        // The thread must flush before it stops freeing for a while (parks or
+        // exits), and while the cache may go away.
+        template <typename T>
+        class RemoteFreeBatch
+        {
+        public:
+            using Cache = SlabCache<T>;
+            using Node = typename Cache::Node;
+
+            static constexpr int kBatchSize = 32;
+
+            void Add(Node *node)
+            {
+                if (owner_ != node->owner)
+                {
+                    Flush();
+                    owner_ = node->owner;
+                }
+                node->next = first_;
+                first_ = node;
+                if (last_ == nullptr)
+                {
+                    last_ = node;
+                }
+                if (++count_ == kBatchSize)
+                {
+                    Flush();
+                }
+            }
+
+            void Flush()
+            {
+                if (first_ != nullptr)
+                {
+                    owner_->FreeRemote(first_, last_);
+                    first_ = last_ = nullptr;
+                    count_ = 0;
+                }
+            }
+
+        private:
+            Cache *owner_ = nullptr;
+            Node *first_ = nullptr;
+            Node *last_ = nullptr;
+            int count_ = 0;
+        };
+    }
+}
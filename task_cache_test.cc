@@ -0,0 +1,109 @@
+#include <set>
+#include <vector>
+
+#include "task_cache.h"
+#include "test_util.h"
+
+namespace arrow
+{
+    namespace internal
+    {
+        using Cache = SlabCache<int>;
+        using Node = Cache::Node;
+
+        TEST(SlabCache, ReusesFreedNodes)
+        {
+            Cache cache(nullptr);
+            std::vector<Node *> nodes;
+            for (int i = 0; i < Cache::kSlabSize; ++i)
+            {
+                nodes.push_back(cache.Allocate());
+                ASSERT_TRUE(nodes.back()->owner == &cache);
+            }
+            ASSERT_EQ(1u, cache.num_slabs());
+            for (Node *node : nodes)
+            {
+                cache.Free(node);
+            }
+            std::set<Node *> reused;
+            for (int i = 0; i < Cache::kSlabSize; ++i)
+            {
+                reused.insert(cache.Allocate());
+            }
+            ASSERT_TRUE(reused == std::set<Node *>(nodes.begin(), nodes.end()));
+            ASSERT_EQ(1u, cache.num_slabs());
+            // Only an empty cache takes a new slab
+            cache.Allocate();
+            ASSERT_EQ(2u, cache.num_slabs());
+        }
+
+        TEST(SlabCache, TakesRemoteFreesOnceItsListRunsDry)
+        {
+            Cache cache(nullptr);
+            std::vector<Node *> nodes;
+            for (int i = 0; i < Cache::kSlabSize; ++i)
+            {
+                nodes.push_back(cache.Allocate());
+            }
+            cache.FreeRemote(nodes[0], nodes[0]);
+            ASSERT_TRUE(cache.Allocate() == nodes[0]);
+            ASSERT_EQ(1u, cache.num_slabs());
+        }
+
+        TEST(RemoteFreeBatch, HandsBackFullBatches)
+        {
+            Cache cache(nullptr);
+            std::vector<Node *> nodes;
+            for (int i = 0; i < Cache::kSlabSize; ++i)
+            {
+                nodes.push_back(cache.Allocate());
+            }
+            RemoteFreeBatch<int> batch;
+            for (int i = 0; i < RemoteFreeBatch<int>::kBatchSize - 1; ++i)
+            {
+                batch.Add(nodes[i]);
+            }
+            // Still held by the batch: the cache takes a new slab
+            Node *fresh = cache.Allocate();
+            ASSERT_EQ(2u, cache.num_slabs());
+            cache.Free(fresh);
+            batch.Add(nodes[RemoteFreeBatch<int>::kBatchSize - 1]);
+            for (int i = 0; i < Cache::kSlabSize; ++i)
+            {
+                cache.Allocate();
+            }
+            // The whole batch came back at once
+            const std::set<Node *> batched(nodes.begin(), nodes.begin() + RemoteFreeBatch<int>::kBatchSize);
+            for (int i = 0; i < RemoteFreeBatch<int>::kBatchSize; ++i)
+            {
+                ASSERT_TRUE(batched.count(cache.Allocate()) == 1);
+            }
+            ASSERT_EQ(2u, cache.num_slabs());
+        }
+
+        TEST(RemoteFreeBatch, FlushesWhenTheCacheChanges)
+        {
+            Cache first(nullptr);
+            Cache second(nullptr);
+            Node *a = first.Allocate();
+            Node *b = second.Allocate();
+            // Drain the free lists, so that Allocate() looks at the remote
+            // frees
+            for (int i = 1; i < Cache::kSlabSize; ++i)
+            {
+                first.Allocate();
+                second.Allocate();
+            }
+            RemoteFreeBatch<int> batch;
+            batch.Add(a);
+            batch.Add(b);
+            ASSERT_TRUE(first.Allocate() == a);
+            batch.Flush();
+            ASSERT_TRUE(second.Allocate() == b);
+            ASSERT_EQ(1u, first.num_slabs());
+            ASSERT_EQ(1u, second.num_slabs());
+        }
+    }
+}
+
+int main() { return arrow::testing::RunAllTests(); }
@@ -0,0 +1,353 @@
+#include "task_graph.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <vector>
+
+#include "macros.h"
+
+namespace arrow
+{
+    // Nodes and edges as added, plus what runs need, derived by Finalize().
+    // Shared read-only with the runs in flight.
+    struct TaskGraph::Plan
+    {
+        struct Node
+        {
+            std::function<Status()> func;
+            TaskHints hints;
+        };
+
+        // Derive the adjacency, the roots and the critical paths, checking
+        // for cycles
+        void Finalize();
+
+        std::vector<Node> nodes_;
+        std::vector<std::pair<int, int>> edges_;
+
+        bool finalized_ = false;
+        // Invalid if the graph has a cycle
+        Status status_;
+        // Successors of node i are successors_[successor_offsets_[i]] up to
+        // successors_[successor_offsets_[i + 1]]
+        std::vector<int> successor_offsets_;
+        std::vector<int> successors_;
+        std::vector<int> in_degrees_;
+        std::vector<int> roots_;
+        // Length of the longest path from each node to a sink, the node
+        // included, see TaskGraphOptions
+        std::vector<int64_t> critical_paths_;
+    };
+
+    void TaskGraph::Plan::Finalize()
+    {
+        if (finalized_)
+        {
+            return;
+        }
+        finalized_ = true;
+        const int n = static_cast<int>(nodes_.size());
+        successor_offsets_.assign(n + 1, 0);
+        in_degrees_.assign(n, 0);
+        for (const auto &edge : edges_)
+        {
+            ++successor_offsets_[edge.first + 1];
+            ++in_degrees_[edge.second];
+        }
+        for (int i = 0; i < n; ++i)
+        {
+            successor_offsets_[i + 1] += successor_offsets_[i];
+        }
+        successors_.resize(edges_.size());
+        std::vector<int> next(successor_offsets_.begin(), successor_offsets_.end() - 1);
+        for (const auto &edge : edges_)
+        {
+            successors_[next[edge.first]++] = edge.second;
+        }
+        roots_.clear();
+        for (int i = 0; i < n; ++i)
+        {
+            if (in_degrees_[i] == 0)
+            {
+                roots_.push_back(i);
+            }
+        }
+        // Kahn's algorithm: a node left unordered is on a cycle
+        std::vector<int> order = roots_;
+        std::vector<int> in_degrees = in_degrees_;
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            const int node = order[i];
+            for (int j = successor_offsets_[node]; j < successor_offsets_[node + 1]; ++j)
+            {
+                if (--in_degrees[successors_[j]] == 0)
+                {
+                    order.push_back(successors_[j]);
+                }
+            }
+        }
+        if (static_cast<int>(order.size()) != n)
+        {
+            status_ = Status::Invalid("task graph has a cycle");
+            return;
+        }
+        critical_paths_.assign(n, 0);
+        for (auto it = order.rbegin(); it != order.rend(); ++it)
+        {
+            const int node = *it;
+            int64_t longest = 0;
+            for (int j = successor_offsets_[node]; j < successor_offsets_[node + 1]; ++j)
+            {
+                longest = std::max(longest, critical_paths_[successors_[j]]);
+            }
+            const int64_t cost = nodes_[node].hints.cpu_cost;
+            critical_paths_[node] = longest + (cost >= 0 ? cost : 1);
+        }
+    }
+
+    struct TaskGraph::RunState : std::enable_shared_from_this<RunState>
+    {
+        // The task of a node. If the executor drops it without running it,
+        // the node completes as cancelled, so that the run still finishes.
+        struct NodeTask
+        {
+            NodeTask(std::shared_ptr<RunState> run, int node) : run(std::move(run)), node(node) {}
+            NodeTask(NodeTask &&) noexcept = default;
+
+            ~NodeTask()
+            {
+                if (run)
+                {
+                    run->Complete(node, run->stop_token_.IsStopRequested()
+                                            ? run->stop_token_.Poll()
+                                            : Status::Cancelled("task graph node dropped by the executor"));
+                }
+            }
+
+            void operator()()
+            {
+                std::shared_ptr<RunState> self = std::move(run);
+                self->RunNode(node);
+            }
+
+            std::shared_ptr<RunState> run;
+            int node;
+        };
+
+        RunState(std::shared_ptr<const Plan> plan, Executor *executor, TaskGraphOptions options)
+            : plan_(std::move(plan)),
+              executor_(executor),
+              options_(options),
+              pending_(new std::atomic<int>[plan_->nodes_.size()]),
+              remaining_(static_cast<int>(plan_->nodes_.size())),
+              stop_token_(stop_source_.token()),
+              done_(Future<>::Make(executor))
+        {
+            for (size_t i = 0; i < plan_->nodes_.size(); ++i)
+            {
+                pending_[i].store(plan_->in_degrees_[i], std::memory_order_relaxed);
+            }
+        }
+
+        void Start(const StopToken &stop_token);
+        // Call the node's function unless the run was stopped
+        void RunNode(int node);
+        // Account for a finished node: release its successors, spawning
+        // those it made ready, or skipping them if the run was stopped
+        void Complete(int node, Status status);
+        void Spawn(const std::vector<int> &nodes);
+        // Record the first error and stop the run
+        void Fail(const Status &status);
+
+        const std::shared_ptr<const Plan> plan_;
+        Executor *const executor_;
+        const TaskGraphOptions options_;
+        // Unfinished predecessors of each node
+        std::unique_ptr<std::atomic<int>[]> pending_;
+        // Nodes that did not complete yet
+        std::atomic<int> remaining_;
+        // Triggered by the first error or by the caller's token, and given
+        // to the spawned nodes so that the executor drops the queued ones
+        StopSource stop_source_;
+        const StopToken stop_token_;
+        StopRegistration caller_stop_;
+        std::mutex mutex_;
+        Status status_;
+        Future<> done_;
+    };
+
+    void TaskGraph::RunState::Start(const StopToken &stop_token)
+    {
+        caller_stop_ = stop_token.RegisterCallback([this](const Status &status)
+                                                   { Fail(status); });
+        Spawn(plan_->roots_);
+    }
+
+    void TaskGraph::RunState::RunNode(int node)
+    {
+        Status status;
+        if (!stop_token_.IsStopRequested())
+        {
+            try
+            {
+                status = plan_->nodes_[node].func();
+            }
+            catch (const std::exception &e)
+            {
+                status = Status::UnknownError(e.what());
+            }
+            catch (...)
+            {
+                status = Status::UnknownError("unknown exception in task graph node");
+            }
+        }
+        Complete(node, std::move(status));
+    }
+
+    void TaskGraph::RunState::Complete(int node, Status status)
+    {
+        if (!status.ok())
+        {
+            Fail(status);
+        }
+        // The node, then the successors skipped on our way
+        std::vector<int> completed = {node};
+        std::vector<int> ready;
+        int num_completed = 0;
+        while (!completed.empty())
+        {
+            const int done = completed.back();
+            completed.pop_back();
+            ++num_completed;
+            for (int j = plan_->successor_offsets_[done]; j < plan_->successor_offsets_[done + 1]; ++j)
+            {
+                const int successor = plan_->successors_[j];
+                if (pending_[successor].fetch_sub(1, std::memory_order_acq_rel) == 1)
+                {
+                    if (stop_token_.IsStopRequested())
+                    {
+                        completed.push_back(successor);
+                    }
+                    else
+                    {
+                        ready.push_back(successor);
+                    }
+                }
+            }
+        }
+        Spawn(ready);
+        if (remaining_.fetch_sub(num_completed, std::memory_order_acq_rel) == num_completed)
+        {
+            caller_stop_.Reset();
+            Status result;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                result = status_;
+            }
+            done_.MarkFinished(std::move(result));
+        }
+    }
+
+    void TaskGraph::RunState::Spawn(const std::vector<int> &nodes)
+    {
+        if (nodes.empty())
+        {
+            return;
+        }
+        // A node whose spawn fails completes through its NodeTask
+        std::shared_ptr<RunState> self = shared_from_this();
+        if (options_.critical_path_first && nodes.size() > 1)
+        {
+            std::vector<Executor::BatchTask> tasks;
+            tasks.reserve(nodes.size());
+            for (int node : nodes)
+            {
+                Executor::BatchTask task;
+                task.hints = plan_->nodes_[node].hints;
+                task.hints.cpu_cost = plan_->critical_paths_[node];
+                task.callable = NodeTask(self, node);
+                task.stop_token = stop_token_;
+                tasks.push_back(std::move(task));
+            }
+            ARROW_UNUSED(executor_->SpawnBatch(std::move(tasks)));
+            return;
+        }
+        for (int node : nodes)
+        {
+            ARROW_UNUSED(executor_->Spawn(plan_->nodes_[node].hints, NodeTask(self, node), stop_token_));
+        }
+    }
+
+    void TaskGraph::RunState::Fail(const Status &status)
+    {
+        // Stopping may drop the last tasks holding the run
+        std::shared_ptr<RunState> self = shared_from_this();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!status_.ok())
+            {
+                return;
+            }
+            status_ = status;
+        }
+        stop_source_.RequestStop(status);
+    }
+
+    TaskGraph::TaskGraph() : plan_(std::make_shared<Plan>()) {}
+
+    TaskGraph::~TaskGraph() = default;
+
+    TaskGraph::Plan *TaskGraph::MutablePlan()
+    {
+        if (plan_.use_count() > 1)
+        {
+            plan_ = std::make_shared<Plan>(*plan_);
+        }
+        plan_->finalized_ = false;
+        plan_->status_ = Status::OK();
+        return plan_.get();
+    }
+
+    int TaskGraph::AddNodeReal(TaskHints hints, std::function<Status()> func)
+    {
+        Plan *plan = MutablePlan();
+        plan->nodes_.push_back({std::move(func), hints});
+        return static_cast<int>(plan->nodes_.size()) - 1;
+    }
+
+    Status TaskGraph::AddEdge(int from, int to)
+    {
+        const int n = num_nodes();
+        if (from < 0 || from >= n || to < 0 || to >= n)
+        {
+            return Status::Invalid("task graph edge between unknown nodes");
+        }
+        if (from == to)
+        {
+            return Status::Invalid("task graph node cannot depend on itself");
+        }
+        MutablePlan()->edges_.emplace_back(from, to);
+        return Status::OK();
+    }
+
+    int TaskGraph::num_nodes() const { return static_cast<int>(plan_->nodes_.size()); }
+
+    Future<> TaskGraph::Run(Executor *executor, StopToken stop_token, TaskGraphOptions options)
+    {
+        plan_->Finalize();
+        if (!plan_->status_.ok())
+        {
+            return Future<>::MakeFinished(plan_->status_, executor);
+        }
+        if (plan_->nodes_.empty())
+        {
+            return Future<>::MakeFinished(Status::OK(), executor);
+        }
+        auto run = std::make_shared<RunState>(plan_, executor, options);
+        Future<> done = run->done_;
+        run->Start(stop_token);
+        return done;
+    }
+}
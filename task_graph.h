@@ -0,0 +1,87 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "cancel.h"
+#include "executor.h"
+#include "future.h"
+#include "status.h"
+#include "visibility.h"
+
+namespace arrow
+{
+    struct TaskGraphOptions
+    {
+        // When several nodes become ready at once, start those heading the
+        // longest remaining path first: they are spawned as one batch with
+        // TaskHints::cpu_cost set to the length of that path, the sum of the
+        // cpu_cost of its nodes (1 for nodes without one), so that executors
+        // ordering batches by cost (ThreadPool) pick them first.
+        bool critical_path_first = false;
+    };
+
+    // A DAG of tasks, built once and run any number of times on an executor.
+    //
+    // A run keeps one atomic counter of unfinished predecessors per node, and
+    // the node that finishes last spawns the successors it made ready: no
+    // thread ever waits for a dependency. The first error returned (or
+    // thrown) by a node, or the triggering of the run's stop token, stops the
+    // run: queued nodes are dropped and the nodes that did not start are
+    // skipped, and the run finishes with that status once the running nodes
+    // have returned.
+    //
+    // Runs may overlap, node functions are then called concurrently. Adding
+    // nodes or edges does not affect the runs in flight.
+    class ARROW_EXPORT TaskGraph
+    {
+    public:
+        TaskGraph();
+        ~TaskGraph();
+
+        TaskGraph(const TaskGraph &) = delete;
+        TaskGraph &operator=(const TaskGraph &) = delete;
+
+        // Add a node calling func, which may return void or Status, once per
+        // run. Returns the id of the node, ids are numbered from 0.
+        template <typename Function>
+        int AddNode(Function &&func, TaskHints hints = {})
+        {
+            using Result = decltype(func());
+            if constexpr (std::is_same<Result, Status>::value)
+            {
+                return AddNodeReal(hints, std::forward<Function>(func));
+            }
+            else
+            {
+                return AddNodeReal(hints, [func = std::forward<Function>(func)]() mutable
+                                   {
+                    func();
+                    return Status::OK(); });
+            }
+        }
+
+        // Make node `to` wait for node `from`
+        Status AddEdge(int from, int to);
+
+        int num_nodes() const;
+
+        // Spawn the nodes on `executor` as their dependencies complete. The
+        // future finishes once every node has finished or been skipped, with
+        // the first error, or Invalid if the graph has a cycle.
+        Future<> Run(Executor *executor, StopToken stop_token = StopToken::Unstoppable(),
+                     TaskGraphOptions options = {});
+
+        struct Plan;
+        struct RunState;
+
+    private:
+        int AddNodeReal(TaskHints hints, std::function<Status()> func);
+        // The plan, copied first if runs in flight share it
+        Plan *MutablePlan();
+
+        std::shared_ptr<Plan> plan_;
+    };
+}
@@ -0,0 +1,246 @@
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "task_graph.h"
+#include "test_util.h"
+#include "thread_pool.h"
+
+namespace arrow
+{
+    namespace
+    {
+        std::shared_ptr<ThreadPool> MakePool() { return *ThreadPool::Make(4); }
+
+        // Node i depends on (i - 1) / 2 and, from 4 on, on i - 3
+        std::vector<std::pair<int, int>> MakeEdges(int n)
+        {
+            std::vector<std::pair<int, int>> edges;
+            for (int i = 1; i < n; ++i)
+            {
+                edges.emplace_back((i - 1) / 2, i);
+                if (i > 3)
+                {
+                    edges.emplace_back(i - 3, i);
+                }
+            }
+            return edges;
+        }
+
+        void CheckDependencyOrder(TaskGraphOptions options)
+        {
+            auto pool = MakePool();
+            constexpr int kNodes = 50;
+            TaskGraph graph;
+            std::vector<std::atomic<int>> order(kNodes);
+            std::atomic<int> clock{0};
+            for (int i = 0; i < kNodes; ++i)
+            {
+                graph.AddNode([&, i]
+                              { order[i].store(++clock); });
+            }
+            const auto edges = MakeEdges(kNodes);
+            for (const auto &edge : edges)
+            {
+                ASSERT_OK(graph.AddEdge(edge.first, edge.second));
+            }
+            for (int run = 0; run < 20; ++run)
+            {
+                clock.store(0);
+                ASSERT_OK(graph.Run(pool.get(), StopToken::Unstoppable(), options).status());
+                ASSERT_EQ(kNodes, clock.load());
+                for (const auto &edge : edges)
+                {
+                    ASSERT_TRUE(order[edge.first].load() < order[edge.second].load());
+                }
+            }
+        }
+    }
+
+    TEST(TaskGraph, RespectsDependencies) { CheckDependencyOrder(TaskGraphOptions{}); }
+
+    TEST(TaskGraph, RespectsDependenciesCriticalPathFirst)
+    {
+        TaskGraphOptions options;
+        options.critical_path_first = true;
+        CheckDependencyOrder(options);
+    }
+
+    TEST(TaskGraph, CriticalPathRunsFirst)
+    {
+        auto pool = *ThreadPool::Make(1);
+        TaskGraph graph;
+        TaskHints hints;
+        hints.cpu_cost = 1000000;
+        std::mutex mutex;
+        std::vector<int> order;
+        const int root = graph.AddNode([] {}, hints);
+        // Below the root, chains of 1, 3 and 2 nodes, whose heads record
+        // their chain's length
+        for (int length : {1, 3, 2})
+        {
+            int previous = root;
+            for (int i = 0; i < length; ++i)
+            {
+                const int node = graph.AddNode(
+                    [&, length, i]
+                    {
+                        if (i == 0)
+                        {
+                            std::lock_guard<std::mutex> lock(mutex);
+                            order.push_back(length);
+                        }
+                    },
+                    hints);
+                ASSERT_OK(graph.AddEdge(previous, node));
+                previous = node;
+            }
+        }
+        TaskGraphOptions options;
+        options.critical_path_first = true;
+        ASSERT_OK(graph.Run(pool.get(), StopToken::Unstoppable(), options).status());
+        ASSERT_TRUE(order == std::vector<int>({3, 2, 1}));
+    }
+
+    TEST(TaskGraph, OverlappingRuns)
+    {
+        auto pool = MakePool();
+        TaskGraph graph;
+        std::atomic<int> count{0};
+        int previous = -1;
+        for (int i = 0; i < 100; ++i)
+        {
+            const int node = graph.AddNode([&]
+                                           { count.fetch_add(1); });
+            if (previous >= 0)
+            {
+                ASSERT_OK(graph.AddEdge(previous, node));
+            }
+            previous = node;
+        }
+        std::vector<Future<>> runs;
+        for (int i = 0; i < 10; ++i)
+        {
+            runs.push_back(graph.Run(pool.get()));
+        }
+        for (auto &run : runs)
+        {
+            ASSERT_OK(run.status());
+        }
+        ASSERT_EQ(1000, count.load());
+    }
+
+    TEST(TaskGraph, ErrorSkipsSuccessors)
+    {
+        auto pool = MakePool();
+        TaskGraph graph;
+        std::atomic<int> ran{0};
+        const int a = graph.AddNode([&]
+                                    { ran.fetch_add(1); });
+        const int b = graph.AddNode([&]() -> Status
+                                    {
+            ran.fetch_add(1);
+            return Status::Invalid("boom"); });
+        const int c = graph.AddNode([&]
+                                    { ran.fetch_add(1); });
+        ASSERT_OK(graph.AddEdge(a, b));
+        ASSERT_OK(graph.AddEdge(b, c));
+        ASSERT_STATUS(StatusCode::INVALID, graph.Run(pool.get()).status());
+        ASSERT_EQ(2, ran.load());
+
+        TaskGraph throwing;
+        throwing.AddNode([]
+                         { throw std::runtime_error("thrown"); });
+        ASSERT_STATUS(StatusCode::UnknownError, throwing.Run(pool.get()).status());
+    }
+
+    TEST(TaskGraph, StopToken)
+    {
+        auto pool = MakePool();
+        TaskGraph graph;
+        std::atomic<bool> release{false};
+        std::atomic<int> after{0};
+        const int root = graph.AddNode([&]
+                                       {
+            while (!release.load())
+            {
+                std::this_thread::yield();
+            } });
+        for (int i = 0; i < 100; ++i)
+        {
+            ASSERT_OK(graph.AddEdge(root, graph.AddNode([&]
+                                                        { after.fetch_add(1); })));
+        }
+        StopSource source;
+        Future<> run = graph.Run(pool.get(), source.token());
+        source.RequestStop(Status::Cancelled("stop"));
+        release.store(true);
+        ASSERT_STATUS(StatusCode::Cancelled, run.status());
+        ASSERT_EQ(0, after.load());
+
+        StopSource stopped;
+        stopped.RequestStop();
+        ASSERT_STATUS(StatusCode::Cancelled, graph.Run(pool.get(), stopped.token()).status());
+    }
+
+    TEST(TaskGraph, InvalidGraphs)
+    {
+        auto pool = MakePool();
+        TaskGraph graph;
+        const int a = graph.AddNode([] {});
+        const int b = graph.AddNode([] {});
+        const int c = graph.AddNode([] {});
+        ASSERT_STATUS(StatusCode::INVALID, graph.AddEdge(a, a));
+        ASSERT_STATUS(StatusCode::INVALID, graph.AddEdge(a, 7));
+        ASSERT_OK(graph.AddEdge(a, b));
+        ASSERT_OK(graph.AddEdge(b, c));
+        ASSERT_OK(graph.AddEdge(c, b));
+        ASSERT_STATUS(StatusCode::INVALID, graph.Run(pool.get()).status());
+        TaskGraph empty;
+        ASSERT_OK(empty.Run(pool.get()).status());
+    }
+
+    TEST(TaskGraph, LongChain)
+    {
+        auto pool = MakePool();
+        TaskGraph graph;
+        std::atomic<int> count{0};
+        int previous = -1;
+        for (int i = 0; i < 100000; ++i)
+        {
+            const int node = graph.AddNode([&]
+                                           { count.fetch_add(1); });
+            if (previous >= 0)
+            {
+                ASSERT_OK(graph.AddEdge(previous, node));
+            }
+            previous = node;
+        }
+        ASSERT_OK(graph.Run(pool.get()).status());
+        ASSERT_EQ(100000, count.load());
+    }
+
+    TEST(TaskGraph, AddingNodesDoesNotAffectRunsInFlight)
+    {
+        auto pool = MakePool();
+        TaskGraph graph;
+        std::atomic<bool> release{false};
+        graph.AddNode([&]
+                      {
+            while (!release.load())
+            {
+                std::this_thread::yield();
+            } });
+        Future<> run = graph.Run(pool.get());
+        graph.AddNode([] {});
+        release.store(true);
+        ASSERT_OK(run.status());
+        ASSERT_EQ(2, graph.num_nodes());
+        ASSERT_OK(graph.Run(pool.get()).status());
+    }
+}
+
+int main() { return arrow::testing::RunAllTests(); }
@@ -0,0 +1,230 @@
+#include "task_group.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "macros.h"
+
+namespace arrow
+{
+    struct TaskGroup::State
+    {
+        State(Executor *executor, std::shared_ptr<State> parent)
+            : executor_(executor), parent_(std::move(parent)) {}
+
+        // Pop the first queued task and run it, or drop it if the group was
+        // cancelled. Returns false if the queue was empty.
+        bool RunOne();
+        // Account for a finished task or nested group
+        void Finish(Status status);
+        void Cancel(Status status);
+
+        Executor *const executor_;
+        const std::shared_ptr<State> parent_;
+        StopSource stop_source_;
+        std::atomic<bool> cancelled_{false};
+
+        std::mutex mutex_;
+        std::condition_variable cv_;
+        std::deque<internal::FnOnce<Status()>> queue_;
+        // Queued and running tasks, plus live nested groups
+        int64_t outstanding_ = 0;
+        int num_waiters_ = 0;
+        Status status_;
+        std::vector<std::weak_ptr<State>> children_;
+    };
+
+    bool TaskGroup::State::RunOne()
+    {
+        internal::FnOnce<Status()> task;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (queue_.empty())
+            {
+                return false;
+            }
+            task = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        Status status;
+        if (!cancelled_.load(std::memory_order_acquire))
+        {
+            try
+            {
+                status = std::move(task)();
+            }
+            catch (const std::exception &e)
+            {
+                status = Status::UnknownError(e.what());
+            }
+            catch (...)
+            {
+                status = Status::UnknownError("unknown exception in task group task");
+            }
+        }
+        Finish(std::move(status));
+        return true;
+    }
+
+    void TaskGroup::State::Finish(Status status)
+    {
+        if (!status.ok())
+        {
+            Cancel(std::move(status));
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--outstanding_ == 0)
+        {
+            cv_.notify_all();
+        }
+    }
+
+    void TaskGroup::State::Cancel(Status status)
+    {
+        std::vector<std::shared_ptr<State>> children;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (status_.ok())
+            {
+                status_ = status;
+            }
+            if (cancelled_.exchange(true))
+            {
+                return;
+            }
+            for (const auto &weak_child : children_)
+            {
+                if (auto child = weak_child.lock())
+                {
+                    children.push_back(std::move(child));
+                }
+            }
+            // Wake up waiters so that they drop the queued tasks
+            cv_.notify_all();
+        }
+        // Unlocked: stop callbacks may call back into the group
+        stop_source_.RequestStop(status);
+        for (const auto &child : children)
+        {
+            child->Cancel(status);
+        }
+    }
+
+    TaskGroup::TaskGroup(Executor *executor)
+        : state_(std::make_shared<State>(executor, nullptr)) {}
+
+    TaskGroup::TaskGroup(TaskGroup *parent)
+        : state_(std::make_shared<State>(parent->executor(), parent->state_))
+    {
+        State *parent_state = parent->state_.get();
+        Status parent_status;
+        {
+            std::lock_guard<std::mutex> lock(parent_state->mutex_);
+            parent_state->children_.push_back(state_);
+            ++parent_state->outstanding_;
+            if (!parent_state->cancelled_)
+            {
+                return;
+            }
+            parent_status = parent_state->status_;
+        }
+        state_->Cancel(std::move(parent_status));
+    }
+
+    TaskGroup::~TaskGroup()
+    {
+        Status status = Wait();
+        if (State *parent = state_->parent_.get())
+        {
+            {
+                std::lock_guard<std::mutex> lock(parent->mutex_);
+                auto &siblings = parent->children_;
+                siblings.erase(std::find_if(siblings.begin(), siblings.end(),
+                                            [&](const std::weak_ptr<State> &sibling)
+                                            { return sibling.lock() == state_; }));
+            }
+            // A cancellation inherited from the parent is already recorded there
+            parent->Finish(parent->cancelled_ ? Status::OK() : std::move(status));
+        }
+    }
+
+    Status TaskGroup::SpawnReal(TaskHints hints, internal::FnOnce<Status()> task)
+    {
+        State *state = state_.get();
+        {
+            std::lock_guard<std::mutex> lock(state->mutex_);
+            if (state->cancelled_)
+            {
+                return state->status_;
+            }
+            state->queue_.push_back(std::move(task));
+            ++state->outstanding_;
+            if (state->num_waiters_ > 0)
+            {
+                state->cv_.notify_all();
+            }
+        }
+        // The trampoline runs whichever task is first in the queue. If the
+        // executor refuses it, the task is left for Wait() to run.
+        ARROW_UNUSED(state->executor_->Spawn(
+            hints, [state = state_]
+            { state->RunOne(); },
+            state->stop_source_.token()));
+        return Status::OK();
+    }
+
+    Status TaskGroup::Wait()
+    {
+        State *state = state_.get();
+        while (true)
+        {
+            // Our own tasks first
+            if (state->RunOne())
+            {
+                continue;
+            }
+            {
+                std::lock_guard<std::mutex> lock(state->mutex_);
+                if (state->outstanding_ == 0)
+                {
+                    return state->status_;
+                }
+                if (!state->queue_.empty())
+                {
+                    continue;
+                }
+            }
+            // Our remaining tasks run elsewhere: help the executor meanwhile
+            if (state->executor_->RunPendingTask())
+            {
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(state->mutex_);
+            ++state->num_waiters_;
+            state->cv_.wait(lock, [state]
+                            { return state->outstanding_ == 0 || !state->queue_.empty(); });
+            --state->num_waiters_;
+        }
+    }
+
+    void TaskGroup::Cancel(Status status)
+    {
+        if (status.ok())
+        {
+            status = Status::Cancelled("task group cancelled");
+        }
+        state_->Cancel(std::move(status));
+    }
+
+    bool TaskGroup::IsCancelled() const { return state_->cancelled_.load(); }
+
+    StopToken TaskGroup::stop_token() { return state_->stop_source_.token(); }
+
+    Executor *TaskGroup::executor() const { return state_->executor_; }
+}
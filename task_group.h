@@ -0,0 +1,85 @@
+#pragma once
+
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "cancel.h"
+#include "executor.h"
+#include "functional.h"
+#include "status.h"
+#include "visibility.h"
+
+namespace arrow
+{
+    // A set of tasks spawned on an executor that can be waited for and
+    // cancelled together, independently of other work on the executor.
+    //
+    // Tasks are queued in the group and the executor runs them through small
+    // trampolines, so Wait() can pick the group's not-yet-started tasks and
+    // run them on the waiting thread. Once those are exhausted, a waiter
+    // running on a pool worker helps with other pool tasks instead of
+    // blocking the thread, so waiting from inside the pool cannot deadlock it.
+    //
+    // The first error returned by a task cancels the group. Tasks that have
+    // not started when the group is cancelled are dropped.
+    class ARROW_EXPORT TaskGroup
+    {
+    public:
+        explicit TaskGroup(Executor *executor);
+        // A nested group on the parent's executor. It is cancelled with its
+        // parent, counts as one outstanding task of the parent until it is
+        // destroyed, and reports its error to the parent.
+        explicit TaskGroup(TaskGroup *parent);
+        // Waits for the remaining tasks
+        ~TaskGroup();
+
+        TaskGroup(const TaskGroup &) = delete;
+        TaskGroup &operator=(const TaskGroup &) = delete;
+
+        // func may return void or Status. Fails if the group was cancelled.
+        template <typename Function>
+        Status Spawn(TaskHints hints, Function &&func)
+        {
+            using Result = decltype(func());
+            if constexpr (std::is_same<Result, Status>::value)
+            {
+                return SpawnReal(hints, std::forward<Function>(func));
+            }
+            else
+            {
+                return SpawnReal(hints, [func = std::forward<Function>(func)]() mutable
+                                 {
+                    std::move(func)();
+                    return Status::OK(); });
+            }
+        }
+        template <typename Function>
+        Status Spawn(Function &&func)
+        {
+            return Spawn(TaskHints{}, std::forward<Function>(func));
+        }
+
+        // Wait until all tasks spawned so far and all nested groups are done,
+        // running queued tasks on the calling thread meanwhile. Returns the
+        // first error, or the cancellation status.
+        Status Wait();
+
+        // Drop the tasks that have not started yet and make running tasks see
+        // stop_token() as stopped
+        void Cancel(Status status = Status::Cancelled("task group cancelled"));
+        bool IsCancelled() const;
+
+        // Stop token for cooperative cancellation checks in running tasks
+        StopToken stop_token();
+
+        Executor *executor() const;
+
+        struct State;
+
+    private:
+        Status SpawnReal(TaskHints hints, internal::FnOnce<Status()> task);
+
+        std::shared_ptr<State> state_;
+    };
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include "thread_pool.h"
+
+namespace arrow
+{
+    namespace internal
+    {
+        // Queued tasks and accounting of one tenant, see TaskHints::tenant_id
+        template <typename T>
+        struct TenantQueue
+        {
+            explicit TenantQueue(int64_t id) : id_(id) {}
+
+            const int64_t id_;
+            TenantOptions options_;
+            std::deque<T *> pending_;
+            // Run time left in the tenant's turn, negative after overrunning
+            // it; tasks are charged once they return
+            int64_t deficit_ = 0;
+            int running_ = 0;
+            // Whether in the round
+            bool scheduled_ = false;
+            int64_t tasks_executed_ = 0;
+            int64_t busy_nanos_ = 0;
+            LatencyHistogram queue_wait_;
+        };
+
+        // Deficit round robin between the tenants that have tasks they may
+        // run: the tenant at the head of the round runs tasks while it has
+        // run time left in its turn, then gets its quantum (times its weight)
+        // and moves to the back. Not thread-safe.
+        template <typename T>
+        class TenantScheduler
+        {
+        public:
+            using Tenant = TenantQueue<T>;
+
+            // Run time a tenant gets per turn, times its weight
+            static constexpr int64_t kQuantumNanos = 1000000;
+
+            Tenant &Get(int64_t tenant_id)
+            {
+                return tenants_.try_emplace(tenant_id, tenant_id).first->second;
+            }
+
+            // Queue a task of the tenant
+            void Push(int64_t tenant_id, T *task)
+            {
+                Tenant &tenant = Get(tenant_id);
+                tenant.pending_.push_back(task);
+                Schedule(&tenant);
+            }
+
+            // Put the tenant in the round if it has tasks it may run
+            void Schedule(Tenant *tenant)
+            {
+                const int max_concurrency = tenant->options_.max_concurrency;
+                if (!tenant->scheduled_ && !tenant->pending_.empty() &&
+                    (max_concurrency == 0 || tenant->running_ < max_concurrency))
+                {
+                    tenant->scheduled_ = true;
+                    round_.push_back(tenant);
+                }
+            }
+
+            // The tenant whose task runs next, nullptr if no tenant can run
+            // a task
+            Tenant *Next()
+            {
+                const auto quantum = [](const Tenant *tenant)
+                { return tenant->options_.weight * kQuantumNanos; };
+                size_t visited = 0;
+                while (!round_.empty())
+                {
+                    Tenant *tenant = round_.front();
+                    const int max_concurrency = tenant->options_.max_concurrency;
+                    if (tenant->pending_.empty() ||
+                        (max_concurrency > 0 && tenant->running_ >= max_concurrency))
+                    {
+                        // Rescheduled once it has a task it may run
+                        round_.pop_front();
+                        tenant->scheduled_ = false;
+                        if (tenant->pending_.empty())
+                        {
+                            // An idle tenant keeps its debt but not its credit
+                            tenant->deficit_ = std::min<int64_t>(tenant->deficit_, 0);
+                        }
+                        continue;
+                    }
+                    if (tenant->deficit_ > 0)
+                    {
+                        return tenant;
+                    }
+                    if (++visited > round_.size())
+                    {
+                        // Everyone overran their turn: skip the rounds in which
+                        // nobody would run
+                        int64_t rounds = std::numeric_limits<int64_t>::max();
+                        for (const Tenant *t : round_)
+                        {
+                            rounds = std::min(rounds, std::max<int64_t>(0, -t->deficit_ / quantum(t)));
+                        }
+                        for (Tenant *t : round_)
+                        {
+                            t->deficit_ += rounds * quantum(t);
+                        }
+                        visited = 0;
+                    }
+                    tenant->deficit_ += quantum(tenant);
+                    round_.pop_front();
+                    round_.push_back(tenant);
+                }
+                return nullptr;
+            }
+
+            // Take the next task of a tenant returned by Next()
+            T *Take(Tenant *tenant)
+            {
+                T *task = tenant->pending_.front();
+                tenant->pending_.pop_front();
+                ++tenant->running_;
+                return task;
+            }
+
+            // Charge the tenant for a task from Take() that returned
+            void Finish(Tenant *tenant, int64_t queue_wait_nanos, int64_t run_nanos, bool cancelled)
+            {
+                --tenant->running_;
+                tenant->deficit_ -= run_nanos;
+                if (!cancelled)
+                {
+                    ++tenant->tasks_executed_;
+                    tenant->busy_nanos_ += run_nanos;
+                    ++tenant->queue_wait_.buckets[LatencyHistogram::BucketFor(queue_wait_nanos)];
+                }
+                Schedule(tenant);
+            }
+
+            // Move all queued tasks to *out
+            void Drain(std::vector<T *> *out)
+            {
+                for (auto &entry : tenants_)
+                {
+                    auto &pending = entry.second.pending_;
+                    out->insert(out->end(), pending.begin(), pending.end());
+                    pending.clear();
+                    entry.second.scheduled_ = false;
+                }
+                round_.clear();
+            }
+
+            bool has_runnable() const { return !round_.empty(); }
+            const std::unordered_map<int64_t, Tenant> &tenants() const { return tenants_; }
+
+        private:
+            std::unordered_map<int64_t, Tenant> tenants_;
+            // Tenants that may have tasks to run, in round order
+            std::deque<Tenant *> round_;
+        };
+    }
+}
@@ -0,0 +1,84 @@
+#include <vector>
+
+#include "tenant_scheduler.h"
+#include "test_util.h"
+
+namespace arrow
+{
+    namespace internal
+    {
+        using Scheduler = TenantScheduler<int>;
+
+        // Run `n` tasks of `run_nanos` each, counting them per tenant id
+        std::vector<int> RunTasks(Scheduler *scheduler, int n, int64_t run_nanos)
+        {
+            std::vector<int> counts(4);
+            for (int i = 0; i < n; ++i)
+            {
+                Scheduler::Tenant *tenant = scheduler->Next();
+                if (tenant == nullptr)
+                {
+                    break;
+                }
+                scheduler->Take(tenant);
+                ++counts[tenant->id_];
+                scheduler->Finish(tenant, /*queue_wait_nanos=*/0, run_nanos, /*cancelled=*/false);
+            }
+            return counts;
+        }
+
+        TEST(TenantScheduler, SharesRunTimeByWeight)
+        {
+            Scheduler scheduler;
+            int task = 0;
+            scheduler.Get(1).options_.weight = 1;
+            scheduler.Get(2).options_.weight = 3;
+            for (int i = 0; i < 10000; ++i)
+            {
+                scheduler.Push(1, &task);
+                scheduler.Push(2, &task);
+            }
+            // Tasks of a tenth of a quantum
+            const std::vector<int> counts = RunTasks(&scheduler, 4000, Scheduler::kQuantumNanos / 10);
+            ASSERT_EQ(1000, counts[1]);
+            ASSERT_EQ(3000, counts[2]);
+            ASSERT_EQ(1000, scheduler.tenants().at(1).tasks_executed_);
+        }
+
+        TEST(TenantScheduler, SaturatingTenantDoesNotStarveOthers)
+        {
+            Scheduler scheduler;
+            int task = 0;
+            for (int i = 0; i < 10000; ++i)
+            {
+                scheduler.Push(1, &task);
+            }
+            RunTasks(&scheduler, 100, Scheduler::kQuantumNanos / 10);
+            // A task far longer than a quantum leaves the tenant in debt
+            RunTasks(&scheduler, 1, 50 * Scheduler::kQuantumNanos);
+            scheduler.Push(2, &task);
+            std::vector<int> counts = RunTasks(&scheduler, 1, Scheduler::kQuantumNanos / 10);
+            ASSERT_EQ(1, counts[2]);
+            // Back to alone, the busy tenant runs again
+            counts = RunTasks(&scheduler, 10, Scheduler::kQuantumNanos / 10);
+            ASSERT_EQ(10, counts[1]);
+        }
+
+        TEST(TenantScheduler, RespectsMaxConcurrency)
+        {
+            Scheduler scheduler;
+            int task = 0;
+            scheduler.Get(1).options_.max_concurrency = 1;
+            scheduler.Push(1, &task);
+            scheduler.Push(1, &task);
+            Scheduler::Tenant *tenant = scheduler.Next();
+            ASSERT_TRUE(tenant != nullptr);
+            scheduler.Take(tenant);
+            ASSERT_TRUE(scheduler.Next() == nullptr);
+            scheduler.Finish(tenant, 0, 1000, /*cancelled=*/false);
+            ASSERT_TRUE(scheduler.Next() == tenant);
+        }
+    }
+}
+
+int main() { return arrow::testing::RunAllTests(); }
@@ -0,0 +1,127 @@
+#pragma once
+
+// Minimal test harness for the *_test.cc executables. TEST() cases register
+// themselves; RunAllTests() runs them in order and reports the first failed
+// check of each. A test binary exits non-zero if any case failed.
+
+#include <cstdio>
+#include <exception>
+#include <string>
+#include <vector>
+
+#include "status.h"
+
+namespace arrow
+{
+    namespace testing
+    {
+        struct TestCase
+        {
+            const char *name;
+            void (*fn)();
+        };
+
+        // Thrown by failed checks, to end the current case
+        struct TestFailure
+        {
+        };
+
+        inline std::vector<TestCase> &Registry()
+        {
+            static std::vector<TestCase> tests;
+            return tests;
+        }
+
+        inline bool RegisterTest(const char *name, void (*fn)())
+        {
+            Registry().push_back({name, fn});
+            return true;
+        }
+
+        inline void Fail(const char *file, int line, const std::string &message)
+        {
+            std::fprintf(stderr, "%s:%d: %s\n", file, line, message.c_str());
+            throw TestFailure{};
+        }
+
+        inline int RunAllTests()
+        {
+            int failed = 0;
+            for (const TestCase &test : Registry())
+            {
+                std::fprintf(stderr, "[ RUN  ] %s\n", test.name);
+                bool ok = true;
+                try
+                {
+                    test.fn();
+                }
+                catch (const TestFailure &)
+                {
+                    ok = false;
+                }
+                catch (const std::exception &e)
+                {
+                    std::fprintf(stderr, "uncaught exception: %s\n", e.what());
+                    ok = false;
+                }
+                std::fprintf(stderr, "[ %s ] %s\n", ok ? " OK " : "FAIL", test.name);
+                failed += ok ? 0 : 1;
+            }
+            std::fprintf(stderr, "%zu tests, %d failed\n", Registry().size(), failed);
+            return failed == 0 ? 0 : 1;
+        }
+    }
+}
+
+#define TEST(suite, name)                                                                   \
+    static void suite##_##name##_Test();                                                    \
+    static const bool suite##_##name##_registered =                                         \
+        ::arrow::testing::RegisterTest(#suite "." #name, &suite##_##name##_Test);           \
+    static void suite##_##name##_Test()
+
+#define ASSERT_TRUE(cond)                                                   \
+    do                                                                      \
+    {                                                                       \
+        if (!(cond))                                                        \
+        {                                                                   \
+            ::arrow::testing::Fail(__FILE__, __LINE__, "expected " #cond);  \
+        }                                                                   \
+    } while (false)
+
+#define ASSERT_FALSE(cond) ASSERT_TRUE(!(cond))
+
+#define ASSERT_EQ(expected, actual)                                                          \
+    do                                                                                       \
+    {                                                                                        \
+        const auto &_expected = (expected);                                                  \
+        const auto &_actual = (actual);                                                      \
+        if (!(_expected == _actual))                                                         \
+        {                                                                                    \
+            ::arrow::testing::Fail(__FILE__, __LINE__,                                       \
+                                   "expected " #actual " == " #expected ", got " +           \
+                                       std::to_string(_actual) + " vs " +                    \
+                                       std::to_string(_expected));                           \
+        }                                                                                    \
+    } while (false)
+
+#define ASSERT_OK(expr)                                                                     \
+    do                                                                                      \
+    {                                                                                       \
+        const Status _status = (expr);                                                      \
+        if (!_status.ok())                                                                  \
+        {                                                                                   \
+            ::arrow::testing::Fail(__FILE__, __LINE__, #expr " failed: " + _status.ToString()); \
+        }                                                                                   \
+    } while (false)
+
+#define ASSERT_STATUS(expected_code, expr)                                                  \
+    do                                                                                      \
+    {                                                                                       \
+        const Status _status = (expr);                                                      \
+        if (_status.code() != (expected_code))                                              \
+        {                                                                                   \
+            ::arrow::testing::Fail(__FILE__, __LINE__,                                      \
+                                   #expr " returned " + _status.ToString() +                \
+                                       ", expected " #expected_code);                       \
+        }                                                                                   \
+    } while (false)
@@ -1,202 +1,2938 @@
 #include "thread_pool.h"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <deque>
+#include <functional>
+#include <iterator>
+#include <limits>
 #include <list>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "affinity.h"
 #include "cancel.h"
 #include "io_util.h"
 #include "macros.h"
+#include "mpmc_queue.h"
+#include "scratch_arena.h"
+#include "task_cache.h"
+#include "tenant_scheduler.h"
+#include "timer_wheel.h"
+#include "tracing.h"
+#include "work_stealing_queue.h"
 
 namespace arrow
 {
 
     Executor::~Executor() = default;
 
+    Status Executor::SpawnAtReal(TaskHints, TimerClock::time_point, internal::FnOnce<void()>,
+                                 StopToken)
+    {
+        return Status::Invalid("timers are not supported by this executor");
+    }
+
+    Status Executor::SpawnEveryReal(TaskHints, TimerClock::duration, std::function<void()>,
+                                    StopToken)
+    {
+        return Status::Invalid("timers are not supported by this executor");
+    }
+
+    Status Executor::SpawnBatchReal(std::vector<BatchTask> tasks)
+    {
+        for (auto &task : tasks)
+        {
+            Status st = SpawnReal(task.hints, std::move(task.callable), std::move(task.stop_token),
+                                  std::move(task.stop_callback));
+            if (!st.ok())
+            {
+                return st;
+            }
+        }
+        return Status::OK();
+    }
+
     namespace
     {
+        struct Task;
+        struct StopGroup;
+        using TaskCache = internal::SlabCache<Task>;
 
         struct Task
         {
             internal::FnOnce<void()> callable;
             StopToken stop_token;
             Executor::StopCallback stop_callback;
+            int band;
+            // Bytes accounted against the in-flight I/O budget, if any
+            int64_t io_size = 0;
+            // Preferred NUMA node, -1 for none
+            int numa_node = -1;
+            // When the task was spawned, see NowNanos()
+            int64_t enqueue_nanos = 0;
+            // Runs other tasks, which are accounted for one by one: strand
+            // drains and tenant dispatchers
+            bool dispatcher = false;
+            // The StopGroup of the token the task is linked in, set before it
+            // is queued. Whoever sets kTaskClaimed in stop_state, the runner
+            // or the stop of the source, owns the callable: a task dropped by
+            // the stop is left empty in its queue. The node is freed once
+            // both its queue and its group have let go of it.
+            StopGroup *stop_group = nullptr;
+            Task *stop_next = nullptr;
+            std::atomic<uint8_t> stop_state{0};
+
+            // `new (cache) Task{...}` takes a node from a worker's cache, or
+            // from the heap if cache is null; delete gives it back to either
+            static void *operator new(size_t size, TaskCache *cache);
+            static void operator delete(void *ptr);
+            static void operator delete(void *ptr, TaskCache *cache);
+        };
+
+        // Task::stop_state bits
+        constexpr uint8_t kTaskClaimed = 1;
+        constexpr uint8_t kTaskQueueReleased = 2;
+        constexpr uint8_t kTaskGroupReleased = 4;
+
+        using TaskQueue = internal::WorkStealingQueue<Task>;
+        using TaskNode = TaskCache::Node;
+
+        // Nodes a worker freed for another worker of its pool, see
+        // Task::operator delete. Flushed before parking and exiting.
+        thread_local internal::RemoteFreeBatch<Task> remote_frees_;
+
+        // A pending SpawnAt() / SpawnEvery() timer
+        struct Timer : internal::TimerWheel::Node
+        {
+            TaskHints hints;
+            // On the steady clock, see NowNanos()
+            int64_t deadline_nanos = 0;
+            // 0 for one-shot timers
+            int64_t period_nanos = 0;
+            internal::FnOnce<void()> once;
+            std::function<void()> repeat;
+            StopToken stop_token;
+            // The StopGroup of the token, set when the timer is armed and
+            // cleared when it is unlinked. stop_linked and the links are
+            // guarded by the group's mutex; the stop of the source unlinks
+            // the timer without clearing stop_group.
+            StopGroup *stop_group = nullptr;
+            bool stop_linked = false;
+            Timer *stop_prev = nullptr;
+            Timer *stop_next = nullptr;
+        };
+
+        struct StopShard;
+
+        // The queued tasks and armed timers of a pool whose token comes from
+        // one stop source, so that stopping the source drops them without
+        // scanning the queues. Spawns push their tasks with a CAS and runners
+        // claim them with an atomic OR, leaving them linked until a sweep, so
+        // that only stops, sweeps and retirement take the group's mutex. A
+        // group is retired once it holds nothing, and recycled; it is only
+        // freed with the pool, so that a stale pointer is safe to check.
+        struct StopGroup
+        {
+            StopShard *shard = nullptr;
+            // The source whose tasks the group holds, nullptr while retired;
+            // written under the shard's lock
+            std::atomic<const void *> source{nullptr};
+            std::atomic<bool> stopped{false};
+            // Set while the group may be retiring, see AcquireStopGroup()
+            std::atomic<bool> retiring{false};
+            // Tasks and timers linked and not yet claimed
+            std::atomic<int64_t> queued{0};
+            // Tasks linked through Task::stop_next, claimed ones included
+            std::atomic<Task *> tasks{nullptr};
+            std::atomic<int64_t> linked{0};
+            // Serializes sweeps, stops and retirement, and guards timers
+            std::mutex mutex_;
+            Timer *timers = nullptr;
+            StopRegistration registration;
+        };
+
+        // The StopGroups of the sources whose address hashes to the shard
+        struct StopShard
+        {
+            std::mutex mutex_;
+            std::unordered_map<const void *, StopGroup *> groups_;
+            // Every group of the shard, and the retired ones
+            std::deque<StopGroup> storage_;
+            std::vector<StopGroup *> free_;
+            // Registrations of retired groups, destroyed where no pool lock is
+            // held, as that waits for their callback if it is running
+            std::vector<StopRegistration> dead_registrations_;
+        };
+        constexpr int kNumStopShards = 16;
+
+        // The group the calling thread acquired last, see AcquireStopGroup()
+        struct StopGroupCache
+        {
+            uint64_t pool_id = 0;
+            const void *source = nullptr;
+            StopGroup *group = nullptr;
+        };
+        thread_local StopGroupCache stop_group_cache_;
+        std::atomic<uint64_t> next_pool_id_{1};
+        // Claimed tasks a group may keep linked beyond its queued ones
+        constexpr int64_t kMinStopSweep = 64;
+
+        void LinkStopTimer(Timer **head, Timer *timer)
+        {
+            timer->stop_prev = nullptr;
+            timer->stop_next = *head;
+            if (*head != nullptr)
+            {
+                (*head)->stop_prev = timer;
+            }
+            *head = timer;
+            timer->stop_linked = true;
+        }
+
+        void UnlinkStopTimer(Timer **head, Timer *timer)
+        {
+            if (timer->stop_prev != nullptr)
+            {
+                timer->stop_prev->stop_next = timer->stop_next;
+            }
+            else
+            {
+                *head = timer->stop_next;
+            }
+            if (timer->stop_next != nullptr)
+            {
+                timer->stop_next->stop_prev = timer->stop_prev;
+            }
+            timer->stop_prev = timer->stop_next = nullptr;
+            timer->stop_linked = false;
+        }
+
+        // Let go of the queue's hold on a task, freeing it unless its
+        // StopGroup still links it
+        void ReleaseTask(Task *task)
+        {
+            if (task->stop_group == nullptr ||
+                (task->stop_state.fetch_or(kTaskQueueReleased) & kTaskGroupReleased))
+            {
+                delete task;
+            }
+        }
+
+        // Same for the group's hold
+        void ReleaseTaskFromGroup(Task *task)
+        {
+            if (task->stop_state.fetch_or(kTaskGroupReleased) & kTaskQueueReleased)
+            {
+                delete task;
+            }
+        }
+
+        // Tasks dropped by a stop whose callbacks are left to run, split in
+        // chunks between the stopping thread and helper tasks
+        constexpr int kStopCallbackChunk = 128;
+        constexpr uint32_t kStopRunClosed = 1u << 31;
+
+        struct StopCallbackRun
+        {
+            struct Dropped
+            {
+                internal::FnOnce<void()> callable;
+                Executor::StopCallback stop_callback;
+            };
+
+            explicit StopCallbackRun(const Status &status) : status(status) {}
+
+            void Run()
+            {
+                const int64_t n = static_cast<int64_t>(tasks.size());
+                int64_t begin;
+                while ((begin = next.fetch_add(kStopCallbackChunk)) < n)
+                {
+                    const int64_t end = std::min(begin + kStopCallbackChunk, n);
+                    for (int64_t i = begin; i < end; ++i)
+                    {
+                        if (tasks[i].stop_callback)
+                        {
+                            std::move(tasks[i].stop_callback)(status);
+                        }
+                        tasks[i].callable = internal::FnOnce<void()>();
+                    }
+                }
+            }
+
+            // Register a helper, unless the stopping thread has already finished
+            bool Enter()
+            {
+                uint32_t value = entered.load();
+                do
+                {
+                    if (value & kStopRunClosed)
+                    {
+                        return false;
+                    }
+                } while (!entered.compare_exchange_weak(value, value + 1));
+                return true;
+            }
+
+            void Leave()
+            {
+                if (entered.fetch_sub(1) == (kStopRunClosed | 1))
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    cv.notify_one();
+                }
+            }
+
+            // Turn away helpers that have not started yet and wait for the
+            // ones that are running chunks
+            void CloseAndWait()
+            {
+                if (entered.fetch_or(kStopRunClosed) != 0)
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    cv.wait(lock, [this]
+                            { return entered.load() == kStopRunClosed; });
+                }
+            }
+
+            std::vector<Dropped> tasks;
+            const Status status;
+            std::atomic<int64_t> next{0};
+            // Number of running helpers, plus kStopRunClosed once the
+            // stopping thread is done
+            std::atomic<uint32_t> entered{0};
+            std::mutex mutex;
+            std::condition_variable cv;
+        };
+
+        // Timer resolution; timers never fire early
+        constexpr int64_t kTimerTickNanos = 1000000;
+        constexpr int64_t kNoTimer = std::numeric_limits<int64_t>::max();
+
+        int64_t NowNanos()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now().time_since_epoch())
+                .count();
+        }
+
+        // Counters of a worker. Only the worker writes them, with plain
+        // loads and stores, so that counting costs no atomic read-modify-write;
+        // GetMetrics() sums them up across workers.
+        struct WorkerStats
+        {
+            static void Add(std::atomic<int64_t> &counter, int64_t n)
+            {
+                counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+            }
+
+            void Record(std::atomic<int64_t> *histogram, int64_t nanos)
+            {
+                Add(histogram[LatencyHistogram::BucketFor(nanos)], 1);
+            }
+
+            std::atomic<int64_t> tasks_executed{0};
+            std::atomic<int64_t> tasks_cancelled{0};
+            std::atomic<int64_t> tasks_stolen{0};
+            std::atomic<int64_t> tasks_inlined{0};
+            std::atomic<int64_t> parks{0};
+            std::atomic<int64_t> wakeups{0};
+            std::atomic<int64_t> busy_nanos{0};
+            std::atomic<int64_t> idle_nanos{0};
+            std::atomic<int64_t> queue_wait[LatencyHistogram::kNumBuckets] = {};
+            std::atomic<int64_t> run_time[LatencyHistogram::kNumBuckets] = {};
+        };
+
+        // Run time estimates per callable type (FnOnce::target_type()), for
+        // tasks spawned without TaskHints::cpu_cost. A direct-mapped table
+        // only used by its worker. The estimate jumps to any longer run and
+        // decays slowly towards shorter ones, so that a type whose runs vary
+        // (e.g. recursive tasks) is not taken for cheap because most of its
+        // runs are.
+        class CostTable
+        {
+        public:
+            // -1 if the type was not seen often enough
+            int64_t Estimate(const void *type) const
+            {
+                const Entry &entry = entries_[SlotFor(type)];
+                return entry.type == type && entry.samples >= kMinSamples ? entry.nanos : -1;
+            }
+
+            void Record(const void *type, int64_t nanos)
+            {
+                Entry &entry = entries_[SlotFor(type)];
+                if (entry.type != type)
+                {
+                    entry = Entry{type, nanos, 0};
+                }
+                else if (nanos > entry.nanos)
+                {
+                    entry.nanos = nanos;
+                }
+                else
+                {
+                    entry.nanos -= (entry.nanos - nanos) / kDecay;
+                }
+                entry.samples = std::min(entry.samples + 1, kMinSamples);
+            }
+
+        private:
+            static constexpr int kSlotBits = 8;
+            static constexpr int kMinSamples = 8;
+            static constexpr int64_t kDecay = 16;
+
+            struct Entry
+            {
+                const void *type = nullptr;
+                int64_t nanos = 0;
+                int samples = 0;
+            };
+
+            static size_t SlotFor(const void *type)
+            {
+                const uint64_t hash = reinterpret_cast<uintptr_t>(type) * 0x9E3779B97F4A7C15ULL;
+                return hash >> (64 - kSlotBits);
+            }
+
+            Entry entries_[1 << kSlotBits];
+        };
+
+        // Hint to the CPU that we are busy-waiting
+        inline void CpuRelax()
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#elif defined(__aarch64__)
+            asm volatile("yield" ::: "memory");
+#endif
+        }
+
+        // A parked/unparked flag a single thread can sleep on, backed by a
+        // futex on Linux
+        class Parker
+        {
+        public:
+            // Mark the owner as parked, before it announces itself as idle
+            void Prepare() { state_.store(kParked, std::memory_order_relaxed); }
+
+            // Sleep until Unpark() is called after Prepare(), or for at most
+            // timeout_nanos if >= 0. Returns false on timeout.
+            bool Park(int64_t timeout_nanos = -1)
+            {
+                const int64_t deadline = timeout_nanos >= 0 ? NowNanos() + timeout_nanos : 0;
+                while (state_.load(std::memory_order_acquire) == kParked)
+                {
+                    int64_t remaining = -1;
+                    if (timeout_nanos >= 0)
+                    {
+                        remaining = deadline - NowNanos();
+                        if (remaining <= 0)
+                        {
+                            return false;
+                        }
+                    }
+#ifdef __linux__
+                    struct timespec timeout;
+                    timeout.tv_sec = remaining / 1000000000;
+                    timeout.tv_nsec = remaining % 1000000000;
+                    syscall(SYS_futex, &state_, FUTEX_WAIT_PRIVATE, kParked,
+                            remaining >= 0 ? &timeout : nullptr, nullptr, 0);
+#else
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    const auto unparked = [this]
+                    { return state_.load() != kParked; };
+                    if (remaining >= 0)
+                    {
+                        cv_.wait_for(lock, std::chrono::nanoseconds(remaining), unparked);
+                    }
+                    else
+                    {
+                        cv_.wait(lock, unparked);
+                    }
+#endif
+                }
+                return true;
+            }
+
+            void Unpark()
+            {
+                state_.store(kAwake, std::memory_order_release);
+#ifdef __linux__
+                syscall(SYS_futex, &state_, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#else
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                }
+                cv_.notify_one();
+#endif
+            }
+
+        private:
+            static constexpr uint32_t kAwake = 0;
+            static constexpr uint32_t kParked = 1;
+
+            std::atomic<uint32_t> state_{kAwake};
+#ifndef __linux__
+            std::mutex mutex_;
+            std::condition_variable cv_;
+#endif
         };
     }
 
     struct ThreadPool::State
     {
-        State() = default;
+        // Per-worker scheduling state. Slots are recycled across worker
+        // lifetimes and only freed with the State, so that thieves can walk
+        // the slot list without taking mutex_.
+        struct Worker
+        {
+            Worker(State *state, int index) : state_(state), index_(index), task_cache_(state) {}
+            ~Worker() { delete trace_.load(); }
+
+            // Whether a task hinted for `numa_node` should rather be queued
+            // for the workers of that node than run here
+            bool IsRemote(int numa_node) const
+            {
+                return numa_node >= 0 && numa_node != numa_node_.load(std::memory_order_relaxed);
+            }
+
+            State *const state_;
+            // Ordinal of the slot, selects the CPU under a pinning policy
+            const int index_;
+            TaskQueue local_tasks_[kNumPriorityBands];
+            Worker *next_ = nullptr; // immutable once published
+            bool in_use_ = false;    // guarded by mutex_
+            // Number of tasks picked so far, drives anti-starvation aging
+            uint64_t picks_ = 0;
+            // NUMA node the worker is pinned to, -1 if unpinned
+            std::atomic<int> numa_node_{-1};
+            // Last affinity_epoch_ applied by the worker
+            uint64_t affinity_epoch_ = 0;
+            // Nesting of blocking regions in the running task, and whether
+            // the outermost one got a compensating worker
+            int blocking_depth_ = 0;
+            bool compensated_ = false;
+            // Nesting of inline runs, and spawns since the last sample of
+            // the spawn cost
+            int inline_depth_ = 0;
+            uint32_t spawns_ = 0;
+            Parker parker_;
+            WorkerStats stats_;
+            CostTable costs_;
+            TaskCache task_cache_;
+            internal::ScratchArena scratch_;
+            // Allocated by the worker at its first traced event, then kept
+            std::atomic<internal::TraceBuffer *> trace_{nullptr};
+        };
+
+        // One FIFO per priority band, guarded by mutex_. The global queue
+        // also has a lock-free ring per band that external submitters push to
+        // first, falling back to the deque when it is full.
+        struct PendingQueues
+        {
+            Task *Pop(int band, std::mutex &mutex);
+            // Returns false if there is no ring or it is full
+            bool TryPushLockFree(Task *task);
+
+            std::deque<Task *> tasks_[kNumPriorityBands];
+            std::unique_ptr<internal::MpmcQueue<Task>> rings_[kNumPriorityBands];
+            // Tasks in both the deque and the ring
+            std::atomic<int64_t> size_[kNumPriorityBands] = {};
+        };
+
+        // Slots of each external submission ring
+        static constexpr size_t kExternalRingSize = 1024;
+
+        // Pending tasks of the strands whose id hashes to the shard. A
+        // strand is in the map while a drain task for it is queued or
+        // running, and is erased once the drain finds it empty.
+        struct StrandShard
+        {
+            std::mutex mutex_;
+            std::unordered_map<int64_t, std::deque<Task *>> strands_;
+        };
+        static constexpr int kNumStrandShards = 64;
+
+        using Tenant = internal::TenantQueue<Task>;
+
+        State();
+        ~State();
+
+        // Pick the next task for a worker. Bands are visited from the most to
+        // the least urgent, except that every kAgingPeriod-th pick starts the
+        // scan at a rotating lower band, so that low priorities keep making
+        // progress under sustained high-priority load. Within a band, the
+        // local deque comes first, then the global queue, then stealing.
+        // Returns nullptr if no work was found.
+        Task *NextTask(Worker *self);
+        // Pop from the worker's NUMA node queue, then the global queue, then
+        // the other nodes' queues
+        Task *PopPendingTask(Worker *self, int band);
+        // Steal from workers on the same NUMA node first
+        Task *StealTask(Worker *self, int band);
+        void PushPendingTaskUnlocked(Task *task);
+        // Account a task's io_size against the in-flight byte budget. Returns
+        // false if the task has to wait in throttled_tasks_ instead.
+        bool AdmitIOTaskUnlocked(Task *task);
+        // Release a finished task's bytes and admit waiting tasks
+        void ReleaseIOBytes(int64_t bytes);
+        bool HasQueuedTasks() const;
+        int64_t NumQueuedTasks() const;
+        int64_t NumQueuedTasks(int band) const;
+        Worker *AcquireWorkerUnlocked();
+        // Wake up to `n` sleeping workers after pushing tasks without the lock
+        void WakeIdleWorkers(int n);
+        // Wake up to `n` parked workers, most recently parked first
+        void UnparkWorkersUnlocked(int n);
+        void UnparkAllWorkersUnlocked() { UnparkWorkersUnlocked(std::numeric_limits<int>::max()); }
+        // Keep polling the queues for a while before parking, spinning with a
+        // CPU pause then yielding. Only one worker spins at a time, so pushers
+        // can skip waking a parked worker for the task it will pick up.
+        Task *SpinForTask(Worker *self);
+        // Pin the calling worker according to worker_cpus_
+        void ApplyAffinityUnlocked(Worker *self);
+        // Move all queued tasks out of the pending queues
+        void DrainPendingTasksUnlocked(std::vector<Task *> *out);
+        // Move all tasks out of the strands and the tenants' queues, once
+        // their drain and dispatcher tasks are gone
+        void DrainKeyedTasks(std::vector<Task *> *out);
+        // Autoscaling: add a worker to `pool` if `queue_wait` is over the
+        // threshold. A worker whose park timed out calls the latter to leave
+        // the idle list and learn whether it retires, in which case the
+        // capacity was lowered so that it secedes.
+        void GrowOnQueueWait(ThreadPool *pool, int64_t queue_wait);
+        bool RetireIdleWorkerUnlocked(Worker *self);
+        // The capacity without the workers compensating for blocked ones,
+        // which is what min_threads_ and max_threads_ bound
+        int AutoscaledCapacity() const { return desired_capacity_.load() - num_compensating_.load(); }
+        // Park timeout of idle workers, -1 if they should not retire
+        int64_t IdleTimeoutNanos() const;
+        // Queue a keyed task on its strand. Returns the task that drains the
+        // strand if it has to be scheduled, nullptr if one already is.
+        Task *EnqueueOnStrand(int64_t key, Task *task);
+        // Run up to kStrandBatch tasks of the strand, then requeue it
+        void DrainStrand(int64_t key);
+        StrandShard &StrandShardFor(int64_t key);
+        // Queue a tenant task. Returns a dispatcher to schedule if one more
+        // can run it, nullptr otherwise.
+        Task *EnqueueForTenant(int64_t tenant_id, Task *task);
+        // A new dispatcher if a tenant is runnable and fewer than the
+        // capacity are around, nullptr otherwise
+        Task *MaybeAddTenantDispatcherUnlocked(int band);
+        // Run up to kTenantBatch tenant tasks, then requeue
+        void DispatchTenantTasks();
+        // Queue a task without the shutdown check: on the calling worker's
+        // deque, or on the global queue if global or not called from a worker
+        void PushTask(Task *task, bool global);
+        // Add a timer to the wheel, waking a worker if it is due before the
+        // others. Returns false (dropping the timer) after shutdown.
+        bool ArmTimer(std::unique_ptr<Timer> timer);
+        // Spawn the timers that are due on `pool`
+        void RunTimers(ThreadPool *pool);
+        // Whether a task spawned from `self` into `band` should run inline
+        bool ShouldRunInline(Worker *self, const TaskHints &hints,
+                             const internal::FnOnce<void()> &task, int band) const;
+        // Fold a sampled spawn duration into spawn_cost_nanos_
+        void RecordSpawnCost(int64_t nanos);
+        // Whether spawns from outside the pool are over max_queued_tasks_
+        bool IsQueueFull() const;
+        // Account for n tasks that ran or were dropped
+        void FinishTasks(int n);
+        // Node cache of the calling worker for new tasks, nullptr (the heap)
+        // if not called from one of our workers
+        TaskCache *LocalTaskCache() const;
+        StopShard &StopShardFor(const void *source);
+        // Link the task or timer in the StopGroup of its token, before it is
+        // queued, unless the token cannot or did trigger
+        void IndexTask(Task *task);
+        void IndexTimer(Timer *timer);
+        // Claim the task before running or dropping it. Returns false if the
+        // stop of its source did, leaving it empty.
+        bool ClaimTask(Task *task)
+        {
+            if (task->stop_group == nullptr)
+            {
+                return true;
+            }
+            if (task->stop_state.fetch_or(kTaskClaimed) & kTaskClaimed)
+            {
+                return false;
+            }
+            ReleaseStopGroup(task->stop_group, 1, /*can_reap=*/true);
+            return true;
+        }
+        // Unlink the timer before running or freeing it. Returns false if the
+        // stop of its source did, leaving it to be freed.
+        bool UnindexTimer(Timer *timer, bool can_reap);
+        // The group of the token's source, with one more queued node counted,
+        // or nullptr if the source triggered. Lock-free if the calling thread
+        // used that group last.
+        StopGroup *AcquireStopGroup(const StopToken &token);
+        // Count n nodes of the group as no longer queued, retiring it if it
+        // is left empty. can_reap tells that no pool lock is held, to destroy
+        // the registrations of retired groups.
+        void ReleaseStopGroup(StopGroup *group, int64_t n, bool can_reap);
+        void RetireStopGroup(StopGroup *group, bool can_reap);
+        // Free the tasks claimed since the last sweep, unless the group is busy
+        void SweepStopGroup(StopGroup *group);
+        // The stop callback of `group`: drop its tasks, running their stop
+        // callbacks on the workers, and timers
+        void DropStopGroup(const void *source, StopGroup *group, const Status &status);
+        // Block until the queue has room again or shutdown starts
+        void WaitForQueueSpace();
+        // Record an event if tracing is on; hints only come with enqueues
+        void Trace(internal::TraceEvent::Type type, const Task *task, const TaskHints *hints = nullptr)
+        {
+            if (ARROW_PREDICT_FALSE(tracing_.load(std::memory_order_relaxed)))
+            {
+                RecordTraceEvent(type, task, hints);
+            }
+        }
+        void RecordTraceEvent(internal::TraceEvent::Type type, const Task *task, const TaskHints *hints);
 
         std::mutex mutex_;
-        std::condition_variable cv_;
         std::condition_variable cv_shutdown_;
         std::condition_variable cv_idle_;
+        // Signalled when a task finishes while submitters are blocked
+        std::condition_variable cv_space_;
 
         std::list<std::thread> workers_;
         std::vector<std::thread> finished_workers_;
-        std::deque<Task> pending_tasks_;
+        // Tasks spawned from outside the pool
+        PendingQueues pending_tasks_;
+        // Tasks hinted for a NUMA node, one entry per node
+        std::vector<PendingQueues> node_pending_tasks_;
+        // CPUs of the process when the pool was created
+        const std::vector<int> allowed_cpus_;
+        // CPU for each worker slot index (modulo size), empty if unpinned;
+        // guarded by mutex_
+        std::vector<int> worker_cpus_;
+        std::atomic<uint64_t> affinity_epoch_{0};
+        // Tasks waiting for in-flight I/O bytes to be released, FIFO
+        std::deque<Task *> throttled_tasks_;
+        // 0 means unlimited; written under mutex_
+        std::atomic<int64_t> max_inflight_bytes_{0};
+        int64_t inflight_bytes_ = 0;
+        // Head of the singly-linked list of worker slots
+        std::atomic<Worker *> worker_slots_{nullptr};
+
+        std::atomic<int> desired_capacity_{0};
+        std::atomic<int> num_workers_{0};
+        // Number of workers in idle_workers_
+        std::atomic<int> num_sleeping_{0};
+        // Parked workers, guarded by mutex_
+        std::vector<Worker *> idle_workers_;
+        std::atomic<int> num_spinning_{0};
+        std::atomic<int> spin_rounds_{ParkingOptions{}.spin_rounds};
+        std::atomic<int> yield_rounds_{ParkingOptions{}.yield_rounds};
 
-        int desired_capacity_ = 0;
+        std::atomic<int> tasks_queued_or_running_{0};
+        // 0 means unlimited; written under mutex_
+        std::atomic<int64_t> max_queued_tasks_{0};
+        std::atomic<BackpressurePolicy> backpressure_policy_{BackpressurePolicy::kBlock};
+        // Submitters waiting on cv_space_
+        std::atomic<int> num_blocked_submitters_{0};
+        // Capacity added for workers in blocking regions, and its cap;
+        // written under mutex_
+        std::atomic<int> num_compensating_{0};
+        int max_compensation_ = ThreadPool::DefaultCapacity();
+        std::atomic<int> num_blocked_{0};
+        StrandShard strand_shards_[kNumStrandShards];
+        std::mutex tenant_mutex_;
+        // Guarded by tenant_mutex_
+        internal::TenantScheduler<Task> tenants_;
+        // Tenant dispatchers queued or running
+        int tenant_dispatchers_ = 0;
+        // Pending timers, guarded by timer_mutex_
+        std::mutex timer_mutex_;
+        internal::TimerWheel timers_{NowNanos() / kTimerTickNanos};
+        // When the wheel has something to do next, kNoTimer if it is empty
+        std::atomic<int64_t> next_timer_nanos_{kNoTimer};
+        // The parked worker sleeping until next_timer_nanos_, guarded by mutex_
+        Worker *timer_waiter_ = nullptr;
+        // Autoscaling parameters, written under mutex_
+        std::atomic<bool> autoscaling_{false};
+        std::atomic<int> min_threads_{1};
+        std::atomic<int> max_threads_{0};
+        std::atomic<int64_t> idle_timeout_nanos_{0};
+        std::atomic<int64_t> grow_queue_wait_nanos_{0};
+        // Last time the capacity was raised for latency
+        std::atomic<int64_t> last_grow_nanos_{0};
+        // Inlining parameters, see InlineOptions
+        std::atomic<int64_t> max_inline_cost_nanos_{InlineOptions{}.max_cost_nanos};
+        std::atomic<int> saturated_queue_depth_{InlineOptions{}.saturated_queue_depth};
+        std::atomic<int> max_inline_depth_{InlineOptions{}.max_depth};
+        // Moving average of sampled spawns from workers, with a guess
+        // (about a futex wakeup) until the first sample
+        std::atomic<int64_t> spawn_cost_nanos_{2000};
+        // External threads between their shutdown check and the end of a
+        // lock-free push; workers do not exit while there are some
+        std::atomic<int> num_external_pushers_{0};
 
-        int tasks_queued_or_running_ = 0;
+        StopShard stop_shards_[kNumStopShards];
+        // Tells the pools apart in stop_group_cache_
+        const uint64_t id_ = next_pool_id_.fetch_add(1);
+        // Held by the stop callbacks, see AcquireStopGroup()
+        std::weak_ptr<void> weak_self_;
+        // Tasks dropped by stops outside of the workers, see GetMetrics()
+        std::atomic<int64_t> tasks_cancelled_{0};
 
-        bool please_shutdown_ = false;
-        bool quick_shutdown_ = false;
+        // Tracing, see ThreadPool::EnableTracing(). The capacity of the rings
+        // and the ring of outside threads are set once, under mutex_, like
+        // the clock readings that calibrate internal::TraceTicks().
+        std::atomic<bool> tracing_{false};
+        std::atomic<size_t> trace_capacity_{0};
+        std::atomic<internal::TraceBuffer *> external_trace_{nullptr};
+        uint64_t trace_base_ticks_ = 0;
+        int64_t trace_base_nanos_ = 0;
+
+        std::atomic<bool> please_shutdown_{false};
+        std::atomic<bool> quick_shutdown_{false};
     };
 
-    static void WorkerLoop(std::shared_ptr<ThreadPool::State> state,
-                           std::list<std::thread>::iterator it)
+    // The worker slot run by the current thread, if any
+    thread_local ThreadPool::State::Worker *current_worker_ = nullptr;
+    thread_local ThreadPool *current_thread_pool_ = nullptr;
+
+    void *Task::operator new(size_t, TaskCache *cache)
     {
-        std::unique_lock<std::mutex> lock(state->mutex_);
+        TaskNode *node;
+        if (cache != nullptr)
+        {
+            node = cache->Allocate();
+        }
+        else
+        {
+            node = new TaskNode;
+            node->owner = nullptr;
+        }
+        return node->storage;
+    }
 
-        DCHECK_EQ(std::this_thread::get_id(), it->get_id());
+    void Task::operator delete(void *ptr)
+    {
+        auto *node = reinterpret_cast<TaskNode *>(ptr);
+        TaskCache *owner = node->owner;
+        ThreadPool::State::Worker *self = current_worker_;
+        if (owner == nullptr)
+        {
+            delete node;
+        }
+        else if (self != nullptr && &self->task_cache_ == owner)
+        {
+            owner->Free(node);
+        }
+        else if (self == nullptr || owner->pool() != self->state_)
+        {
+            // We may never flush a batch
+            owner->FreeRemote(node, node);
+        }
+        else
+        {
+            remote_frees_.Add(node);
+        }
+    }
 
-        // If too many threads, we should secede[脱离] from the pool
-        const auto should_secede = [&]() -> bool
+    void Task::operator delete(void *ptr, TaskCache *) { operator delete(ptr); }
+
+    TaskCache *ThreadPool::State::LocalTaskCache() const
+    {
+        Worker *worker = current_worker_;
+        return worker != nullptr && worker->state_ == this ? &worker->task_cache_ : nullptr;
+    }
+
+    ThreadPool::State::State()
+        : node_pending_tasks_(internal::GetNumaNodeCount()),
+          allowed_cpus_(internal::GetAllowedCpus())
+    {
+        for (auto &ring : pending_tasks_.rings_)
         {
-            return state->workers_.size() > static_cast<size_t>(state->desired_capacity_);
-        };
+            ring.reset(new internal::MpmcQueue<Task>(kExternalRingSize));
+        }
+    }
 
-        while (true)
+    ThreadPool::State::~State()
+    {
+        // The tasks are freed once both their group and their queue let go
+        for (auto &shard : stop_shards_)
         {
-            while (!state->pending_tasks_.empty() && !state->quick_shutdown_)
+            shard.dead_registrations_.clear();
+            for (StopGroup &group : shard.storage_)
             {
-                if (should_secede())
+                group.registration.Reset();
+                Task *task = group.tasks.exchange(nullptr);
+                while (task != nullptr)
                 {
-                    break;
+                    Task *next = task->stop_next;
+                    ReleaseTaskFromGroup(task);
+                    task = next;
                 }
-
-                DCHECK_GE(state->tasks_queued_or_running_, 0);
+            }
+        }
+        std::vector<Task *> tasks;
+        DrainPendingTasksUnlocked(&tasks);
+        for (Task *task : tasks)
+        {
+            ReleaseTask(task);
+        }
+        for (Task *task : throttled_tasks_)
+        {
+            ReleaseTask(task);
+        }
+        std::vector<internal::TimerWheel::Node *> timers;
+        timers_.Clear(&timers);
+        for (auto *timer : timers)
+        {
+            delete static_cast<Timer *>(timer);
+        }
+        for (auto &shard : strand_shards_)
+        {
+            for (auto &strand : shard.strands_)
+            {
+                for (Task *task : strand.second)
                 {
-                    Task task = std::move(state->pending_tasks_.front());
-                    state->pending_tasks_.pop_front();
-                    StopToken *stop_token = &task.stop_token;
-                    lock.unlock();
-                    if (!stop_token->IsStopRequested())
-                    {
-                        std::move(task.callable)();
-                    }
-                    else
-                    {
-                        if (task.stop_callback)
-                        {
-                            std::move(task.stop_callback)(stop_token->Poll());
-                        }
-                    }
-                    ARROW_UNUSED(std::move(task)); // release resources before waiting for lock
-                    lock.lock();
+                    ReleaseTask(task);
                 }
-                if (ARROW_PREDICT_FALSE(--state->tasks_queued_or_running_ == 0))
+            }
+        }
+        for (const auto &entry : tenants_.tenants())
+        {
+            for (Task *task : entry.second.pending_)
+            {
+                ReleaseTask(task);
+            }
+        }
+        Worker *worker = worker_slots_.load();
+        while (worker != nullptr)
+        {
+            for (auto &local_tasks : worker->local_tasks_)
+            {
+                while (Task *task = local_tasks.Pop())
                 {
-                    state->cv_idle_.notify_all();
+                    ReleaseTask(task);
                 }
             }
-            if (state->please_shutdown_ || should_secede())
+            Worker *next = worker->next_;
+            delete worker;
+            worker = next;
+        }
+        delete external_trace_.load();
+    }
+
+    Task *ThreadPool::State::NextTask(Worker *self)
+    {
+        constexpr uint64_t kAgingPeriod = 16;
+        const uint64_t pick = self->picks_++;
+        int first_band = 0;
+        if (pick % kAgingPeriod == kAgingPeriod - 1)
+        {
+            first_band = 1 + static_cast<int>((pick / kAgingPeriod) % (kNumPriorityBands - 1));
+        }
+        for (int i = 0; i < kNumPriorityBands; ++i)
+        {
+            const int band = (first_band + i) % kNumPriorityBands;
+            if (Task *task = self->local_tasks_[band].Pop())
             {
-                break;
+                return task;
+            }
+            if (Task *task = PopPendingTask(self, band))
+            {
+                return task;
             }
-            state->cv_.wait(lock);
         }
-        DCHECK_GE(state->tasks_queued_or_running_, 0);
-        DCHECK_EQ(std::this_thread::get_id(), it->get_id());
-        state->finished_workers_.push_back(std::move(*it));
-        state->workers_.erase(it);
-        if (state->please_shutdown_)
+        for (int i = 0; i < kNumPriorityBands; ++i)
         {
-            state->cv_shutdown_.notify_one();
-        }
+            if (Task *task = StealTask(self, (first_band + i) % kNumPriorityBands))
+            {
+                WorkerStats::Add(self->stats_.tasks_stolen, 1);
+                Trace(internal::TraceEvent::kSteal, task);
+                return task;
+            }
+        }
+        return nullptr;
+    }
+
+    Task *ThreadPool::State::PendingQueues::Pop(int band, std::mutex &mutex)
+    {
+        if (size_[band].load(std::memory_order_relaxed) == 0)
+        {
+            return nullptr;
+        }
+        if (rings_[band] != nullptr)
+        {
+            if (Task *task = rings_[band]->TryPop())
+            {
+                size_[band].fetch_sub(1, std::memory_order_relaxed);
+                return task;
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        auto &pending = tasks_[band];
+        if (pending.empty())
+        {
+            return nullptr;
+        }
+        Task *task = pending.front();
+        pending.pop_front();
+        size_[band].fetch_sub(1, std::memory_order_relaxed);
+        return task;
+    }
+
+    bool ThreadPool::State::PendingQueues::TryPushLockFree(Task *task)
+    {
+        auto &ring = rings_[task->band];
+        if (ring == nullptr)
+        {
+            return false;
+        }
+        // Count the task first so that it is never seen popped but not counted
+        size_[task->band].fetch_add(1);
+        if (!ring->TryPush(task))
+        {
+            size_[task->band].fetch_sub(1);
+            return false;
+        }
+        return true;
+    }
+
+    Task *ThreadPool::State::PopPendingTask(Worker *self, int band)
+    {
+        const int node = self->numa_node_.load(std::memory_order_relaxed);
+        if (node >= 0)
+        {
+            if (Task *task = node_pending_tasks_[node].Pop(band, mutex_))
+            {
+                return task;
+            }
+        }
+        if (Task *task = pending_tasks_.Pop(band, mutex_))
+        {
+            return task;
+        }
+        for (int other = 0; other < static_cast<int>(node_pending_tasks_.size()); ++other)
+        {
+            if (other == node)
+            {
+                continue;
+            }
+            if (Task *task = node_pending_tasks_[other].Pop(band, mutex_))
+            {
+                return task;
+            }
+        }
+        return nullptr;
+    }
+
+    void ThreadPool::State::PushPendingTaskUnlocked(Task *task)
+    {
+        const bool has_node =
+            task->numa_node >= 0 && task->numa_node < static_cast<int>(node_pending_tasks_.size());
+        PendingQueues &queues = has_node ? node_pending_tasks_[task->numa_node] : pending_tasks_;
+        queues.tasks_[task->band].push_back(task);
+        queues.size_[task->band].fetch_add(1);
+    }
+
+    void ThreadPool::State::DrainKeyedTasks(std::vector<Task *> *out)
+    {
+        for (auto &shard : strand_shards_)
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex_);
+            for (auto &strand : shard.strands_)
+            {
+                out->insert(out->end(), strand.second.begin(), strand.second.end());
+            }
+            shard.strands_.clear();
+        }
+        std::lock_guard<std::mutex> lock(tenant_mutex_);
+        tenants_.Drain(out);
+        // None runs anymore, the queued ones were dropped
+        tenant_dispatchers_ = 0;
+    }
+
+    void ThreadPool::State::DrainPendingTasksUnlocked(std::vector<Task *> *out)
+    {
+        const auto drain = [&](PendingQueues &queues)
+        {
+            for (int band = 0; band < kNumPriorityBands; ++band)
+            {
+                out->insert(out->end(), queues.tasks_[band].begin(), queues.tasks_[band].end());
+                queues.tasks_[band].clear();
+                if (queues.rings_[band] != nullptr)
+                {
+                    while (Task *task = queues.rings_[band]->TryPop())
+                    {
+                        out->push_back(task);
+                    }
+                }
+                queues.size_[band] = 0;
+            }
+        };
+        drain(pending_tasks_);
+        for (auto &queues : node_pending_tasks_)
+        {
+            drain(queues);
+        }
+    }
+
+    void ThreadPool::State::GrowOnQueueWait(ThreadPool *pool, int64_t queue_wait)
+    {
+        const int64_t threshold = grow_queue_wait_nanos_.load(std::memory_order_relaxed);
+        if (queue_wait < threshold || AutoscaledCapacity() >= max_threads_.load(std::memory_order_relaxed))
+        {
+            return;
+        }
+        // Grow by one worker per threshold period at most, so that the new
+        // worker has a chance to bring the wait down first
+        const int64_t now = NowNanos();
+        int64_t last = last_grow_nanos_.load(std::memory_order_relaxed);
+        if (now - last < threshold || !last_grow_nanos_.compare_exchange_strong(last, now))
+        {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (please_shutdown_ || !autoscaling_)
+        {
+            return;
+        }
+        // Workers are launched lazily: only raise the capacity if we are at it
+        const int workers = static_cast<int>(workers_.size());
+        if (workers >= desired_capacity_ && AutoscaledCapacity() < max_threads_)
+        {
+            ++desired_capacity_;
+        }
+        if (workers < desired_capacity_ && HasQueuedTasks())
+        {
+            pool->CollectFinishedWorkersUnlocked();
+            pool->LaunchWorkersUnlocked(/*threads=*/1);
+        }
+    }
+
+    bool ThreadPool::State::RetireIdleWorkerUnlocked(Worker *self)
+    {
+        auto idle = std::find(idle_workers_.begin(), idle_workers_.end(), self);
+        if (idle == idle_workers_.end())
+        {
+            // Unparked after the timeout
+            return false;
+        }
+        idle_workers_.erase(idle);
+        num_sleeping_.fetch_sub(1);
+        if (timer_waiter_ == self)
+        {
+            // Woken up for a timer
+            timer_waiter_ = nullptr;
+            return false;
+        }
+        // Like the re-check before parking: a task pushed while we were
+        // leaving the idle list may have counted on us
+        const int compensating = num_compensating_.load();
+        const int workers = num_workers_.load();
+        if (!autoscaling_ || please_shutdown_ || workers - compensating <= min_threads_ ||
+            HasQueuedTasks())
+        {
+            return false;
+        }
+        desired_capacity_ =
+            std::max(min_threads_.load(), std::min(desired_capacity_.load(), workers) - compensating - 1) +
+            compensating;
+        return true;
+    }
+
+    int64_t ThreadPool::State::IdleTimeoutNanos() const
+    {
+        if (!autoscaling_.load(std::memory_order_relaxed) ||
+            num_workers_.load(std::memory_order_relaxed) - num_compensating_.load(std::memory_order_relaxed) <=
+                min_threads_.load(std::memory_order_relaxed))
+        {
+            return -1;
+        }
+        return idle_timeout_nanos_.load(std::memory_order_relaxed);
+    }
+
+    bool ThreadPool::State::ArmTimer(std::unique_ptr<Timer> timer)
+    {
+        bool earlier;
+        {
+            std::lock_guard<std::mutex> lock(timer_mutex_);
+            if (please_shutdown_)
+            {
+                return false;
+            }
+            // Under the lock, so that an indexed timer is in the wheel or
+            // expired
+            IndexTimer(timer.get());
+            if (timers_.empty())
+            {
+                // Catch up with the clock, there is nothing to expire
+                timers_.Advance(NowNanos() / kTimerTickNanos, nullptr);
+            }
+            const int64_t deadline = std::min(timer->deadline_nanos, kNoTimer - kTimerTickNanos);
+            timer->tick = (deadline + kTimerTickNanos - 1) / kTimerTickNanos;
+            timers_.Insert(timer.release());
+            const int64_t next = timers_.NextEventTick() * kTimerTickNanos;
+            earlier = next < next_timer_nanos_.load();
+            next_timer_nanos_ = next;
+        }
+        if (earlier)
+        {
+            // The timer waiter has to shorten its sleep, or an idle worker
+            // takes that role
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (Worker *waiter = timer_waiter_)
+            {
+                timer_waiter_ = nullptr;
+                // Unless already awake, then it sees the new timer anyway
+                auto idle = std::find(idle_workers_.begin(), idle_workers_.end(), waiter);
+                if (idle != idle_workers_.end())
+                {
+                    idle_workers_.erase(idle);
+                    num_sleeping_.fetch_sub(1);
+                    waiter->parker_.Unpark();
+                }
+            }
+            else
+            {
+                UnparkWorkersUnlocked(1);
+            }
+        }
+        return true;
+    }
+
+    void ThreadPool::State::RunTimers(ThreadPool *pool)
+    {
+        std::vector<internal::TimerWheel::Node *> expired;
+        {
+            std::lock_guard<std::mutex> lock(timer_mutex_);
+            const int64_t now = NowNanos();
+            if (now < next_timer_nanos_.load())
+            {
+                // Another worker got there first
+                return;
+            }
+            timers_.Advance(now / kTimerTickNanos, &expired);
+            const int64_t next = timers_.NextEventTick();
+            next_timer_nanos_ = next == kNoTimer ? kNoTimer : next * kTimerTickNanos;
+        }
+        for (auto *node : expired)
+        {
+            std::unique_ptr<Timer> timer(static_cast<Timer *>(node));
+            if (!UnindexTimer(timer.get(), /*can_reap=*/true) || timer->stop_token.IsStopRequested())
+            {
+                continue;
+            }
+            const TaskHints hints = timer->hints;
+            StopToken stop_token = timer->stop_token;
+            if (timer->period_nanos == 0)
+            {
+                ARROW_UNUSED(pool->SpawnReal(hints, std::move(timer->once), std::move(stop_token),
+                                             StopCallback{}));
+                continue;
+            }
+            // The run re-arms the timer, so that runs never overlap
+            ARROW_UNUSED(pool->SpawnReal(
+                hints, [this, timer = std::move(timer)]() mutable
+                {
+                    timer->repeat();
+                    const int64_t now = NowNanos();
+                    const int64_t period = timer->period_nanos;
+                    int64_t next = timer->deadline_nanos + period;
+                    if (next <= now)
+                    {
+                        next += ((now - next) / period + 1) * period;
+                    }
+                    timer->deadline_nanos = next;
+                    if (!timer->stop_token.IsStopRequested())
+                    {
+                        ArmTimer(std::move(timer));
+                    } },
+                std::move(stop_token), StopCallback{}));
+        }
+    }
+
+    bool ThreadPool::State::IsQueueFull() const
+    {
+        const int64_t max_queued = max_queued_tasks_.load(std::memory_order_relaxed);
+        // Sequentially consistent, pairs with the check of
+        // num_blocked_submitters_ in RunTask()
+        return max_queued > 0 &&
+               tasks_queued_or_running_.load() >= max_queued + desired_capacity_.load();
+    }
+
+    bool ThreadPool::State::ShouldRunInline(Worker *self, const TaskHints &hints,
+                                            const internal::FnOnce<void()> &task, int band) const
+    {
+        if (self->inline_depth_ >= max_inline_depth_.load(std::memory_order_relaxed))
+        {
+            return false;
+        }
+        int64_t max_cost = max_inline_cost_nanos_.load(std::memory_order_relaxed);
+        if (max_cost < 0)
+        {
+            max_cost = spawn_cost_nanos_.load(std::memory_order_relaxed);
+        }
+        const int64_t cost =
+            hints.cpu_cost >= 0 ? hints.cpu_cost : self->costs_.Estimate(task.target_type());
+        if (cost >= 0 && cost < max_cost)
+        {
+            return true;
+        }
+        // Nobody would pick the task up soon anyway
+        const int depth = saturated_queue_depth_.load(std::memory_order_relaxed);
+        return depth > 0 && self->local_tasks_[band].Size() >= depth &&
+               num_sleeping_.load(std::memory_order_relaxed) == 0 &&
+               num_spinning_.load(std::memory_order_relaxed) == 0 &&
+               num_workers_.load(std::memory_order_relaxed) >=
+                   desired_capacity_.load(std::memory_order_relaxed);
+    }
+
+    void ThreadPool::State::RecordSpawnCost(int64_t nanos)
+    {
+        // Lost updates between workers do not matter for an average
+        const int64_t cost = spawn_cost_nanos_.load(std::memory_order_relaxed);
+        spawn_cost_nanos_.store(cost + (nanos - cost) / 8, std::memory_order_relaxed);
+    }
+
+    void ThreadPool::State::WaitForQueueSpace()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        num_blocked_submitters_.fetch_add(1);
+        cv_space_.wait(lock, [this]
+                       { return please_shutdown_.load() || !IsQueueFull(); });
+        num_blocked_submitters_.fetch_sub(1);
+    }
+
+    bool ThreadPool::State::AdmitIOTaskUnlocked(Task *task)
+    {
+        const int64_t max_bytes = max_inflight_bytes_.load();
+        // A task larger than the whole budget is admitted once nothing else is
+        // in flight; earlier waiters go first.
+        if (max_bytes > 0 && (!throttled_tasks_.empty() ||
+                              (inflight_bytes_ > 0 && inflight_bytes_ + task->io_size > max_bytes)))
+        {
+            throttled_tasks_.push_back(task);
+            return false;
+        }
+        inflight_bytes_ += task->io_size;
+        return true;
+    }
+
+    void ThreadPool::State::ReleaseIOBytes(int64_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        inflight_bytes_ -= bytes;
+        const int64_t max_bytes = max_inflight_bytes_.load();
+        while (!throttled_tasks_.empty())
+        {
+            Task *task = throttled_tasks_.front();
+            if (max_bytes > 0 && inflight_bytes_ > 0 && inflight_bytes_ + task->io_size > max_bytes)
+            {
+                break;
+            }
+            throttled_tasks_.pop_front();
+            inflight_bytes_ += task->io_size;
+            PushPendingTaskUnlocked(task);
+            UnparkWorkersUnlocked(1);
+        }
+    }
+
+    Task *ThreadPool::State::StealTask(Worker *self, int band)
+    {
+        // Start right after ourselves so that thieves spread over victims
+        Worker *head = worker_slots_.load(std::memory_order_acquire);
+        Worker *start = self->next_ != nullptr ? self->next_ : head;
+        const int node = self->numa_node_.load(std::memory_order_relaxed);
+        // First pass on our own node only, if we are pinned to one
+        for (int pass = node >= 0 ? 0 : 1; pass < 2; ++pass)
+        {
+            Worker *victim = start;
+            do
+            {
+                if (victim != self &&
+                    (pass == 1 || victim->numa_node_.load(std::memory_order_relaxed) == node))
+                {
+                    if (Task *task = victim->local_tasks_[band].Steal())
+                    {
+                        return task;
+                    }
+                }
+                victim = victim->next_ != nullptr ? victim->next_ : head;
+            } while (victim != start);
+        }
+        return nullptr;
+    }
+
+    int64_t ThreadPool::State::NumQueuedTasks(int band) const
+    {
+        int64_t n = pending_tasks_.size_[band].load();
+        for (const auto &queues : node_pending_tasks_)
+        {
+            n += queues.size_[band].load();
+        }
+        for (Worker *w = worker_slots_.load(); w != nullptr; w = w->next_)
+        {
+            n += w->local_tasks_[band].Size();
+        }
+        return n;
+    }
+
+    int64_t ThreadPool::State::NumQueuedTasks() const
+    {
+        int64_t n = 0;
+        for (int band = 0; band < kNumPriorityBands; ++band)
+        {
+            n += NumQueuedTasks(band);
+        }
+        return n;
+    }
+
+    bool ThreadPool::State::HasQueuedTasks() const { return NumQueuedTasks() > 0; }
+
+    ThreadPool::State::Worker *ThreadPool::State::AcquireWorkerUnlocked()
+    {
+        for (Worker *w = worker_slots_.load(); w != nullptr; w = w->next_)
+        {
+            if (!w->in_use_)
+            {
+                w->in_use_ = true;
+                return w;
+            }
+        }
+        int index = 0;
+        for (Worker *w = worker_slots_.load(); w != nullptr; w = w->next_)
+        {
+            ++index;
+        }
+        auto *w = new Worker(this, index);
+        w->in_use_ = true;
+        w->next_ = worker_slots_.load();
+        worker_slots_.store(w, std::memory_order_release);
+        return w;
+    }
+
+    void ThreadPool::State::WakeIdleWorkers(int n)
+    {
+        // Pairs with the fence in WorkerLoop before re-checking the queues,
+        // so that either the sleeper sees the new task or we see the sleeper.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (num_sleeping_.load(std::memory_order_relaxed) == 0)
+        {
+            return;
+        }
+        // The spinning worker, if any, takes one of the tasks
+        if (num_spinning_.load(std::memory_order_relaxed) > 0 && --n == 0)
+        {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        UnparkWorkersUnlocked(n);
+    }
+
+    void ThreadPool::State::UnparkWorkersUnlocked(int n)
+    {
+        for (; n > 0 && !idle_workers_.empty(); --n)
+        {
+            // Leave the timer waiter asleep while another worker can go
+            if (idle_workers_.back() == timer_waiter_ && idle_workers_.size() > 1)
+            {
+                std::swap(idle_workers_.back(), idle_workers_[idle_workers_.size() - 2]);
+            }
+            Worker *worker = idle_workers_.back();
+            idle_workers_.pop_back();
+            if (worker == timer_waiter_)
+            {
+                timer_waiter_ = nullptr;
+            }
+            num_sleeping_.fetch_sub(1);
+            worker->parker_.Unpark();
+        }
+    }
+
+    Task *ThreadPool::State::SpinForTask(Worker *self)
+    {
+        constexpr int kPausesPerRound = 16;
+        const int spin_rounds = spin_rounds_.load(std::memory_order_relaxed);
+        const int rounds = spin_rounds + yield_rounds_.load(std::memory_order_relaxed);
+        int expected = 0;
+        if (rounds == 0 || num_spinning_.load(std::memory_order_relaxed) != 0 ||
+            !num_spinning_.compare_exchange_strong(expected, 1))
+        {
+            return nullptr;
+        }
+        Task *task = nullptr;
+        for (int round = 0; round < rounds && task == nullptr; ++round)
+        {
+            if (please_shutdown_.load(std::memory_order_relaxed) ||
+                num_workers_.load(std::memory_order_relaxed) >
+                    desired_capacity_.load(std::memory_order_relaxed))
+            {
+                break;
+            }
+            if (round < spin_rounds)
+            {
+                for (int i = 0; i < kPausesPerRound; ++i)
+                {
+                    CpuRelax();
+                }
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+            task = NextTask(self);
+        }
+        num_spinning_.store(0);
+        if (task != nullptr && HasQueuedTasks())
+        {
+            // Pushers may have counted on us for more than this task
+            WakeIdleWorkers(1);
+        }
+        return task;
+    }
+
+    void ThreadPool::State::ApplyAffinityUnlocked(Worker *self)
+    {
+        self->affinity_epoch_ = affinity_epoch_.load();
+        if (worker_cpus_.empty())
+        {
+            if (self->numa_node_.load() >= 0)
+            {
+                // Let the kernel schedule us anywhere again
+                (void)internal::SetCurrentThreadAffinity(allowed_cpus_);
+                self->numa_node_ = -1;
+            }
+            return;
+        }
+        const int cpu = worker_cpus_[self->index_ % worker_cpus_.size()];
+        if (internal::SetCurrentThreadAffinity({cpu}).ok())
+        {
+            self->numa_node_ = internal::GetCpuNumaNode(cpu);
+        }
+    }
+
+    static void RunTask(ThreadPool::State *state, ThreadPool::State::Worker *self, Task *task)
+    {
+        WorkerStats &stats = self->stats_;
+        bool dropped = false;
+        if (ARROW_PREDICT_FALSE(task->dispatcher))
+        {
+            std::move(task->callable)();
+        }
+        else if (ARROW_PREDICT_FALSE(!state->ClaimTask(task)))
+        {
+            // Emptied by the stop of its source, which accounted for it but
+            // for its I/O bytes
+            dropped = true;
+        }
+        else
+        {
+            const int64_t start = NowNanos();
+            stats.Record(stats.queue_wait, start - task->enqueue_nanos);
+            StopToken *stop_token = &task->stop_token;
+            if (!stop_token->IsStopRequested())
+            {
+                const void *type = task->callable.target_type();
+                const internal::ScratchArena::Mark mark = self->scratch_.GetMark();
+                state->Trace(internal::TraceEvent::kStart, task);
+                std::move(task->callable)();
+                state->Trace(internal::TraceEvent::kEnd, task);
+                self->scratch_.Reset(mark);
+                const int64_t run_nanos = NowNanos() - start;
+                WorkerStats::Add(stats.tasks_executed, 1);
+                WorkerStats::Add(stats.busy_nanos, run_nanos);
+                stats.Record(stats.run_time, run_nanos);
+                self->costs_.Record(type, run_nanos);
+            }
+            else
+            {
+                WorkerStats::Add(stats.tasks_cancelled, 1);
+                state->Trace(internal::TraceEvent::kCancel, task);
+                if (task->stop_callback)
+                {
+                    std::move(task->stop_callback)(stop_token->Poll());
+                }
+            }
+        }
+        const int64_t io_size = task->io_size;
+        ReleaseTask(task);
+        if (io_size > 0)
+        {
+            state->ReleaseIOBytes(io_size);
+        }
+        if (!dropped)
+        {
+            state->FinishTasks(1);
+        }
+    }
+
+    void ThreadPool::State::FinishTasks(int n)
+    {
+        const int queued_or_running = (tasks_queued_or_running_ -= n);
+        if (ARROW_PREDICT_FALSE(num_blocked_submitters_.load() > 0))
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (n == 1)
+            {
+                cv_space_.notify_one();
+            }
+            else
+            {
+                cv_space_.notify_all();
+            }
+        }
+        if (ARROW_PREDICT_FALSE(queued_or_running == 0))
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            cv_idle_.notify_all();
+        }
+    }
+
+    // Run a task spawned by the running task of `self` right away. Its run
+    // time is part of the spawner's, so it only counts as inlined.
+    static void RunTaskInline(ThreadPool::State::Worker *self, internal::FnOnce<void()> task,
+                              const StopToken &stop_token, Executor::StopCallback &&stop_callback)
+    {
+        WorkerStats &stats = self->stats_;
+        if (stop_token.IsStopRequested())
+        {
+            WorkerStats::Add(stats.tasks_cancelled, 1);
+            self->state_->Trace(internal::TraceEvent::kCancel, nullptr);
+            if (stop_callback)
+            {
+                std::move(stop_callback)(stop_token.Poll());
+            }
+            return;
+        }
+        struct Guard
+        {
+            ThreadPool::State::Worker *self;
+            internal::ScratchArena::Mark mark;
+            ~Guard()
+            {
+                --self->inline_depth_;
+                self->scratch_.Reset(mark);
+            }
+        } guard{self, self->scratch_.GetMark()};
+        ++self->inline_depth_;
+        const void *type = task.target_type();
+        const int64_t start = NowNanos();
+        self->state_->Trace(internal::TraceEvent::kStart, nullptr);
+        std::move(task)();
+        self->state_->Trace(internal::TraceEvent::kEnd, nullptr);
+        const int64_t run_nanos = NowNanos() - start;
+        WorkerStats::Add(stats.tasks_inlined, 1);
+        stats.Record(stats.run_time, run_nanos);
+        self->costs_.Record(type, run_nanos);
+    }
+
+    ThreadPool::State::StrandShard &ThreadPool::State::StrandShardFor(int64_t key)
+    {
+        const uint64_t hash = static_cast<uint64_t>(key) * 0x9E3779B97F4A7C15ULL;
+        return strand_shards_[hash >> 58];
+    }
+
+    Task *ThreadPool::State::EnqueueOnStrand(int64_t key, Task *task)
+    {
+        StrandShard &shard = StrandShardFor(key);
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex_);
+            auto inserted = shard.strands_.emplace(key, std::deque<Task *>());
+            inserted.first->second.push_back(task);
+            if (!inserted.second)
+            {
+                return nullptr;
+            }
+        }
+        ++tasks_queued_or_running_;
+        auto *drain = new (LocalTaskCache()) Task{[this, key]
+                               { DrainStrand(key); },
+                               StopToken::Unstoppable(), StopCallback{}, task->band,
+                               /*io_size=*/0, /*numa_node=*/-1, task->enqueue_nanos};
+        drain->dispatcher = true;
+        return drain;
+    }
+
+    void ThreadPool::State::DrainStrand(int64_t key)
+    {
+        Worker *self = current_worker_;
+        StrandShard &shard = StrandShardFor(key);
+        Task *task;
+        for (int n = 0;; ++n)
+        {
+            {
+                std::lock_guard<std::mutex> lock(shard.mutex_);
+                auto it = shard.strands_.find(key);
+                std::deque<Task *> &pending = it->second;
+                if (pending.empty())
+                {
+                    shard.strands_.erase(it);
+                    return;
+                }
+                task = pending.front();
+                if (n == kStrandBatch && !please_shutdown_.load(std::memory_order_relaxed))
+                {
+                    // Let other work through, continuing behind it
+                    break;
+                }
+                pending.pop_front();
+            }
+            RunTask(this, self, task);
+        }
+        ++tasks_queued_or_running_;
+        auto *drain = new (LocalTaskCache()) Task{[this, key]
+                               { DrainStrand(key); },
+                               StopToken::Unstoppable(), StopCallback{}, task->band,
+                               /*io_size=*/0, /*numa_node=*/-1, NowNanos()};
+        drain->dispatcher = true;
+        PushTask(drain, /*global=*/true);
+        WakeIdleWorkers(1);
+    }
+
+    Task *ThreadPool::State::EnqueueForTenant(int64_t tenant_id, Task *task)
+    {
+        std::lock_guard<std::mutex> lock(tenant_mutex_);
+        tenants_.Push(tenant_id, task);
+        return MaybeAddTenantDispatcherUnlocked(task->band);
+    }
+
+    Task *ThreadPool::State::MaybeAddTenantDispatcherUnlocked(int band)
+    {
+        if (!tenants_.has_runnable() || tenant_dispatchers_ >= std::max(1, desired_capacity_.load()))
+        {
+            return nullptr;
+        }
+        ++tenant_dispatchers_;
+        ++tasks_queued_or_running_;
+        auto *dispatcher = new (LocalTaskCache()) Task{[this]
+                                    { DispatchTenantTasks(); },
+                                    StopToken::Unstoppable(), StopCallback{}, band,
+                                    /*io_size=*/0, /*numa_node=*/-1, NowNanos()};
+        dispatcher->dispatcher = true;
+        return dispatcher;
+    }
+
+    void ThreadPool::State::DispatchTenantTasks()
+    {
+        Worker *self = current_worker_;
+        int band = kDefaultPriorityBand;
+        for (int n = 0;; ++n)
+        {
+            Tenant *tenant;
+            Task *task;
+            {
+                std::lock_guard<std::mutex> lock(tenant_mutex_);
+                tenant = tenants_.Next();
+                if (tenant == nullptr)
+                {
+                    --tenant_dispatchers_;
+                    return;
+                }
+                if (n == kTenantBatch && !please_shutdown_.load(std::memory_order_relaxed))
+                {
+                    // Let other work through, continuing behind it
+                    break;
+                }
+                task = tenants_.Take(tenant);
+            }
+            band = task->band;
+            const int64_t start = NowNanos();
+            const int64_t queue_wait = start - task->enqueue_nanos;
+            const bool cancelled = task->stop_token.IsStopRequested();
+            RunTask(this, self, task);
+            const int64_t run_nanos = NowNanos() - start;
+            {
+                std::lock_guard<std::mutex> lock(tenant_mutex_);
+                tenants_.Finish(tenant, queue_wait, run_nanos, cancelled);
+            }
+        }
+        ++tasks_queued_or_running_;
+        auto *dispatcher = new (LocalTaskCache()) Task{[this]
+                                    { DispatchTenantTasks(); },
+                                    StopToken::Unstoppable(), StopCallback{}, band,
+                                    /*io_size=*/0, /*numa_node=*/-1, NowNanos()};
+        dispatcher->dispatcher = true;
+        PushTask(dispatcher, /*global=*/true);
+        WakeIdleWorkers(1);
+    }
+
+    void ThreadPool::State::PushTask(Task *task, bool global)
+    {
+        Worker *worker = current_worker_;
+        if (!global && worker != nullptr && worker->state_ == this)
+        {
+            worker->local_tasks_[task->band].Push(task);
+            return;
+        }
+        if (!pending_tasks_.TryPushLockFree(task))
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            PushPendingTaskUnlocked(task);
+        }
+    }
+
+    StopShard &ThreadPool::State::StopShardFor(const void *source)
+    {
+        const uint64_t hash = reinterpret_cast<uintptr_t>(source) * 0x9E3779B97F4A7C15ULL;
+        return stop_shards_[hash >> 60];
+    }
+
+    StopGroup *ThreadPool::State::AcquireStopGroup(const StopToken &token)
+    {
+        const void *source = token.source();
+        StopGroupCache &cache = stop_group_cache_;
+        if (cache.pool_id == id_ && cache.source == source)
+        {
+            // Counted first, so that the group cannot retire unless it was
+            // retiring already, or did
+            StopGroup *group = cache.group;
+            group->queued.fetch_add(1);
+            if (!group->retiring.load() && group->source.load() == source && !group->stopped.load())
+            {
+                return group;
+            }
+            ReleaseStopGroup(group, 1, /*can_reap=*/false);
+        }
+        StopShard &shard = StopShardFor(source);
+        StopGroup *group;
+        {
+            std::unique_lock<std::mutex> lock(shard.mutex_);
+            auto it = shard.groups_.find(source);
+            if (it != shard.groups_.end())
+            {
+                group = it->second;
+                group->queued.fetch_add(1);
+            }
+            else
+            {
+                if (shard.free_.empty())
+                {
+                    shard.storage_.emplace_back();
+                    shard.storage_.back().shard = &shard;
+                    shard.free_.push_back(&shard.storage_.back());
+                }
+                group = shard.free_.back();
+                shard.free_.pop_back();
+                // Registered unlocked: the callback runs right away if the
+                // source triggered meanwhile, and then ignores the group as it
+                // is not published yet
+                lock.unlock();
+                StopRegistration registration = token.RegisterCallback(
+                    [weak_self = weak_self_, source, group](const Status &status)
+                    {
+                        if (std::shared_ptr<void> self = weak_self.lock())
+                        {
+                            static_cast<State *>(self.get())->DropStopGroup(source, group, status);
+                        }
+                    });
+                lock.lock();
+                it = shard.groups_.find(source);
+                if (it != shard.groups_.end())
+                {
+                    // Another thread published one first
+                    shard.dead_registrations_.push_back(std::move(registration));
+                    shard.free_.push_back(group);
+                    group = it->second;
+                }
+                else
+                {
+                    group->stopped = false;
+                    group->registration = std::move(registration);
+                    group->source = source;
+                    shard.groups_.emplace(source, group);
+                }
+                group->queued.fetch_add(1);
+            }
+        }
+        // If the source triggered before the group was published, its
+        // callback ignored it; if after, the callback drops what we link
+        if (token.IsStopRequested())
+        {
+            ReleaseStopGroup(group, 1, /*can_reap=*/false);
+            return nullptr;
+        }
+        cache = StopGroupCache{id_, source, group};
+        return group;
+    }
+
+    void ThreadPool::State::ReleaseStopGroup(StopGroup *group, int64_t n, bool can_reap)
+    {
+        if (group->queued.fetch_sub(n) == n)
+        {
+            RetireStopGroup(group, can_reap);
+        }
+    }
+
+    void ThreadPool::State::RetireStopGroup(StopGroup *group, bool can_reap)
+    {
+        StopShard &shard = *group->shard;
+        Task *tasks;
+        std::vector<StopRegistration> dead;
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex_);
+            const void *source = group->source.load();
+            if (source == nullptr || group->queued.load() != 0)
+            {
+                // Retired already, or busy again
+                return;
+            }
+            // Spawners that counted themselves before this see the count, the
+            // others see the flag or the cleared source, see AcquireStopGroup()
+            group->retiring = true;
+            if (group->queued.load() != 0)
+            {
+                group->retiring = false;
+                return;
+            }
+            auto it = shard.groups_.find(source);
+            if (it != shard.groups_.end() && it->second == group)
+            {
+                shard.groups_.erase(it);
+            }
+            {
+                std::lock_guard<std::mutex> group_lock(group->mutex_);
+                DCHECK_EQ(group->timers, nullptr);
+                tasks = group->tasks.exchange(nullptr);
+                group->linked = 0;
+            }
+            group->source = nullptr;
+            shard.dead_registrations_.push_back(std::move(group->registration));
+            shard.free_.push_back(group);
+            group->retiring = false;
+            if (can_reap)
+            {
+                dead.swap(shard.dead_registrations_);
+            }
+        }
+        // All claimed, as none is queued
+        while (tasks != nullptr)
+        {
+            Task *next = tasks->stop_next;
+            ReleaseTaskFromGroup(tasks);
+            tasks = next;
+        }
+    }
+
+    void ThreadPool::State::SweepStopGroup(StopGroup *group)
+    {
+        std::unique_lock<std::mutex> lock(group->mutex_, std::try_to_lock);
+        if (!lock.owns_lock())
+        {
+            return;
+        }
+        Task *task = group->tasks.exchange(nullptr);
+        Task *kept = nullptr;
+        Task *kept_last = nullptr;
+        int64_t swept = 0;
+        while (task != nullptr)
+        {
+            Task *next = task->stop_next;
+            if (task->stop_state.load() & kTaskClaimed)
+            {
+                ReleaseTaskFromGroup(task);
+                ++swept;
+            }
+            else
+            {
+                task->stop_next = kept;
+                kept = task;
+                if (kept_last == nullptr)
+                {
+                    kept_last = task;
+                }
+            }
+            task = next;
+        }
+        if (kept != nullptr)
+        {
+            Task *head = group->tasks.load();
+            do
+            {
+                kept_last->stop_next = head;
+            } while (!group->tasks.compare_exchange_weak(head, kept));
+        }
+        group->linked.fetch_sub(swept);
+    }
+
+    void ThreadPool::State::IndexTask(Task *task)
+    {
+        const StopToken &token = task->stop_token;
+        if (token.source() == nullptr || token.IsStopRequested())
+        {
+            return;
+        }
+        StopGroup *group = AcquireStopGroup(token);
+        if (group == nullptr)
+        {
+            return;
+        }
+        task->stop_group = group;
+        Task *head = group->tasks.load(std::memory_order_relaxed);
+        do
+        {
+            task->stop_next = head;
+        } while (!group->tasks.compare_exchange_weak(head, task, std::memory_order_release,
+                                                     std::memory_order_relaxed));
+        // Keep the claimed tasks to a fraction of the linked ones
+        if (group->linked.fetch_add(1) >= 2 * group->queued.load(std::memory_order_relaxed) + kMinStopSweep)
+        {
+            SweepStopGroup(group);
+        }
+    }
+
+    void ThreadPool::State::IndexTimer(Timer *timer)
+    {
+        const StopToken &token = timer->stop_token;
+        if (token.source() == nullptr || token.IsStopRequested())
+        {
+            return;
+        }
+        StopGroup *group = AcquireStopGroup(token);
+        if (group == nullptr)
+        {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(group->mutex_);
+            if (!group->stopped.load())
+            {
+                LinkStopTimer(&group->timers, timer);
+                timer->stop_group = group;
+                return;
+            }
+        }
+        ReleaseStopGroup(group, 1, /*can_reap=*/false);
+    }
+
+    bool ThreadPool::State::UnindexTimer(Timer *timer, bool can_reap)
+    {
+        StopGroup *group = timer->stop_group;
+        if (group == nullptr)
+        {
+            return true;
+        }
+        timer->stop_group = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(group->mutex_);
+            if (!timer->stop_linked)
+            {
+                return false;
+            }
+            UnlinkStopTimer(&group->timers, timer);
+        }
+        ReleaseStopGroup(group, 1, can_reap);
+        return true;
+    }
+
+    void ThreadPool::State::DropStopGroup(const void *source, StopGroup *group, const Status &status)
+    {
+        StopShard &shard = *group->shard;
+        Task *tasks;
+        std::vector<std::unique_ptr<Timer>> timers;
+        int64_t unlinked_timers = 0;
+        {
+            std::unique_lock<std::mutex> timer_lock(timer_mutex_, std::defer_lock);
+            std::unique_lock<std::mutex> lock(shard.mutex_);
+            // Retired, recycled or not published yet, or stopped already
+            const auto stale = [&]
+            { return group->source.load() != source || group->stopped.load(); };
+            if (stale())
+            {
+                return;
+            }
+            bool has_timers;
+            {
+                std::lock_guard<std::mutex> group_lock(group->mutex_);
+                has_timers = group->timers != nullptr;
+            }
+            if (has_timers)
+            {
+                // The wheel is locked first
+                lock.unlock();
+                timer_lock.lock();
+                lock.lock();
+                if (stale())
+                {
+                    return;
+                }
+            }
+            group->stopped = true;
+            auto it = shard.groups_.find(source);
+            if (it != shard.groups_.end() && it->second == group)
+            {
+                shard.groups_.erase(it);
+            }
+            std::lock_guard<std::mutex> group_lock(group->mutex_);
+            tasks = group->tasks.exchange(nullptr);
+            while (Timer *timer = group->timers)
+            {
+                UnlinkStopTimer(&group->timers, timer);
+                ++unlinked_timers;
+                // Unless RunTimers() took it out already, then it frees it
+                if (timer->slot >= 0)
+                {
+                    timers_.Remove(timer);
+                    timers.emplace_back(timer);
+                }
+            }
+            if (!timers.empty())
+            {
+                const int64_t next = timers_.NextEventTick();
+                next_timer_nanos_ = next == kNoTimer ? kNoTimer : next * kTimerTickNanos;
+            }
+        }
+        // The tasks stay in their queues, empty, until dequeued
+        auto run = std::make_shared<StopCallbackRun>(status);
+        int64_t unlinked_tasks = 0;
+        while (tasks != nullptr)
+        {
+            Task *next = tasks->stop_next;
+            if (!(tasks->stop_state.fetch_or(kTaskClaimed) & kTaskClaimed))
+            {
+                Trace(internal::TraceEvent::kCancel, tasks);
+                run->tasks.push_back(StopCallbackRun::Dropped{std::move(tasks->callable),
+                                                             std::move(tasks->stop_callback)});
+            }
+            ReleaseTaskFromGroup(tasks);
+            ++unlinked_tasks;
+            tasks = next;
+        }
+        group->linked.fetch_sub(unlinked_tasks);
+        timers.clear();
+        const int n = static_cast<int>(run->tasks.size());
+        if (n == 0)
+        {
+            ReleaseStopGroup(group, unlinked_timers, /*can_reap=*/false);
+            return;
+        }
+
+        // Run the stop callbacks in chunks, on helpers queued ahead of the
+        // other work and on this thread
+        const int chunks = (n + kStopCallbackChunk - 1) / kStopCallbackChunk;
+        const int helpers = std::min(chunks, desired_capacity_.load()) - 1;
+        if (helpers > 0)
+        {
+            num_external_pushers_.fetch_add(1);
+            if (!please_shutdown_.load())
+            {
+                tasks_queued_or_running_ += helpers;
+                for (int i = 0; i < helpers; ++i)
+                {
+                    auto *helper = new (LocalTaskCache()) Task{[run]
+                                           {
+                                               if (run->Enter())
+                                               {
+                                                   run->Run();
+                                                   run->Leave();
+                                               }
+                                           },
+                                           StopToken::Unstoppable(), StopCallback{}, /*band=*/0,
+                                           /*io_size=*/0, /*numa_node=*/-1, NowNanos()};
+                    helper->dispatcher = true;
+                    PushTask(helper, /*global=*/true);
+                }
+                WakeIdleWorkers(helpers);
+            }
+            num_external_pushers_.fetch_sub(1);
+        }
+        run->Run();
+        run->CloseAndWait();
+
+        Worker *self = current_worker_;
+        if (self != nullptr && self->state_ == this)
+        {
+            WorkerStats::Add(self->stats_.tasks_cancelled, n);
+        }
+        else
+        {
+            tasks_cancelled_.fetch_add(n);
+        }
+        FinishTasks(n);
+        // Only now, as reaping the registration of the group waits for this
+        // callback to return. Not reaping here either: another stop may be
+        // waiting for its helpers behind this thread.
+        ReleaseStopGroup(group, n + unlinked_timers, /*can_reap=*/false);
+    }
+
+    void ThreadPool::State::RecordTraceEvent(internal::TraceEvent::Type type, const Task *task,
+                                             const TaskHints *hints)
+    {
+        internal::TraceEvent event{internal::TraceTicks(), reinterpret_cast<uintptr_t>(task), -1, -1, 0,
+                         static_cast<int8_t>(task != nullptr ? task->band : -1), type};
+        if (hints != nullptr)
+        {
+            event.external_id = hints->external_id;
+            event.tenant_id = hints->tenant_id;
+            event.priority = hints->priority;
+        }
+        Worker *self = current_worker_;
+        if (self != nullptr && self->state_ == this)
+        {
+            internal::TraceBuffer *buffer = self->trace_.load(std::memory_order_relaxed);
+            if (ARROW_PREDICT_FALSE(buffer == nullptr))
+            {
+                buffer = new internal::TraceBuffer(trace_capacity_.load(std::memory_order_acquire));
+                self->trace_.store(buffer, std::memory_order_release);
+            }
+            buffer->Record(event);
+        }
+        else if (internal::TraceBuffer *buffer = external_trace_.load(std::memory_order_acquire))
+        {
+            buffer->RecordShared(event);
+        }
+    }
+
+    static void WorkerLoop(ThreadPool *pool, std::shared_ptr<ThreadPool::State> state,
+                           std::list<std::thread>::iterator it, ThreadPool::State::Worker *self)
+    {
+        current_worker_ = self;
+        std::unique_lock<std::mutex> lock(state->mutex_);
+
+        DCHECK_EQ(std::this_thread::get_id(), it->get_id());
+        lock.unlock();
+
+        // If too many threads, we should secede[脱离] from the pool
+        const auto should_secede = [&]() -> bool
+        {
+            return state->num_workers_.load() > state->desired_capacity_.load();
+        };
+
+        const auto has_external_tasks = [&]() -> bool
+        {
+            for (const auto &size : state->pending_tasks_.size_)
+            {
+                if (size.load() > 0)
+                {
+                    return true;
+                }
+            }
+            return false;
+        };
+
+        // Start of the current idle period, -1 while busy
+        int64_t idle_since = -1;
+        // The lock is only taken to park and to exit; an unparked worker goes
+        // straight back to looking for tasks.
+        while (true)
+        {
+            if (self->affinity_epoch_ != state->affinity_epoch_.load(std::memory_order_relaxed))
+            {
+                std::lock_guard<std::mutex> guard(state->mutex_);
+                state->ApplyAffinityUnlocked(self);
+            }
+            // Run tasks without holding the lock for as long as we find some
+            while (!state->quick_shutdown_.load(std::memory_order_relaxed) && !should_secede())
+            {
+                const int64_t next_timer = state->next_timer_nanos_.load(std::memory_order_relaxed);
+                if (ARROW_PREDICT_FALSE(next_timer != kNoTimer) && NowNanos() >= next_timer)
+                {
+                    state->RunTimers(pool);
+                }
+                Task *task = state->NextTask(self);
+                if (task == nullptr)
+                {
+                    if (idle_since < 0)
+                    {
+                        idle_since = NowNanos();
+                    }
+                    task = state->SpinForTask(self);
+                    if (task == nullptr)
+                    {
+                        break;
+                    }
+                }
+                if (idle_since >= 0)
+                {
+                    WorkerStats::Add(self->stats_.idle_nanos, NowNanos() - idle_since);
+                    idle_since = -1;
+                }
+                DCHECK_GE(state->tasks_queued_or_running_.load(), 0);
+                if (state->autoscaling_.load(std::memory_order_relaxed))
+                {
+                    state->GrowOnQueueWait(pool, NowNanos() - task->enqueue_nanos);
+                }
+                RunTask(state.get(), self, task);
+            }
+            lock.lock();
+            if (state->please_shutdown_ && !state->quick_shutdown_ &&
+                (state->num_external_pushers_.load() > 0 || has_external_tasks()))
+            {
+                // Don't leave behind a task that an external thread is still pushing
+                lock.unlock();
+                std::this_thread::yield();
+                continue;
+            }
+            if (state->please_shutdown_ || should_secede())
+            {
+                break;
+            }
+            // Announce that we are going to sleep, then look again for work that
+            // may have been pushed without the lock (see WakeIdleWorkers()).
+            self->parker_.Prepare();
+            state->idle_workers_.push_back(self);
+            state->num_sleeping_.fetch_add(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (state->HasQueuedTasks() ||
+                self->affinity_epoch_ != state->affinity_epoch_.load(std::memory_order_relaxed))
+            {
+                auto idle = std::find(state->idle_workers_.begin(), state->idle_workers_.end(), self);
+                state->idle_workers_.erase(idle);
+                state->num_sleeping_.fetch_sub(1);
+                lock.unlock();
+                continue;
+            }
+            int64_t park_timeout = state->IdleTimeoutNanos();
+            const int64_t next_timer = state->next_timer_nanos_.load();
+            if (next_timer != kNoTimer && state->timer_waiter_ == nullptr)
+            {
+                // Sleep until the next timer is due, on behalf of the pool
+                state->timer_waiter_ = self;
+                park_timeout = std::max<int64_t>(0, next_timer - NowNanos());
+            }
+            lock.unlock();
+            // Hand back the nodes we hold for others before going to sleep
+            remote_frees_.Flush();
+            WorkerStats::Add(self->stats_.parks, 1);
+            state->Trace(internal::TraceEvent::kPark, nullptr);
+            if (!self->parker_.Park(park_timeout))
+            {
+                lock.lock();
+                if (state->RetireIdleWorkerUnlocked(self))
+                {
+                    // Close the park in the trace, then secede through the
+                    // usual exit path
+                    state->Trace(internal::TraceEvent::kWake, nullptr);
+                    break;
+                }
+                lock.unlock();
+            }
+            WorkerStats::Add(self->stats_.wakeups, 1);
+            state->Trace(internal::TraceEvent::kWake, nullptr);
+        }
+        // Hand our remaining tasks over to the other workers, keeping their band
+        bool requeued = false;
+        for (int band = 0; band < ThreadPool::kNumPriorityBands; ++band)
+        {
+            while (Task *task = self->local_tasks_[band].Pop())
+            {
+                state->pending_tasks_.tasks_[band].push_front(task);
+                state->pending_tasks_.size_[band].fetch_add(1);
+                requeued = true;
+            }
+        }
+        if (requeued)
+        {
+            state->UnparkAllWorkersUnlocked();
+        }
+        self->in_use_ = false;
+        remote_frees_.Flush();
+        current_worker_ = nullptr;
+
+        DCHECK_GE(state->tasks_queued_or_running_.load(), 0);
+        DCHECK_EQ(std::this_thread::get_id(), it->get_id());
+        state->finished_workers_.push_back(std::move(*it));
+        state->workers_.erase(it);
+        state->num_workers_.fetch_sub(1);
+        if (state->please_shutdown_)
+        {
+            state->cv_shutdown_.notify_one();
+        }
+    }
+
+    void ThreadPool::WaitForIdle()
+    {
+        std::unique_lock<std::mutex> lk(state_->mutex_);
+        state_->cv_idle_.wait(lk, [this]
+                              { return state_->tasks_queued_or_running_ == 0; });
+    }
+
+    ThreadPool::ThreadPool()
+        : sp_state_(std::make_shared<ThreadPool::State>()),
+          state_(sp_state_.get()),
+          shutdown_on_destroy_(true)
+    {
+        state_->weak_self_ = sp_state_;
+        pid_ = getpid();
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        if (shutdown_on_destroy_)
+        {
+            ARROW_UNUSED(Shutdown(false /* wait */));
+        }
+    }
+
+    void ThreadPool::ProtectAgainstFork()
+    {
+        pid_t current_pid = getpid();
+        if (pid_ != current_pid)
+        {
+            int capacity = state_->desired_capacity_;
+
+            auto new_state = std::make_shared<ThreadPool::State>();
+            new_state->weak_self_ = new_state;
+            new_state->please_shutdown_ = state_->please_shutdown_.load();
+            new_state->quick_shutdown_ = state_->quick_shutdown_.load();
+
+            pid_ = current_pid;
+            sp_state_ = new_state;
+            state_ = sp_state_.get();
+            if (!state_->please_shutdown_)
+            {
+                ARROW_UNUSED(SetCapacity(capacity));
+            }
+        }
+    }
+
+    Status ThreadPool::SetCapacity(int threads)
+    {
+        ProtectAgainstFork();
+        std::unique_lock<std::mutex> lock(state_->mutex_);
+        if (state_->please_shutdown_)
+        {
+            return Status::Invalid("operation forbidden during or after shutdown");
+        }
+        if (threads <= 0)
+        {
+            return Status::Invalid("ThreadPool capacity must be > 0");
+        }
+        CollectFinishedWorkersUnlocked();
+
+        // Keep the compensation for currently blocked workers on top
+        state_->desired_capacity_ = threads + state_->num_compensating_;
+        const int required = std::min(static_cast<int>(state_->NumQueuedTasks()),
+                                      threads - static_cast<int>(state_->workers_.size()));
+        if (required > 0)
+        {
+            LaunchWorkersUnlocked(required);
+        }
+        else if (required < 0)
+        {
+            // Let extra workers secede
+            state_->UnparkAllWorkersUnlocked();
+        }
+        // The queue bound grows with the capacity
+        state_->cv_space_.notify_all();
+        return Status::OK();
+    }
+
+    int ThreadPool::GetCapacity()
+    {
+        ProtectAgainstFork();
+        return state_->desired_capacity_.load() - state_->num_compensating_.load();
+    }
+
+    bool ThreadPool::RunPendingTask()
+    {
+        State::Worker *worker = current_worker_;
+        if (worker == nullptr || worker->state_ != state_)
+        {
+            return false;
+        }
+        Task *task = state_->NextTask(worker);
+        if (task == nullptr)
+        {
+            return false;
+        }
+        RunTask(state_, worker, task);
+        return true;
+    }
+
+    int ThreadPool::GetNumTasks()
+    {
+        ProtectAgainstFork();
+        return state_->tasks_queued_or_running_.load();
+    }
+
+    ThreadPoolMetrics ThreadPool::GetMetrics()
+    {
+        ProtectAgainstFork();
+        ThreadPoolMetrics metrics;
+        std::vector<State::Worker *> workers;
+        for (State::Worker *w = state_->worker_slots_.load(std::memory_order_acquire); w != nullptr;
+             w = w->next_)
+        {
+            workers.push_back(w);
+        }
+        std::sort(workers.begin(), workers.end(), [](State::Worker *a, State::Worker *b)
+                  { return a->index_ < b->index_; });
+        for (State::Worker *w : workers)
+        {
+            const WorkerStats &stats = w->stats_;
+            WorkerCounters counters;
+            counters.tasks_executed = stats.tasks_executed.load(std::memory_order_relaxed);
+            counters.tasks_cancelled = stats.tasks_cancelled.load(std::memory_order_relaxed);
+            counters.tasks_stolen = stats.tasks_stolen.load(std::memory_order_relaxed);
+            counters.tasks_inlined = stats.tasks_inlined.load(std::memory_order_relaxed);
+            counters.parks = stats.parks.load(std::memory_order_relaxed);
+            counters.wakeups = stats.wakeups.load(std::memory_order_relaxed);
+            counters.busy_nanos = stats.busy_nanos.load(std::memory_order_relaxed);
+            counters.idle_nanos = stats.idle_nanos.load(std::memory_order_relaxed);
+            metrics.total += counters;
+            metrics.per_worker.push_back(counters);
+            for (int i = 0; i < LatencyHistogram::kNumBuckets; ++i)
+            {
+                metrics.queue_wait.buckets[i] += stats.queue_wait[i].load(std::memory_order_relaxed);
+                metrics.run_time.buckets[i] += stats.run_time[i].load(std::memory_order_relaxed);
+            }
+        }
+        metrics.total.tasks_cancelled += state_->tasks_cancelled_.load();
+        metrics.num_queued_tasks = state_->NumQueuedTasks();
+        metrics.num_workers = state_->num_workers_.load();
+        metrics.num_parked_workers = state_->num_sleeping_.load();
+        metrics.num_blocked_workers = state_->num_blocked_.load();
+        metrics.spawn_cost_nanos = state_->spawn_cost_nanos_.load();
+        {
+            std::lock_guard<std::mutex> lock(state_->tenant_mutex_);
+            for (const auto &entry : state_->tenants_.tenants())
+            {
+                const State::Tenant &tenant = entry.second;
+                TenantMetrics tenant_metrics;
+                tenant_metrics.tenant_id = tenant.id_;
+                tenant_metrics.tasks_executed = tenant.tasks_executed_;
+                tenant_metrics.busy_nanos = tenant.busy_nanos_;
+                tenant_metrics.queue_wait = tenant.queue_wait_;
+                tenant_metrics.num_queued_tasks = static_cast<int64_t>(tenant.pending_.size());
+                tenant_metrics.num_running_tasks = tenant.running_;
+                metrics.tenants.push_back(tenant_metrics);
+            }
+        }
+        std::sort(metrics.tenants.begin(), metrics.tenants.end(),
+                  [](const TenantMetrics &a, const TenantMetrics &b)
+                  { return a.tenant_id < b.tenant_id; });
+        return metrics;
+    }
+
+    Status ThreadPool::EnableTracing(size_t events_per_thread)
+    {
+        if (events_per_thread == 0)
+        {
+            return Status::Invalid("tracing needs room for at least one event");
+        }
+        ProtectAgainstFork();
+        std::lock_guard<std::mutex> lock(state_->mutex_);
+        if (state_->trace_capacity_.load() == 0)
+        {
+            size_t capacity = 1;
+            while (capacity < events_per_thread)
+            {
+                capacity <<= 1;
+            }
+            state_->trace_base_ticks_ = internal::TraceTicks();
+            state_->trace_base_nanos_ = NowNanos();
+            state_->trace_capacity_.store(capacity, std::memory_order_release);
+            state_->external_trace_.store(new internal::TraceBuffer(capacity), std::memory_order_release);
+        }
+        state_->tracing_.store(true);
+        return Status::OK();
+    }
+
+    void ThreadPool::DisableTracing() { state_->tracing_.store(false); }
+
+    std::string ThreadPool::ExportTrace()
+    {
+        ProtectAgainstFork();
+        std::lock_guard<std::mutex> lock(state_->mutex_);
+        if (state_->trace_capacity_.load() == 0)
+        {
+            return "{\"traceEvents\":[]}";
+        }
+        // Rings by thread id, 0 standing for the outside threads
+        std::vector<std::pair<int, const internal::TraceBuffer *>> buffers = {
+            {0, state_->external_trace_.load()}};
+        for (State::Worker *w = state_->worker_slots_.load(std::memory_order_acquire); w != nullptr;
+             w = w->next_)
+        {
+            if (internal::TraceBuffer *buffer = w->trace_.load(std::memory_order_acquire))
+            {
+                buffers.emplace_back(w->index_ + 1, buffer);
+            }
+        }
+        // Ticks per microsecond since tracing was first enabled
+        const int64_t elapsed_nanos = NowNanos() - state_->trace_base_nanos_;
+        const int64_t elapsed_ticks =
+            static_cast<int64_t>(internal::TraceTicks() - state_->trace_base_ticks_);
+        const double ticks_per_us = elapsed_nanos > 0 && elapsed_ticks > 0
+                                        ? 1000.0 * static_cast<double>(elapsed_ticks) / elapsed_nanos
+                                        : 1000.0;
+        return internal::ExportChromeTrace(buffers, state_->trace_base_ticks_, ticks_per_us);
+    }
+
+    void ThreadPool::SetIOExecutor(Executor *executor)
+    {
+        io_executor_.store(executor == this ? nullptr : executor);
+    }
+
+    Status ThreadPool::SetMaxInFlightBytes(int64_t max_bytes)
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex_);
+        if (state_->please_shutdown_)
+        {
+            return Status::Invalid("operation forbidden during or after shutdown");
+        }
+        state_->max_inflight_bytes_ = std::max<int64_t>(0, max_bytes);
+        if (max_bytes <= 0)
+        {
+            // Unlimited: admit everything still waiting
+            for (Task *task : state_->throttled_tasks_)
+            {
+                state_->inflight_bytes_ += task->io_size;
+                state_->PushPendingTaskUnlocked(task);
+            }
+            state_->throttled_tasks_.clear();
+            state_->UnparkAllWorkersUnlocked();
+        }
+        return Status::OK();
+    }
+
+    int64_t ThreadPool::GetMaxInFlightBytes() { return state_->max_inflight_bytes_.load(); }
+
+    Status ThreadPool::SetAffinity(ThreadAffinity affinity, std::vector<int> cpus)
+    {
+        const std::vector<int> &allowed = state_->allowed_cpus_;
+        std::vector<int> worker_cpus;
+        switch (affinity)
+        {
+        case ThreadAffinity::kNone:
+            break;
+        case ThreadAffinity::kCompact:
+            worker_cpus = allowed;
+            std::stable_sort(worker_cpus.begin(), worker_cpus.end(), [](int a, int b)
+                             { return internal::GetCpuNumaNode(a) < internal::GetCpuNumaNode(b); });
+            break;
+        case ThreadAffinity::kScatter:
+        {
+            // Round-robin over the nodes, taking each node's CPUs in order
+            std::vector<std::vector<int>> by_node(internal::GetNumaNodeCount());
+            for (int cpu : allowed)
+            {
+                by_node[internal::GetCpuNumaNode(cpu)].push_back(cpu);
+            }
+            for (size_t i = 0; worker_cpus.size() < allowed.size(); ++i)
+            {
+                for (const auto &node_cpus : by_node)
+                {
+                    if (i < node_cpus.size())
+                    {
+                        worker_cpus.push_back(node_cpus[i]);
+                    }
+                }
+            }
+            break;
+        }
+        case ThreadAffinity::kExplicit:
+            if (cpus.empty())
+            {
+                return Status::Invalid("explicit affinity requires a non-empty CPU list");
+            }
+            for (int cpu : cpus)
+            {
+                if (!std::binary_search(allowed.begin(), allowed.end(), cpu))
+                {
+                    return Status::Invalid("CPU " + std::to_string(cpu) +
+                                           " is not in the process affinity mask");
+                }
+            }
+            worker_cpus = std::move(cpus);
+            break;
+        }
+        std::lock_guard<std::mutex> lock(state_->mutex_);
+        state_->worker_cpus_ = std::move(worker_cpus);
+        state_->affinity_epoch_.fetch_add(1);
+        // Workers re-pin themselves the next time they look for work
+        state_->UnparkAllWorkersUnlocked();
+        return Status::OK();
+    }
+
+    Status ThreadPool::SetMaxQueuedTasks(int64_t max_queued, BackpressurePolicy policy)
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex_);
+        if (state_->please_shutdown_)
+        {
+            return Status::Invalid("operation forbidden during or after shutdown");
+        }
+        state_->max_queued_tasks_ = std::max<int64_t>(0, max_queued);
+        state_->backpressure_policy_ = policy;
+        // The new limit or policy may let blocked submitters through
+        state_->cv_space_.notify_all();
+        return Status::OK();
+    }
+
+    int64_t ThreadPool::GetMaxQueuedTasks() { return state_->max_queued_tasks_.load(); }
+
+    Status ThreadPool::EnableAutoscaling(AutoscaleOptions options)
+    {
+        const int max_threads = options.max_threads > 0 ? options.max_threads : DefaultCapacity();
+        if (options.min_threads <= 0 || options.min_threads > max_threads)
+        {
+            return Status::Invalid("autoscaling requires 0 < min_threads <= max_threads");
+        }
+        if (options.idle_timeout_ms < 0 || options.grow_queue_wait_us < 0)
+        {
+            return Status::Invalid("autoscaling timeouts must be non-negative");
+        }
+        std::lock_guard<std::mutex> lock(state_->mutex_);
+        if (state_->please_shutdown_)
+        {
+            return Status::Invalid("operation forbidden during or after shutdown");
+        }
+        state_->min_threads_ = options.min_threads;
+        state_->max_threads_ = max_threads;
+        state_->idle_timeout_nanos_ = options.idle_timeout_ms * 1000000;
+        state_->grow_queue_wait_nanos_ = options.grow_queue_wait_us * 1000;
+        state_->autoscaling_ = true;
+        // Workers compensating for blocked ones come on top of the range
+        const int compensating = state_->num_compensating_.load();
+        state_->desired_capacity_ =
+            std::max(options.min_threads,
+                     std::min(state_->desired_capacity_.load() - compensating, max_threads)) +
+            compensating;
+        // Let extra workers secede, and parked ones pick up their idle timeout
+        state_->UnparkAllWorkersUnlocked();
+        state_->cv_space_.notify_all();
+        return Status::OK();
+    }
+
+    void ThreadPool::DisableAutoscaling()
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex_);
+        state_->autoscaling_ = false;
+    }
+
+    void ThreadPool::EnterBlocking()
+    {
+        ThreadPool *pool = current_thread_pool_;
+        State::Worker *worker = current_worker_;
+        if (pool == nullptr || worker == nullptr || worker->blocking_depth_++ > 0)
+        {
+            return;
+        }
+        State *state = worker->state_;
+        std::lock_guard<std::mutex> lock(state->mutex_);
+        state->num_blocked_.fetch_add(1);
+        if (state->please_shutdown_ || state->num_compensating_ >= state->max_compensation_)
+        {
+            return;
+        }
+        worker->compensated_ = true;
+        state->num_compensating_.fetch_add(1);
+        const int capacity = ++state->desired_capacity_;
+        // Otherwise the worker is launched by the next spawn
+        if (static_cast<int>(state->workers_.size()) < capacity && state->HasQueuedTasks() &&
+            pool->state_ == state)
+        {
+            pool->CollectFinishedWorkersUnlocked();
+            pool->LaunchWorkersUnlocked(/*threads=*/1);
+        }
+    }
+
+    void ThreadPool::ExitBlocking()
+    {
+        State::Worker *worker = current_worker_;
+        if (current_thread_pool_ == nullptr || worker == nullptr || worker->blocking_depth_ == 0 ||
+            --worker->blocking_depth_ > 0)
+        {
+            return;
+        }
+        State *state = worker->state_;
+        std::lock_guard<std::mutex> lock(state->mutex_);
+        state->num_blocked_.fetch_sub(1);
+        if (!worker->compensated_)
+        {
+            return;
+        }
+        worker->compensated_ = false;
+        state->num_compensating_.fetch_sub(1);
+        state->desired_capacity_ = std::max(1, state->desired_capacity_ - 1);
+        // A parked worker notices it is in excess right away, busy ones
+        // after their current task
+        if (state->num_workers_ > state->desired_capacity_)
+        {
+            state->UnparkWorkersUnlocked(1);
+        }
+    }
+
+    Status ThreadPool::SetMaxCompensationThreads(int threads)
+    {
+        if (threads < 0)
+        {
+            return Status::Invalid("compensation thread cap must be non-negative");
+        }
+        std::lock_guard<std::mutex> lock(state_->mutex_);
+        state_->max_compensation_ = threads;
+        return Status::OK();
+    }
+
+    Status ThreadPool::SetInlineOptions(InlineOptions options)
+    {
+        if (options.saturated_queue_depth < 0 || options.max_depth < 0)
+        {
+            return Status::Invalid("inline queue depth and nesting must be non-negative");
+        }
+        state_->max_inline_cost_nanos_ = std::max<int64_t>(-1, options.max_cost_nanos);
+        state_->saturated_queue_depth_ = options.saturated_queue_depth;
+        state_->max_inline_depth_ = options.max_depth;
+        return Status::OK();
+    }
+
+    void *ThreadPool::AllocateScratch(size_t size, size_t alignment)
+    {
+        DCHECK_EQ(alignment & (alignment - 1), 0);
+        State::Worker *self = current_worker_;
+        if (self == nullptr)
+        {
+            return nullptr;
+        }
+        return self->scratch_.Allocate(size, alignment);
+    }
+
+    Status ThreadPool::SetTenantOptions(int64_t tenant_id, TenantOptions options)
+    {
+        if (tenant_id < 0)
+        {
+            return Status::Invalid("tenant id must be >= 0");
+        }
+        if (options.weight <= 0 || options.max_concurrency < 0)
+        {
+            return Status::Invalid("tenant weight must be > 0 and max_concurrency >= 0");
+        }
+        ProtectAgainstFork();
+        // A raised cap may need a dispatcher, see SpawnInternal()
+        state_->num_external_pushers_.fetch_add(1);
+        if (state_->please_shutdown_.load())
+        {
+            state_->num_external_pushers_.fetch_sub(1);
+            return Status::Invalid("operation forbidden during or after shutdown");
+        }
+        Task *dispatcher;
+        {
+            std::lock_guard<std::mutex> lock(state_->tenant_mutex_);
+            State::Tenant &tenant = state_->tenants_.Get(tenant_id);
+            tenant.options_ = options;
+            state_->tenants_.Schedule(&tenant);
+            dispatcher = state_->MaybeAddTenantDispatcherUnlocked(kDefaultPriorityBand);
+        }
+        if (dispatcher != nullptr)
+        {
+            state_->PushTask(dispatcher, /*global=*/false);
+        }
+        state_->num_external_pushers_.fetch_sub(1);
+        if (dispatcher != nullptr)
+        {
+            state_->WakeIdleWorkers(1);
+        }
+        return Status::OK();
+    }
+
+    InlineOptions ThreadPool::GetInlineOptions()
+    {
+        InlineOptions options;
+        options.max_cost_nanos = state_->max_inline_cost_nanos_.load();
+        options.saturated_queue_depth = state_->saturated_queue_depth_.load();
+        options.max_depth = state_->max_inline_depth_.load();
+        return options;
     }
 
-    void ThreadPool::WaitForIdle()
+    Status ThreadPool::SetParkingOptions(ParkingOptions options)
     {
-        std::unique_lock<std::mutex> lk(state_->mutex_);
-        state_->cv_idle_.wait(lk, [this]
-                              { return state_->tasks_queued_or_running_ == 0; });
+        if (options.spin_rounds < 0 || options.yield_rounds < 0)
+        {
+            return Status::Invalid("parking rounds must be non-negative");
+        }
+        state_->spin_rounds_ = options.spin_rounds;
+        state_->yield_rounds_ = options.yield_rounds;
+        return Status::OK();
     }
 
-    ThreadPool::ThreadPool()
-        : sp_state_(std::make_shared<ThreadPool::State>()),
-          state_(sp_state_.get()),
-          shutdown_on_destroy_(true)
+    ParkingOptions ThreadPool::GetParkingOptions()
     {
-        pid_ = getpid();
+        ParkingOptions options;
+        options.spin_rounds = state_->spin_rounds_.load();
+        options.yield_rounds = state_->yield_rounds_.load();
+        return options;
     }
 
-    ThreadPool::~ThreadPool()
+    int LatencyHistogram::BucketFor(int64_t nanos)
     {
-        if (shutdown_on_destroy_)
+        if (nanos <= 1)
         {
-            ARROW_UNUSED(Shutdown(false /* wait */));
+            return 0;
         }
+        const int bucket = 63 - __builtin_clzll(static_cast<uint64_t>(nanos));
+        return std::min(bucket, kNumBuckets - 1);
     }
 
-    void ThreadPool::ProtectAgainstFork()
+    int64_t LatencyHistogram::Count() const
     {
-        pid_t current_pid = getpid();
-        if (pid_ != current_pid)
+        int64_t count = 0;
+        for (int64_t n : buckets)
         {
-            int capacity = state_->desired_capacity_;
-
-            auto new_state = std::make_shared<ThreadPool::State>();
-            new_state->please_shutdown_ = state_->please_shutdown_;
-            new_state->quick_shutdown_ = state_->quick_shutdown_;
-
-            pid_ = current_pid;
-            sp_state_ = new_state;
-            state_ = sp_state_.get();
-            if (!state_->please_shutdown_)
-            {
-                ARROW_UNUSED(SetCapacity(capacity));
-            }
+            count += n;
         }
+        return count;
     }
 
-    Status ThreadPool::SetCapacity(int threads)
+    int64_t LatencyHistogram::Quantile(double q) const
     {
-        ProtectAgainstFork();
-        std::unique_lock<std::mutex> lock(state_->mutex_);
-        if (state_->please_shutdown_)
+        const int64_t count = Count();
+        if (count == 0)
         {
-            return Status::Invalid("operation forbidden during or after shutdown");
+            return 0;
         }
-        if (threads <= 0)
+        const int64_t rank = std::max<int64_t>(1, static_cast<int64_t>(q * count + 0.5));
+        int64_t seen = 0;
+        for (int i = 0; i < kNumBuckets; ++i)
         {
-            return Status::Invalid("ThreadPool capacity must be > 0");
+            seen += buckets[i];
+            if (seen >= rank)
+            {
+                return int64_t{2} << i;
+            }
         }
-        CollectFinishedWorkersUnlocked();
+        return int64_t{2} << (kNumBuckets - 1);
+    }
 
-        state_->desired_capacity_ = threads;
-        const int required = std::min(static_cast<int>(state_->pending_tasks_.size()),
-                                      threads - static_cast<int>(state_->workers_.size()));
-        if (required > 0)
-        {
-            LaunchWorkersUnlocked(required);
-        }
-        else if (required < 0)
-        {
-            state_->cv_.notify_all();
-        }
-        return Status::OK();
+    WorkerCounters &WorkerCounters::operator+=(const WorkerCounters &other)
+    {
+        tasks_executed += other.tasks_executed;
+        tasks_cancelled += other.tasks_cancelled;
+        tasks_stolen += other.tasks_stolen;
+        tasks_inlined += other.tasks_inlined;
+        parks += other.parks;
+        wakeups += other.wakeups;
+        busy_nanos += other.busy_nanos;
+        idle_nanos += other.idle_nanos;
+        return *this;
     }
 
-    int ThreadPool::GetCapacity()
+    int ThreadPool::PriorityBand(int32_t priority)
     {
-        ProtectAgainstFork();
-        std::unique_lock<std::mutex> lock(state_->mutex_);
-        return state_->desired_capacity_;
+        int64_t band = static_cast<int64_t>(kDefaultPriorityBand) - priority;
+        return static_cast<int>(std::max<int64_t>(0, std::min<int64_t>(band, kNumPriorityBands - 1)));
     }
 
-    int ThreadPool::GetNumTasks()
+    std::vector<int64_t> ThreadPool::GetNumQueuedTasksByPriority()
     {
         ProtectAgainstFork();
-        std::unique_lock<std::mutex> lock(state_->mutex_);
-        return state_->tasks_queued_or_running_;
+        std::vector<int64_t> depths(kNumPriorityBands);
+        for (int band = 0; band < kNumPriorityBands; ++band)
+        {
+            depths[band] = state_->NumQueuedTasks(band);
+        }
+        return depths;
     }
 
     int ThreadPool::GetActualCapacity()
@@ -217,18 +2953,53 @@ namespace arrow
         }
         state_->please_shutdown_ = true;
         state_->quick_shutdown_ = !wait;
-        state_->cv_.notify_all();
+        state_->UnparkAllWorkersUnlocked();
+        // Blocked submitters fail
+        state_->cv_space_.notify_all();
         state_->cv_shutdown_.wait(lock, [this]
                                   { return state_->workers_.empty(); });
+        // Dropped tasks are destroyed outside the lock, as destroying them may
+        // run code (e.g. finishing a Future) that calls back into the pool.
+        std::vector<Task *> dropped;
         if (!state_->quick_shutdown_)
         {
-            DCHECK_EQ(state_->pending_tasks_.size(), 0);
+            DCHECK_EQ(state_->NumQueuedTasks(), 0);
         }
         else
         {
-            state_->pending_tasks_.clear();
+            state_->DrainPendingTasksUnlocked(&dropped);
+            dropped.insert(dropped.end(), state_->throttled_tasks_.begin(),
+                           state_->throttled_tasks_.end());
+            state_->throttled_tasks_.clear();
         }
         CollectFinishedWorkersUnlocked();
+        lock.unlock();
+        if (state_->quick_shutdown_)
+        {
+            // So are the tasks behind the strand drains and tenant dispatchers
+            // just dropped
+            state_->DrainKeyedTasks(&dropped);
+        }
+        for (Task *task : dropped)
+        {
+            state_->ClaimTask(task);
+            ReleaseTask(task);
+        }
+        // Pending timers never fire
+        std::vector<internal::TimerWheel::Node *> timers;
+        {
+            std::lock_guard<std::mutex> timer_lock(state_->timer_mutex_);
+            state_->timers_.Clear(&timers);
+            state_->next_timer_nanos_ = kNoTimer;
+            for (auto *timer : timers)
+            {
+                state_->UnindexTimer(static_cast<Timer *>(timer), /*can_reap=*/false);
+            }
+        }
+        for (auto *timer : timers)
+        {
+            delete static_cast<Timer *>(timer);
+        }
         return Status::OK();
     }
 
@@ -241,8 +3012,6 @@ namespace arrow
         state_->finished_workers_.clear();
     }
 
-    thread_local ThreadPool *current_thread_pool_ = nullptr;
-
     bool ThreadPool::OwnsThisThread() { return current_thread_pool_ == this; }
 
     void ThreadPool::LaunchWorkersUnlocked(int threads)
@@ -252,35 +3021,451 @@ namespace arrow
         for (int i = 0; i < threads; i++)
         {
             state_->workers_.emplace_back();
+            state_->num_workers_.fetch_add(1);
             auto it = --(state_->workers_.end());
-            *it = std::thread([this, state, it]
+            State::Worker *worker = state_->AcquireWorkerUnlocked();
+            *it = std::thread([this, state, it, worker]
                               {
       current_thread_pool_ = this;
-      WorkerLoop(state, it); });
+      WorkerLoop(this, state, it, worker); });
+        }
+    }
+
+    void ThreadPool::LaunchWorkersIfNeeded(int queued_or_running)
+    {
+        const int num_workers = state_->num_workers_.load(std::memory_order_relaxed);
+        if (num_workers >= queued_or_running ||
+            num_workers >= state_->desired_capacity_.load(std::memory_order_relaxed))
+        {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(state_->mutex_);
+        const int workers = static_cast<int>(state_->workers_.size());
+        const int required =
+            std::min(queued_or_running - workers, state_->desired_capacity_ - workers);
+        if (!state_->please_shutdown_ && required > 0)
+        {
+            CollectFinishedWorkersUnlocked();
+            LaunchWorkersUnlocked(required);
+        }
+    }
+
+    // Run a task the queue had no room for on the calling thread
+    static void RunInline(internal::FnOnce<void()> task, const StopToken &stop_token,
+                          Executor::StopCallback &&stop_callback)
+    {
+        if (!stop_token.IsStopRequested())
+        {
+            std::move(task)();
+        }
+        else if (stop_callback)
+        {
+            std::move(stop_callback)(stop_token.Poll());
         }
     }
 
     Status ThreadPool::SpawnReal(TaskHints hints, internal::FnOnce<void()> task,
                                  StopToken stop_token, StopCallback &&stop_callback)
     {
+        return SpawnInternal(hints, std::move(task), std::move(stop_token), std::move(stop_callback),
+                             /*try_only=*/false);
+    }
+
+    Status ThreadPool::SpawnInternal(TaskHints hints, internal::FnOnce<void()> task,
+                                     StopToken stop_token, StopCallback &&stop_callback,
+                                     bool try_only)
+    {
+        if (hints.io_size >= 0)
+        {
+            Executor *io_executor = io_executor_.load(std::memory_order_relaxed);
+            if (io_executor != nullptr)
+            {
+                if (try_only)
+                {
+                    // Other executors may block or run the task inline
+                    auto *io_pool = dynamic_cast<ThreadPool *>(io_executor);
+                    if (io_pool == nullptr)
+                    {
+                        return Status::CapacityError("the I/O executor cannot try a spawn");
+                    }
+                    return io_pool->SpawnInternal(hints, std::move(task), std::move(stop_token),
+                                                  std::move(stop_callback), try_only);
+                }
+                return io_executor->Spawn(hints, std::move(task), std::move(stop_token),
+                                          std::move(stop_callback));
+            }
+        }
+        const bool throttled =
+            hints.io_size > 0 && state_->max_inflight_bytes_.load(std::memory_order_relaxed) > 0;
+        State::Worker *worker = current_worker_;
+        const bool from_worker = worker != nullptr && worker->state_ == state_;
+        if (from_worker && !throttled && !worker->IsRemote(hints.numa_node) &&
+            hints.external_id < 0 && hints.tenant_id < 0)
+        {
+            // Spawned from one of our workers: push to its local deque without
+            // taking the lock, other workers will steal it if they run dry.
+            if (state_->please_shutdown_.load(std::memory_order_relaxed))
+            {
+                return Status::Invalid("operation forbidden during or after shutdown");
+            }
+            const int band = PriorityBand(hints.priority);
+            if (!try_only && state_->ShouldRunInline(worker, hints, task, band))
+            {
+                RunTaskInline(worker, std::move(task), stop_token, std::move(stop_callback));
+                return Status::OK();
+            }
+            // Time one spawn out of kSpawnSamplePeriod, which is what
+            // inlining a cheaper task saves
+            constexpr uint32_t kSpawnSamplePeriod = 64;
+            const bool sample = worker->spawns_++ % kSpawnSamplePeriod == 0;
+            const int64_t now = NowNanos();
+            const int queued_or_running = ++state_->tasks_queued_or_running_;
+            auto *new_task = new (&worker->task_cache_) Task{std::move(task), std::move(stop_token),
+                                                             std::move(stop_callback), band,
+                                                             /*io_size=*/0, hints.numa_node, now};
+            state_->IndexTask(new_task);
+            state_->Trace(internal::TraceEvent::kEnqueue, new_task, &hints);
+            worker->local_tasks_[band].Push(new_task);
+            LaunchWorkersIfNeeded(queued_or_running);
+            state_->WakeIdleWorkers(1);
+            if (sample)
+            {
+                state_->RecordSpawnCost(NowNanos() - now);
+            }
+            return Status::OK();
+        }
+        ProtectAgainstFork();
+        if (!from_worker && ARROW_PREDICT_FALSE(state_->IsQueueFull()))
+        {
+            switch (try_only ? BackpressurePolicy::kFail : state_->backpressure_policy_.load())
+            {
+            case BackpressurePolicy::kFail:
+                return Status::CapacityError("thread pool queue is full");
+            case BackpressurePolicy::kRunInline:
+                RunInline(std::move(task), stop_token, std::move(stop_callback));
+                return Status::OK();
+            case BackpressurePolicy::kBlock:
+                state_->WaitForQueueSpace();
+                break;
+            }
+        }
+        if (hints.external_id >= 0)
+        {
+            // Like below, workers stay around until the strand is scheduled
+            state_->num_external_pushers_.fetch_add(1);
+            if (state_->please_shutdown_.load())
+            {
+                state_->num_external_pushers_.fetch_sub(1);
+                return Status::Invalid("operation forbidden during or after shutdown");
+            }
+            const int queued_or_running = ++state_->tasks_queued_or_running_;
+            auto *new_task = new (state_->LocalTaskCache()) Task{std::move(task), std::move(stop_token),
+                                      std::move(stop_callback), PriorityBand(hints.priority),
+                                      /*io_size=*/0, /*numa_node=*/-1, NowNanos()};
+            state_->IndexTask(new_task);
+            state_->Trace(internal::TraceEvent::kEnqueue, new_task, &hints);
+            if (Task *drain = state_->EnqueueOnStrand(hints.external_id, new_task))
+            {
+                state_->PushTask(drain, /*global=*/false);
+            }
+            state_->num_external_pushers_.fetch_sub(1);
+            LaunchWorkersIfNeeded(queued_or_running);
+            state_->WakeIdleWorkers(1);
+            return Status::OK();
+        }
+        if (hints.tenant_id >= 0)
+        {
+            // Same as strands, with a dispatcher per runnable worker
+            state_->num_external_pushers_.fetch_add(1);
+            if (state_->please_shutdown_.load())
+            {
+                state_->num_external_pushers_.fetch_sub(1);
+                return Status::Invalid("operation forbidden during or after shutdown");
+            }
+            const int queued_or_running = ++state_->tasks_queued_or_running_;
+            auto *new_task = new (state_->LocalTaskCache()) Task{std::move(task), std::move(stop_token),
+                                      std::move(stop_callback), PriorityBand(hints.priority),
+                                      /*io_size=*/0, /*numa_node=*/-1, NowNanos()};
+            state_->IndexTask(new_task);
+            state_->Trace(internal::TraceEvent::kEnqueue, new_task, &hints);
+            Task *dispatcher = state_->EnqueueForTenant(hints.tenant_id, new_task);
+            if (dispatcher != nullptr)
+            {
+                state_->PushTask(dispatcher, /*global=*/false);
+            }
+            state_->num_external_pushers_.fetch_sub(1);
+            LaunchWorkersIfNeeded(queued_or_running);
+            if (dispatcher != nullptr)
+            {
+                state_->WakeIdleWorkers(1);
+            }
+            return Status::OK();
+        }
+        if (!throttled && hints.numa_node < 0)
+        {
+            // Push to the lock-free ring. Announcing ourselves before checking
+            // for shutdown keeps the workers around until the task is queued.
+            state_->num_external_pushers_.fetch_add(1);
+            if (state_->please_shutdown_.load())
+            {
+                state_->num_external_pushers_.fetch_sub(1);
+                return Status::Invalid("operation forbidden during or after shutdown");
+            }
+            const int queued_or_running = ++state_->tasks_queued_or_running_;
+            auto *new_task = new (state_->LocalTaskCache()) Task{std::move(task), std::move(stop_token),
+                                      std::move(stop_callback), PriorityBand(hints.priority),
+                                      /*io_size=*/0, hints.numa_node, NowNanos()};
+            state_->IndexTask(new_task);
+            state_->Trace(internal::TraceEvent::kEnqueue, new_task, &hints);
+            if (!state_->pending_tasks_.TryPushLockFree(new_task))
+            {
+                std::lock_guard<std::mutex> lock(state_->mutex_);
+                state_->PushPendingTaskUnlocked(new_task);
+            }
+            state_->num_external_pushers_.fetch_sub(1);
+            LaunchWorkersIfNeeded(queued_or_running);
+            state_->WakeIdleWorkers(1);
+            return Status::OK();
+        }
         {
-            ProtectAgainstFork();
             std::lock_guard<std::mutex> lock(state_->mutex_);
             if (state_->please_shutdown_)
             {
                 return Status::Invalid("operation forbidden during or after shutdown");
             }
             CollectFinishedWorkersUnlocked();
-            state_->tasks_queued_or_running_++;
-            if (static_cast<int>(state_->workers_.size()) < state_->tasks_queued_or_running_ &&
+            const int queued_or_running = ++state_->tasks_queued_or_running_;
+            if (static_cast<int>(state_->workers_.size()) < queued_or_running &&
                 state_->desired_capacity_ > static_cast<int>(state_->workers_.size()))
             {
                 LaunchWorkersUnlocked(/*threads=*/1);
             }
-            state_->pending_tasks_.push_back(
-                {std::move(task), std::move(stop_token), std::move(stop_callback)});
+            auto *new_task = new (state_->LocalTaskCache()) Task{std::move(task), std::move(stop_token),
+                                      std::move(stop_callback), PriorityBand(hints.priority),
+                                      /*io_size=*/0, hints.numa_node, NowNanos()};
+            state_->IndexTask(new_task);
+            state_->Trace(internal::TraceEvent::kEnqueue, new_task, &hints);
+            if (throttled)
+            {
+                new_task->io_size = hints.io_size;
+                if (!state_->AdmitIOTaskUnlocked(new_task))
+                {
+                    // Queued until enough in-flight bytes are released
+                    return Status::OK();
+                }
+            }
+            state_->PushPendingTaskUnlocked(new_task);
+            if (state_->num_spinning_.load() == 0)
+            {
+                state_->UnparkWorkersUnlocked(1);
+            }
+        }
+        return Status::OK();
+    }
+
+    Status ThreadPool::SpawnAtReal(TaskHints hints, TimerClock::time_point deadline,
+                                   internal::FnOnce<void()> task, StopToken stop_token)
+    {
+        auto timer = std::make_unique<Timer>();
+        timer->hints = hints;
+        timer->deadline_nanos =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count();
+        timer->once = std::move(task);
+        timer->stop_token = std::move(stop_token);
+        ProtectAgainstFork();
+        if (!state_->ArmTimer(std::move(timer)))
+        {
+            return Status::Invalid("operation forbidden during or after shutdown");
+        }
+        // The workers run the timers, make sure there is one
+        LaunchWorkersIfNeeded(/*queued_or_running=*/1);
+        return Status::OK();
+    }
+
+    Status ThreadPool::SpawnEveryReal(TaskHints hints, TimerClock::duration period,
+                                      std::function<void()> task, StopToken stop_token)
+    {
+        const int64_t period_nanos =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(period).count();
+        if (period_nanos <= 0)
+        {
+            return Status::Invalid("timer period must be positive");
+        }
+        auto timer = std::make_unique<Timer>();
+        timer->hints = hints;
+        timer->deadline_nanos = NowNanos() + period_nanos;
+        timer->period_nanos = period_nanos;
+        timer->repeat = std::move(task);
+        timer->stop_token = std::move(stop_token);
+        ProtectAgainstFork();
+        if (!state_->ArmTimer(std::move(timer)))
+        {
+            return Status::Invalid("operation forbidden during or after shutdown");
+        }
+        LaunchWorkersIfNeeded(/*queued_or_running=*/1);
+        return Status::OK();
+    }
+
+    Status ThreadPool::SpawnBatchReal(std::vector<BatchTask> tasks)
+    {
+        if (tasks.empty())
+        {
+            return Status::OK();
+        }
+        Executor *io_executor = io_executor_.load(std::memory_order_relaxed);
+        const bool throttling = state_->max_inflight_bytes_.load(std::memory_order_relaxed) > 0;
+        bool throttled = false;
+        if (io_executor != nullptr || throttling)
+        {
+            // Stable, to keep the order of the keyed tasks and of each band
+            std::vector<BatchTask> io_tasks;
+            auto it = std::stable_partition(tasks.begin(), tasks.end(), [&](const BatchTask &task)
+                                            { return io_executor == nullptr || task.hints.io_size < 0; });
+            std::move(it, tasks.end(), std::back_inserter(io_tasks));
+            tasks.erase(it, tasks.end());
+            if (!io_tasks.empty())
+            {
+                Status st = io_executor->SpawnBatch(std::move(io_tasks));
+                if (!st.ok())
+                {
+                    return st;
+                }
+            }
+            throttled = throttling && std::any_of(tasks.begin(), tasks.end(),
+                                                  [](const BatchTask &task)
+                                                  { return task.hints.io_size > 0; });
+            if (tasks.empty())
+            {
+                return Status::OK();
+            }
+        }
+        const auto queued_apart = [](const BatchTask &task)
+        { return task.hints.external_id >= 0 || task.hints.tenant_id >= 0; };
+        if (std::any_of(tasks.begin(), tasks.end(), queued_apart))
+        {
+            // Keyed and tenant tasks go through their queues one by one, in order
+            auto keyed = std::stable_partition(tasks.begin(), tasks.end(), [&](const BatchTask &task)
+                                               { return !queued_apart(task); });
+            for (auto it = keyed; it != tasks.end(); ++it)
+            {
+                Status st = SpawnReal(it->hints, std::move(it->callable), std::move(it->stop_token),
+                                      std::move(it->stop_callback));
+                if (!st.ok())
+                {
+                    return st;
+                }
+            }
+            tasks.erase(keyed, tasks.end());
+            if (tasks.empty())
+            {
+                return Status::OK();
+            }
+        }
+        State::Worker *worker = current_worker_;
+        const bool from_worker = worker != nullptr && worker->state_ == state_;
+        const auto estimated_cost = [&](const BatchTask &task) -> int64_t
+        {
+            if (task.hints.cpu_cost >= 0 || !from_worker)
+            {
+                return task.hints.cpu_cost;
+            }
+            return worker->costs_.Estimate(task.callable.target_type());
+        };
+        if (std::any_of(tasks.begin(), tasks.end(), [&](const BatchTask &task)
+                        { return estimated_cost(task) >= 0; }))
+        {
+            // Longest first, tasks of unknown cost last, so the long tasks
+            // start early instead of stretching the tail of the batch
+            std::stable_sort(tasks.begin(), tasks.end(), [&](const BatchTask &a, const BatchTask &b)
+                             { return estimated_cost(a) > estimated_cost(b); });
+        }
+        const int num_tasks = static_cast<int>(tasks.size());
+        const int64_t now = NowNanos();
+        if (from_worker && !throttled &&
+            std::none_of(tasks.begin(), tasks.end(), [&](const BatchTask &task)
+                         { return worker->IsRemote(task.hints.numa_node); }))
+        {
+            if (state_->please_shutdown_.load(std::memory_order_relaxed))
+            {
+                return Status::Invalid("operation forbidden during or after shutdown");
+            }
+            const int queued_or_running = (state_->tasks_queued_or_running_ += num_tasks);
+            // Pushed last to first: the owner pops the newest task, so it runs
+            // the batch in order
+            for (auto it = tasks.rbegin(); it != tasks.rend(); ++it)
+            {
+                auto &task = *it;
+                const int band = PriorityBand(task.hints.priority);
+                auto *new_task = new (&worker->task_cache_) Task{std::move(task.callable),
+                                                                 std::move(task.stop_token),
+                                                                 std::move(task.stop_callback), band,
+                                                                 /*io_size=*/0, task.hints.numa_node, now};
+                state_->IndexTask(new_task);
+                state_->Trace(internal::TraceEvent::kEnqueue, new_task, &task.hints);
+                worker->local_tasks_[band].Push(new_task);
+            }
+            LaunchWorkersIfNeeded(queued_or_running);
+            state_->WakeIdleWorkers(num_tasks);
+            return Status::OK();
+        }
+        ProtectAgainstFork();
+        // The whole batch is admitted at once when the queue has room
+        if (!from_worker)
+        {
+            if (ARROW_PREDICT_FALSE(state_->IsQueueFull()))
+            {
+                switch (state_->backpressure_policy_.load())
+                {
+                case BackpressurePolicy::kFail:
+                    return Status::CapacityError("thread pool queue is full");
+                case BackpressurePolicy::kRunInline:
+                    for (auto &task : tasks)
+                    {
+                        RunInline(std::move(task.callable), task.stop_token,
+                                  std::move(task.stop_callback));
+                    }
+                    return Status::OK();
+                case BackpressurePolicy::kBlock:
+                    state_->WaitForQueueSpace();
+                    break;
+                }
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(state_->mutex_);
+            if (state_->please_shutdown_)
+            {
+                return Status::Invalid("operation forbidden during or after shutdown");
+            }
+            CollectFinishedWorkersUnlocked();
+            const int queued_or_running = (state_->tasks_queued_or_running_ += num_tasks);
+            const int workers = static_cast<int>(state_->workers_.size());
+            const int required =
+                std::min(queued_or_running - workers, state_->desired_capacity_ - workers);
+            if (required > 0)
+            {
+                LaunchWorkersUnlocked(required);
+            }
+            for (auto &task : tasks)
+            {
+                auto *new_task = new (state_->LocalTaskCache()) Task{std::move(task.callable), std::move(task.stop_token),
+                                          std::move(task.stop_callback),
+                                          PriorityBand(task.hints.priority), /*io_size=*/0,
+                                          task.hints.numa_node, now};
+                state_->IndexTask(new_task);
+                state_->Trace(internal::TraceEvent::kEnqueue, new_task, &task.hints);
+                if (throttled && task.hints.io_size > 0)
+                {
+                    new_task->io_size = task.hints.io_size;
+                    if (!state_->AdmitIOTaskUnlocked(new_task))
+                    {
+                        continue;
+                    }
+                }
+                state_->PushPendingTaskUnlocked(new_task);
+            }
+            state_->UnparkWorkersUnlocked(num_tasks - state_->num_spinning_.load());
         }
-        state_->cv_.notify_one();
         return Status::OK();
     }
 
@@ -328,7 +3513,8 @@ namespace arrow
         capacity = ParseOMPEnvVar("OMP_NUM_THREADS");
         if (capacity == 0)
         {
-            capacity = std::thread::hardware_concurrency();
+            // Respect the CPU mask, which containers and taskset restrict
+            capacity = static_cast<int>(internal::GetAllowedCpus().size());
         }
         limit = ParseOMPEnvVar("OMP_THREAD_LIMIT");
         if (limit > 0)
@@ -351,9 +3537,62 @@ namespace arrow
         {
             Status().Abort("Failed to create global CPU thread pool");
         }
+        // Keep blocking I/O off the CPU workers
+        (*maybe_pool)->SetIOExecutor(GetIOThreadPool());
+        return *std::move(maybe_pool);
+    }
+
+    static int64_t ParseInt64EnvVar(const char *name)
+    {
+        auto result = GetEnvVar(name);
+        if (!result.has_value())
+        {
+            return 0;
+        }
+        try
+        {
+            return std::max<int64_t>(0, std::stoll(*result));
+        }
+        catch (...)
+        {
+            return 0;
+        }
+    }
+
+    int ThreadPool::DefaultIOCapacity()
+    {
+        int capacity = static_cast<int>(ParseInt64EnvVar("ARROW_IO_THREADS"));
+        return capacity > 0 ? capacity : kDefaultIOCapacity;
+    }
+
+    std::shared_ptr<ThreadPool> ThreadPool::MakeIOThreadPool()
+    {
+        auto maybe_pool = ThreadPool::MakeEternal(ThreadPool::DefaultIOCapacity());
+        if (!maybe_pool.has_value())
+        {
+            Status().Abort("Failed to create global IO thread pool");
+        }
+        const int64_t max_inflight_bytes = ParseInt64EnvVar("ARROW_IO_MAX_INFLIGHT_BYTES");
+        if (max_inflight_bytes > 0)
+        {
+            DCHECK_OK((*maybe_pool)->SetMaxInFlightBytes(max_inflight_bytes));
+        }
         return *std::move(maybe_pool);
     }
 
+    ThreadPool *GetIOThreadPool()
+    {
+        static std::shared_ptr<ThreadPool> singleton = ThreadPool::MakeIOThreadPool();
+        return singleton.get();
+    }
+
+    int GetIOThreadPoolCapacity() { return GetIOThreadPool()->GetCapacity(); }
+
+    Status SetIOThreadPoolCapacity(int threads)
+    {
+        return GetIOThreadPool()->SetCapacity(threads);
+    }
+
     ThreadPool *GetCpuThreadPool()
     {
         static std::shared_ptr<ThreadPool> singleton = ThreadPool::MakeCpuThreadPool();
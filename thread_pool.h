@@ -2,14 +2,18 @@
 
 #include <unistd.h>
 
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
 #include <functional>
 #include <future>
 #include <memory>
 #include <optional>
 #include <queue>
+#include <string>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "cancel.h"
 #include "functional.h"
@@ -23,6 +27,157 @@ namespace arrow
     class StopToken;
     ARROW_EXPORT int GetCpuThreadPoolCapacity();
     ARROW_EXPORT Status SetCpuThreadPoolCapacity(int threads);
+    ARROW_EXPORT int GetIOThreadPoolCapacity();
+    ARROW_EXPORT Status SetIOThreadPoolCapacity(int threads);
+
+    // Placement of pool workers on CPUs
+    enum class ThreadAffinity
+    {
+        // Let the kernel schedule workers anywhere in the process's CPU mask
+        kNone,
+        // Fill the CPUs of one NUMA node before moving on to the next
+        kCompact,
+        // Spread consecutive workers over the NUMA nodes
+        kScatter,
+        // Pin workers round-robin to an explicit list of CPUs
+        kExplicit,
+    };
+
+    // How a worker that runs out of tasks waits for more. Spinning trades CPU
+    // time for wake-up latency on bursty workloads; set both to 0 to park
+    // right away.
+    struct ParkingOptions
+    {
+        // Rounds of polling the queues with a CPU pause in between
+        int spin_rounds = 64;
+        // Then rounds of polling with a yield in between, before parking
+        int yield_rounds = 8;
+    };
+
+    // Bounds and triggers of ThreadPool::EnableAutoscaling()
+    struct AutoscaleOptions
+    {
+        int min_threads = 1;
+        // <= 0 means DefaultCapacity()
+        int max_threads = 0;
+        // Parked workers above min_threads exit after this long without work
+        int64_t idle_timeout_ms = 10000;
+        // Add a worker when a task waited longer than this in the queue
+        int64_t grow_queue_wait_us = 1000;
+    };
+
+    // What a spawn from outside the pool does when the queue is full, see
+    // ThreadPool::SetMaxQueuedTasks()
+    enum class BackpressurePolicy
+    {
+        // Wait until running tasks make room
+        kBlock,
+        // Fail with a CapacityError
+        kFail,
+        // Run the task on the calling thread
+        kRunInline,
+    };
+
+    // When a task spawned from one of the pool's workers runs right away on
+    // that worker instead of being queued, see ThreadPool::SetInlineOptions().
+    // Off by default.
+    struct InlineOptions
+    {
+        // Run tasks whose estimated cost is below this many nanoseconds. The
+        // estimate is TaskHints::cpu_cost, or the run time learned for the
+        // task's callable type when no hint is given. -1 means the measured
+        // cost of a spawn, 0 disables cost-based inlining.
+        int64_t max_cost_nanos = 0;
+        // Also run tasks inline while the pool is saturated: every worker is
+        // busy and the spawning worker's queue holds at least this many
+        // tasks. 0 disables it.
+        int saturated_queue_depth = 0;
+        // Bound on nested inline runs, so that recursive spawners cannot
+        // overflow the stack
+        int max_depth = 16;
+    };
+
+    // Share of a ThreadPool given to the tasks of one tenant, see
+    // TaskHints::tenant_id and ThreadPool::SetTenantOptions()
+    struct TenantOptions
+    {
+        // Share of the run time while tenants compete, relative to the other
+        // tenants' weights
+        int weight = 1;
+        // Most tasks of the tenant running at once, 0 for no limit
+        int max_concurrency = 0;
+    };
+
+    // Durations in log2 buckets: bucket i counts durations in [2^i, 2^(i+1))
+    // nanoseconds, bucket 0 also counts 0 and the last one everything above.
+    struct ARROW_EXPORT LatencyHistogram
+    {
+        static constexpr int kNumBuckets = 40;
+        static int BucketFor(int64_t nanos);
+
+        int64_t Count() const;
+        // Upper bound in nanoseconds of the bucket holding quantile q in [0, 1]
+        int64_t Quantile(double q) const;
+
+        int64_t buckets[kNumBuckets] = {};
+    };
+
+    struct ARROW_EXPORT WorkerCounters
+    {
+        int64_t tasks_executed = 0;
+        // Tasks whose stop token was triggered before they could start
+        int64_t tasks_cancelled = 0;
+        // Tasks taken from another worker's queue
+        int64_t tasks_stolen = 0;
+        // Tasks run inline by the worker that spawned them, not counted in
+        // tasks_executed nor busy_nanos
+        int64_t tasks_inlined = 0;
+        int64_t parks = 0;
+        int64_t wakeups = 0;
+        // Time running tasks, and time between tasks spent searching or parked
+        int64_t busy_nanos = 0;
+        int64_t idle_nanos = 0;
+
+        WorkerCounters &operator+=(const WorkerCounters &other);
+    };
+
+    // Accounting of one tenant's tasks, see TaskHints::tenant_id
+    struct ARROW_EXPORT TenantMetrics
+    {
+        int64_t tenant_id = -1;
+        int64_t tasks_executed = 0;
+        // Time running the tenant's tasks
+        int64_t busy_nanos = 0;
+        // Time from Spawn() to the start of the tenant's tasks, including
+        // the wait for their turn
+        LatencyHistogram queue_wait;
+        int64_t num_queued_tasks = 0;
+        int num_running_tasks = 0;
+    };
+
+    // Snapshot returned by ThreadPool::GetMetrics(). Counters are cumulative
+    // since the pool was created.
+    struct ThreadPoolMetrics
+    {
+        WorkerCounters total;
+        // One entry per worker slot, including slots of exited workers
+        std::vector<WorkerCounters> per_worker;
+        // Time from Spawn() to the start of the task
+        LatencyHistogram queue_wait;
+        // Run time of the tasks that were not cancelled
+        LatencyHistogram run_time;
+        int64_t num_queued_tasks = 0;
+        int num_workers = 0;
+        int num_parked_workers = 0;
+        // Workers inside a blocking region, see ThreadPool::EnterBlocking()
+        int num_blocked_workers = 0;
+        // Measured cost of queueing a task from a worker, the default inline
+        // threshold
+        int64_t spawn_cost_nanos = 0;
+        // One entry per tenant that spawned tasks or has options, by
+        // increasing id
+        std::vector<TenantMetrics> tenants;
+    };
 
     class ARROW_EXPORT ThreadPool : public Executor
     {
@@ -31,12 +186,141 @@ namespace arrow
         static std::optional<std::shared_ptr<ThreadPool>> MakeEternal(int threads);
 
         ~ThreadPool();
-        int GetCapacity();
+        int GetCapacity() override;
+        // Only helps when called from one of this pool's workers
+        bool RunPendingTask() override;
+        // Tasks spawned with TaskHints::external_id >= 0 are serialized per id
+        // through a strand: a queue that one worker at a time drains, up to
+        // kStrandBatch tasks before requeueing it behind the other work.
+        // Different ids run in parallel. Such tasks are not subject to the
+        // I/O byte budget nor to NUMA placement.
+        static constexpr int kStrandBatch = 32;
         bool OwnsThisThread();
         int GetNumTasks();
+        // Counters are kept per worker without atomic read-modify-writes and
+        // summed up here, without taking the pool lock
+        ThreadPoolMetrics GetMetrics();
+
+        // TaskHints::priority is mapped to one of kNumPriorityBands scheduling
+        // bands, band 0 being the most urgent. Priority 0 (the default) maps to
+        // kDefaultPriorityBand, higher priorities to more urgent bands.
+        static constexpr int kNumPriorityBands = 4;
+        static constexpr int kDefaultPriorityBand = 2;
+        static int PriorityBand(int32_t priority);
+        // Number of queued (not yet running) tasks in each priority band
+        std::vector<int64_t> GetNumQueuedTasksByPriority();
 
         Status SetCapacity(int threads);
         static int DefaultCapacity();
+        // Capacity of the global IO pool: ARROW_IO_THREADS, or kDefaultIOCapacity
+        static constexpr int kDefaultIOCapacity = 8;
+        static int DefaultIOCapacity();
+
+        // Forward tasks with TaskHints::io_size >= 0 to `executor` (nullptr to
+        // run them here). The global CPU pool forwards to GetIOThreadPool().
+        void SetIOExecutor(Executor *executor);
+        // Limit the sum of TaskHints::io_size over running and queued tasks;
+        // tasks beyond it wait in FIFO order. A task larger than the limit runs
+        // alone. <= 0 means unlimited (the default).
+        Status SetMaxInFlightBytes(int64_t max_bytes);
+        int64_t GetMaxInFlightBytes();
+
+        // Pin worker i to one CPU of the placement, taken modulo its size; the
+        // CPUs must belong to the process's affinity mask. Pinned workers take
+        // tasks hinted for their NUMA node (TaskHints::numa_node) and steal
+        // from workers of the same node before going remote. Running workers
+        // re-pin themselves the next time they look for work.
+        Status SetAffinity(ThreadAffinity affinity, std::vector<int> cpus = {});
+
+        // Bound the tasks waiting to run: once more than `max_queued` tasks
+        // beyond the capacity are queued or running, spawns from outside the
+        // pool apply `policy`. Spawns from the pool's own workers are never
+        // held back, so that running tasks can always make progress. The
+        // bound is checked without the lock and may be overshot by concurrent
+        // submitters. <= 0 means unlimited (the default).
+        Status SetMaxQueuedTasks(int64_t max_queued,
+                                 BackpressurePolicy policy = BackpressurePolicy::kBlock);
+        int64_t GetMaxQueuedTasks();
+
+        // Like Spawn(), but never blocks nor runs the task inline: fails with
+        // a CapacityError if the queue is full, or if the task is for an I/O
+        // executor that is not a ThreadPool
+        template <typename Function>
+        Status TrySpawn(Function &&func)
+        {
+            return TrySpawn(TaskHints{}, std::forward<Function>(func));
+        }
+        template <typename Function>
+        Status TrySpawn(TaskHints hints, Function &&func,
+                        StopToken stop_token = StopToken::Unstoppable())
+        {
+            return SpawnInternal(hints, std::forward<Function>(func), std::move(stop_token),
+                                 StopCallback{}, /*try_only=*/true);
+        }
+
+        // Let the capacity float between options.min_threads and
+        // options.max_threads: a worker that starts a task which waited more
+        // than grow_queue_wait_us raises the capacity by one (at most once per
+        // such period), and workers parked for idle_timeout_ms secede and
+        // lower it. SetCapacity() still sets the current capacity.
+        Status EnableAutoscaling(AutoscaleOptions options = {});
+        // Keep the current capacity from now on
+        void DisableAutoscaling();
+
+        // Bracket a section of a task that blocks (a synchronous RPC, page
+        // faults on mmap'ed data...): the pool raises its capacity by one
+        // meanwhile, launching a worker if tasks are queued, so that runnable
+        // tasks keep the CPUs busy. One extra worker secedes once the section
+        // ends. Regions nest; outside of a pool worker this does nothing.
+        static void EnterBlocking();
+        static void ExitBlocking();
+        // Cap on the capacity added for blocked workers at any time,
+        // DefaultCapacity() initially. 0 disables compensation.
+        Status SetMaxCompensationThreads(int threads);
+
+        // Memory for the running task, from a per-worker bump arena: valid
+        // until the task returns, then reclaimed wholesale without freeing.
+        // Inline-run tasks get their own. nullptr outside of a pool worker.
+        static void *AllocateScratch(size_t size, size_t alignment = alignof(std::max_align_t));
+
+        // Once enabled, tasks spawned from a worker may run inline, before
+        // Spawn() returns: a task must not then spawn work while holding a
+        // lock that work takes, nor expect to return before it runs.
+        // TrySpawn(), batches, strands and tasks for another NUMA node or
+        // under the I/O byte budget are always queued. SpawnBatch() queues
+        // tasks by decreasing estimated cost, so that the longest start first.
+        Status SetInlineOptions(InlineOptions options);
+        InlineOptions GetInlineOptions();
+
+        // Tasks spawned with TaskHints::tenant_id >= 0 wait in one queue per
+        // tenant, and the pool picks the next one by deficit round robin over
+        // their run time: while tenants compete, each gets a share of the
+        // workers proportional to its weight, however many tasks the others
+        // queue. At most the capacity of tenant tasks run at once, kTenantBatch
+        // at a time per worker before the other work gets its turn. Keyed
+        // tasks (TaskHints::external_id) go through their strand instead, and
+        // tenant tasks are not subject to the I/O byte budget nor to NUMA
+        // placement. Tenants are kept, with their metrics, for the life of
+        // the pool.
+        static constexpr int kTenantBatch = 32;
+        Status SetTenantOptions(int64_t tenant_id, TenantOptions options);
+
+        // Record what the pool does, with TSC timestamps: the enqueue of
+        // tasks with their hints, their start and end, steals, parks,
+        // wake-ups and cancellations. Each worker, and the outside threads
+        // together, keep their last events_per_thread events in a ring
+        // allocated by the first call, then kept for the life of the pool.
+        // While tracing is off, each event costs a relaxed load.
+        Status EnableTracing(size_t events_per_thread = 1 << 16);
+        void DisableTracing();
+        // The recorded events as Chrome trace JSON, which chrome://tracing
+        // and ui.perfetto.dev open. Events recorded meanwhile may be garbled:
+        // export after WaitForIdle() or DisableTracing().
+        std::string ExportTrace();
+
+        // Only one worker of the pool spins at a time, the others park
+        Status SetParkingOptions(ParkingOptions options);
+        ParkingOptions GetParkingOptions();
 
         Status Shutdown(bool wait = true);
 
@@ -46,11 +330,32 @@ namespace arrow
 
     protected:
         friend ARROW_EXPORT ThreadPool *GetCpuThreadPool();
+        friend ARROW_EXPORT ThreadPool *GetIOThreadPool();
 
         ThreadPool();
 
+        // Cancellation is eager: tasks and timers spawned with a stop token
+        // are linked, without locking, in a group per stop source, and
+        // StopSource::RequestStop() drops the whole group. The stop callbacks
+        // run in chunks on the calling thread and on idle workers; it returns
+        // once they all ran. A dropped task no longer counts as queued, but
+        // its emptied node is only freed when dequeued. Running tasks can use
+        // StopToken::RegisterCallback() to abort.
         Status SpawnReal(TaskHints hints, internal::FnOnce<void()> task, StopToken,
                          StopCallback &&);
+        Status SpawnBatchReal(std::vector<BatchTask> tasks) override;
+        // Timers live in a timer wheel serviced by the workers: one parked
+        // worker sleeps until the next timer is due, and busy workers fire
+        // due timers between tasks. Pending timers are dropped on shutdown.
+        Status SpawnAtReal(TaskHints hints, TimerClock::time_point deadline,
+                           internal::FnOnce<void()> task, StopToken stop_token) override;
+        Status SpawnEveryReal(TaskHints hints, TimerClock::duration period,
+                              std::function<void()> task, StopToken stop_token) override;
+        // try_only: fail instead of applying the backpressure policy
+        Status SpawnInternal(TaskHints hints, internal::FnOnce<void()> task, StopToken,
+                             StopCallback &&, bool try_only);
+        // Launch a worker for the new tasks if the pool is below capacity
+        void LaunchWorkersIfNeeded(int queued_or_running);
 
         void CollectFinishedWorkersUnlocked();
         void LaunchWorkersUnlocked(int threads);
@@ -58,12 +363,27 @@ namespace arrow
         void ProtectAgainstFork();
 
         static std::shared_ptr<ThreadPool> MakeCpuThreadPool();
+        static std::shared_ptr<ThreadPool> MakeIOThreadPool();
 
         std::shared_ptr<State> sp_state_;
         State *state_;
         bool shutdown_on_destroy_;
         pid_t pid_;
+        std::atomic<Executor *> io_executor_{nullptr};
+    };
+
+    // RAII helper for ThreadPool::EnterBlocking() / ExitBlocking()
+    class ScopedBlockingRegion
+    {
+    public:
+        ScopedBlockingRegion() { ThreadPool::EnterBlocking(); }
+        ~ScopedBlockingRegion() { ThreadPool::ExitBlocking(); }
+
+        ScopedBlockingRegion(const ScopedBlockingRegion &) = delete;
+        ScopedBlockingRegion &operator=(const ScopedBlockingRegion &) = delete;
     };
 
     ARROW_EXPORT ThreadPool *GetCpuThreadPool();
+    // Global pool for blocking I/O, sized independently of the CPU pool
+    ARROW_EXPORT ThreadPool *GetIOThreadPool();
 }
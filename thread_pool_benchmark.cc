@@ -0,0 +1,378 @@
+// Scheduler benchmarks for ThreadPool. Each case runs for every pool size in
+// --threads (default: 1, 2, 4, ... up to DefaultCapacity()) and is repeated
+// --reps times. Results go to stdout as one JSON document with percentiles
+// over the repetitions (or over the individual samples for latencies), so that
+// runs of different versions can be diffed.
+//
+// Usage: thread_pool_benchmark [--threads=1,2,8] [--reps=N] [--tasks=N]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cancel.h"
+#include "future.h"
+#include "macros.h"
+#include "pipeline.h"
+#include "thread_pool.h"
+
+namespace arrow
+{
+    namespace
+    {
+        using Clock = std::chrono::steady_clock;
+
+        struct Config
+        {
+            std::vector<int> threads;
+            int reps = 10;
+            int tasks = 100000;
+        };
+
+        int64_t NowNanos()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch())
+                .count();
+        }
+
+        double NanosSince(Clock::time_point start)
+        {
+            return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        }
+
+        double Percentile(std::vector<double> samples, double q)
+        {
+            std::sort(samples.begin(), samples.end());
+            const size_t rank = static_cast<size_t>(q * (samples.size() - 1) + 0.5);
+            return samples[rank];
+        }
+
+        bool first_result = true;
+
+        // Print one result; `samples` are nanoseconds per operation
+        void Report(const char *name, int threads, const std::string &params,
+                    const std::vector<double> &samples)
+        {
+            double sum = 0;
+            for (double s : samples)
+            {
+                sum += s;
+            }
+            std::printf("%s\n    {\"name\": \"%s\", \"threads\": %d, \"params\": {%s}, \"unit\": \"ns\", "
+                        "\"samples\": %zu, \"mean\": %.1f, \"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, "
+                        "\"max\": %.1f}",
+                        first_result ? "" : ",", name, threads, params.c_str(), samples.size(),
+                        sum / samples.size(), Percentile(samples, 0.5), Percentile(samples, 0.9),
+                        Percentile(samples, 0.99), Percentile(samples, 1.0));
+            first_result = false;
+            std::fflush(stdout);
+        }
+
+        // Empty tasks spawned by `producers` external threads
+        void BenchmarkSpawnExternal(const Config &config, ThreadPool *pool, int threads, int producers)
+        {
+            std::vector<double> samples;
+            const int per_producer = config.tasks / producers;
+            for (int rep = 0; rep < config.reps; ++rep)
+            {
+                std::atomic<int64_t> done{0};
+                std::vector<std::thread> producer_threads;
+                const auto start = Clock::now();
+                for (int p = 0; p < producers; ++p)
+                {
+                    producer_threads.emplace_back([&]
+                                                  {
+                        for (int i = 0; i < per_producer; ++i)
+                        {
+                            DCHECK_OK(pool->Spawn([&] { done.fetch_add(1, std::memory_order_relaxed); }));
+                        } });
+                }
+                for (auto &t : producer_threads)
+                {
+                    t.join();
+                }
+                pool->WaitForIdle();
+                samples.push_back(NanosSince(start) / (per_producer * producers));
+            }
+            Report("spawn_external", threads, "\"producers\": " + std::to_string(producers), samples);
+        }
+
+        // Empty tasks spawned from inside the pool, by one task per worker
+        void BenchmarkSpawnNested(const Config &config, ThreadPool *pool, int threads,
+                                  const char *name = "spawn_nested")
+        {
+            std::vector<double> samples;
+            const int per_root = config.tasks / threads;
+            for (int rep = 0; rep < config.reps; ++rep)
+            {
+                std::atomic<int64_t> done{0};
+                const auto start = Clock::now();
+                for (int r = 0; r < threads; ++r)
+                {
+                    DCHECK_OK(pool->Spawn([&]
+                                          {
+                        for (int i = 0; i < per_root; ++i)
+                        {
+                            DCHECK_OK(pool->Spawn([&] { done.fetch_add(1, std::memory_order_relaxed); }));
+                        } }));
+                }
+                pool->WaitForIdle();
+                samples.push_back(NanosSince(start) / (per_root * threads));
+            }
+            Report(name, threads, "", samples);
+        }
+
+        // Time from Spawn() on an idle pool to the task starting
+        void BenchmarkWakeLatency(const Config &config, ThreadPool *pool, int threads)
+        {
+            std::vector<double> samples;
+            const int num_samples = std::max(100, config.reps * 20);
+            for (int i = 0; i < num_samples; ++i)
+            {
+                // Let the workers go idle
+                std::this_thread::sleep_for(std::chrono::microseconds(500));
+                std::atomic<int64_t> started{0};
+                const int64_t spawned = NowNanos();
+                DCHECK_OK(pool->Spawn([&]
+                                      { started.store(NowNanos()); }));
+                pool->WaitForIdle();
+                samples.push_back(static_cast<double>(started.load() - spawned));
+            }
+            Report("wake_latency", threads, "", samples);
+        }
+
+        // Submit `width` tasks and wait for all of their futures
+        void BenchmarkFanOut(const Config &config, ThreadPool *pool, int threads, int width)
+        {
+            std::vector<double> samples;
+            const int rounds = std::max(1, config.tasks / width / 10);
+            for (int rep = 0; rep < config.reps; ++rep)
+            {
+                const auto start = Clock::now();
+                for (int round = 0; round < rounds; ++round)
+                {
+                    std::vector<Future<int>> futures;
+                    futures.reserve(width);
+                    for (int i = 0; i < width; ++i)
+                    {
+                        futures.push_back(pool->Submit(TaskHints{}, [i]
+                                                       { return i; }));
+                    }
+                    auto all = All(std::move(futures));
+                    int64_t sum = 0;
+                    for (int value : all.get())
+                    {
+                        sum += value;
+                    }
+                    DCHECK_EQ(sum, int64_t{width} * (width - 1) / 2);
+                }
+                samples.push_back(NanosSince(start) / rounds);
+            }
+            Report("fan_out_fan_in", threads, "\"width\": " + std::to_string(width), samples);
+        }
+
+        // WaitForIdle() on an idle pool, and after a small burst of tasks
+        void BenchmarkWaitForIdle(const Config &config, ThreadPool *pool, int threads)
+        {
+            constexpr int kBurst = 16;
+            std::vector<double> idle_samples;
+            std::vector<double> burst_samples;
+            for (int rep = 0; rep < config.reps * 100; ++rep)
+            {
+                auto start = Clock::now();
+                pool->WaitForIdle();
+                idle_samples.push_back(NanosSince(start));
+
+                for (int i = 0; i < kBurst; ++i)
+                {
+                    DCHECK_OK(pool->Spawn([] {}));
+                }
+                start = Clock::now();
+                pool->WaitForIdle();
+                burst_samples.push_back(NanosSince(start));
+            }
+            Report("wait_for_idle", threads, "\"burst\": 0", idle_samples);
+            Report("wait_for_idle", threads, "\"burst\": " + std::to_string(kBurst), burst_samples);
+        }
+
+        // Spawn cost with a stoppable token, compared to spawn_nested without
+        void BenchmarkStopToken(const Config &config, ThreadPool *pool, int threads)
+        {
+            std::vector<double> samples;
+            StopSource source;
+            StopToken token = source.token();
+            const int per_root = config.tasks / threads;
+            for (int rep = 0; rep < config.reps; ++rep)
+            {
+                std::atomic<int64_t> done{0};
+                const auto start = Clock::now();
+                for (int r = 0; r < threads; ++r)
+                {
+                    DCHECK_OK(pool->Spawn([&]
+                                          {
+                        for (int i = 0; i < per_root; ++i)
+                        {
+                            DCHECK_OK(pool->Spawn([&] { done.fetch_add(1, std::memory_order_relaxed); },
+                                                  token));
+                        } }));
+                }
+                pool->WaitForIdle();
+                samples.push_back(NanosSince(start) / (per_root * threads));
+            }
+            Report("spawn_nested_stop_token", threads, "", samples);
+        }
+
+        // SetCapacity() latency while tasks keep the workers busy
+        void BenchmarkSetCapacity(const Config &config, ThreadPool *pool, int threads)
+        {
+            std::vector<double> samples;
+            std::atomic<bool> stop{false};
+            std::atomic<int64_t> done{0};
+            std::thread producer([&]
+                                 {
+                while (!stop.load())
+                {
+                    if (pool->GetNumTasks() < 4 * threads)
+                    {
+                        DCHECK_OK(pool->Spawn([&] { done.fetch_add(1, std::memory_order_relaxed); }));
+                    }
+                    else
+                    {
+                        std::this_thread::yield();
+                    }
+                } });
+            for (int rep = 0; rep < config.reps * 10; ++rep)
+            {
+                const int capacity = (rep % 2 == 0) ? std::max(1, threads / 2) : threads;
+                const auto start = Clock::now();
+                DCHECK_OK(pool->SetCapacity(capacity));
+                samples.push_back(NanosSince(start));
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            stop.store(true);
+            producer.join();
+            DCHECK_OK(pool->SetCapacity(threads));
+            pool->WaitForIdle();
+            Report("set_capacity_under_load", threads, "", samples);
+        }
+
+        // Items through a source -> transform -> sink pipeline
+        void BenchmarkPipeline(const Config &config, ThreadPool *pool, int threads, int parallelism)
+        {
+            std::vector<double> samples;
+            StageOptions options;
+            options.parallelism = parallelism;
+            for (int rep = 0; rep < config.reps; ++rep)
+            {
+                Pipeline pipeline(pool);
+                std::atomic<int> next{0};
+                std::atomic<int64_t> sum{0};
+                auto source = pipeline.AddSource([&]() -> std::optional<int>
+                                                 {
+                    const int value = next.fetch_add(1, std::memory_order_relaxed);
+                    if (value >= config.tasks)
+                    {
+                        return std::nullopt;
+                    }
+                    return value; });
+                auto doubled = pipeline.AddTransform(source, [](int value)
+                                                     { return int64_t{value} * 2; }, options);
+                pipeline.AddSink(doubled, [&](int64_t value)
+                                 { sum.fetch_add(value, std::memory_order_relaxed); });
+                const auto start = Clock::now();
+                DCHECK_OK(pipeline.Run().status());
+                samples.push_back(NanosSince(start) / config.tasks);
+                DCHECK_EQ(sum.load(), int64_t{config.tasks} * (config.tasks - 1));
+            }
+            Report("pipeline", threads, "\"parallelism\": " + std::to_string(parallelism), samples);
+        }
+
+        std::vector<int> ParseList(const char *arg)
+        {
+            std::vector<int> values;
+            for (const char *p = arg; *p != '\0';)
+            {
+                char *end;
+                const long value = std::strtol(p, &end, 10);
+                if (end == p)
+                {
+                    break;
+                }
+                values.push_back(static_cast<int>(value));
+                p = (*end == ',') ? end + 1 : end;
+            }
+            return values;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    using namespace arrow;
+    Config config;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strncmp(argv[i], "--threads=", 10) == 0)
+        {
+            config.threads = ParseList(argv[i] + 10);
+        }
+        else if (std::strncmp(argv[i], "--reps=", 7) == 0)
+        {
+            config.reps = std::max(1, std::atoi(argv[i] + 7));
+        }
+        else if (std::strncmp(argv[i], "--tasks=", 8) == 0)
+        {
+            config.tasks = std::max(1000, std::atoi(argv[i] + 8));
+        }
+        else
+        {
+            std::fprintf(stderr, "usage: %s [--threads=1,2,8] [--reps=N] [--tasks=N]\n", argv[0]);
+            return 1;
+        }
+    }
+    const int max_threads = ThreadPool::DefaultCapacity();
+    if (config.threads.empty())
+    {
+        for (int n = 1; n < max_threads; n *= 2)
+        {
+            config.threads.push_back(n);
+        }
+        config.threads.push_back(max_threads);
+    }
+
+    std::printf("{\n  \"context\": {\"hardware_threads\": %d, \"default_capacity\": %d, \"reps\": %d, "
+                "\"tasks\": %d},\n  \"benchmarks\": [",
+                static_cast<int>(std::thread::hardware_concurrency()), max_threads, config.reps,
+                config.tasks);
+    for (int threads : config.threads)
+    {
+        auto pool = *ThreadPool::Make(threads);
+        for (int producers = 1; producers <= threads; producers *= 2)
+        {
+            BenchmarkSpawnExternal(config, pool.get(), threads, producers);
+        }
+        BenchmarkSpawnNested(config, pool.get(), threads);
+        BenchmarkStopToken(config, pool.get(), threads);
+        BenchmarkWakeLatency(config, pool.get(), threads);
+        BenchmarkFanOut(config, pool.get(), threads, /*width=*/16);
+        BenchmarkFanOut(config, pool.get(), threads, /*width=*/256);
+        BenchmarkWaitForIdle(config, pool.get(), threads);
+        BenchmarkSetCapacity(config, pool.get(), threads);
+        BenchmarkPipeline(config, pool.get(), threads, /*parallelism=*/1);
+        BenchmarkPipeline(config, pool.get(), threads, /*parallelism=*/threads);
+        // The cost of tracing, against spawn_nested
+        DCHECK_OK(pool->EnableTracing());
+        BenchmarkSpawnNested(config, pool.get(), threads, "spawn_nested_traced");
+        pool->DisableTracing();
+        DCHECK_OK(pool->Shutdown());
+    }
+    std::printf("\n  ]\n}\n");
+    return 0;
+}
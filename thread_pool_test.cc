@@ -0,0 +1,1163 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include "affinity.h"
+#include "cancel.h"
+#include "future.h"
+#include "macros.h"
+#include "task_group.h"
+#include "test_util.h"
+#include "thread_pool.h"
+
+namespace arrow
+{
+    namespace
+    {
+        using Clock = std::chrono::steady_clock;
+
+        // Keeps the workers of a pool busy until Release()
+        class Blocker
+        {
+        public:
+            // With `blocking`, the tasks wait inside a ScopedBlockingRegion
+            Blocker(ThreadPool *pool, int workers, bool blocking = false)
+            {
+                for (int i = 0; i < workers; ++i)
+                {
+                    DCHECK_OK(pool->Spawn([state = state_, blocking]
+                                          {
+                        std::optional<ScopedBlockingRegion> region;
+                        if (blocking)
+                        {
+                            region.emplace();
+                        }
+                        state->started.fetch_add(1);
+                        while (!state->released.load())
+                        {
+                            std::this_thread::yield();
+                        } }));
+                }
+                while (state_->started.load() < workers)
+                {
+                    std::this_thread::yield();
+                }
+            }
+            ~Blocker() { Release(); }
+
+            void Release() { state_->released.store(true); }
+
+        private:
+            // Shared with the blocking tasks, which may outlive the blocker
+            struct State
+            {
+                std::atomic<int> started{0};
+                std::atomic<bool> released{false};
+            };
+            std::shared_ptr<State> state_ = std::make_shared<State>();
+        };
+
+        // Appends to a vector under a lock
+        class Recorder
+        {
+        public:
+            void Add(int value)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                values_.push_back(value);
+            }
+            std::vector<int> values()
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                return values_;
+            }
+
+        private:
+            std::mutex mutex_;
+            std::vector<int> values_;
+        };
+
+        std::shared_ptr<ThreadPool> MakePool(int threads) { return *ThreadPool::Make(threads); }
+
+        // Polls `predicate` for up to 10 seconds
+        template <typename Predicate>
+        bool WaitUntil(Predicate &&predicate)
+        {
+            const auto deadline = Clock::now() + std::chrono::seconds(10);
+            while (!predicate())
+            {
+                if (Clock::now() > deadline)
+                {
+                    return false;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            return true;
+        }
+
+        // Runs tasks on the spawning thread, failing the spawns after `limit`
+        class LimitedExecutor : public Executor
+        {
+        public:
+            explicit LimitedExecutor(int limit) : limit_(limit) {}
+
+            Status SpawnReal(TaskHints, internal::FnOnce<void()> task, StopToken, StopCallback &&) override
+            {
+                if (limit_-- <= 0)
+                {
+                    return Status::CapacityError("executor is full");
+                }
+                std::move(task)();
+                return Status::OK();
+            }
+
+        private:
+            int limit_;
+        };
+    }
+
+    TEST(ThreadPool, RunsAllTasks)
+    {
+        auto pool = MakePool(4);
+        std::atomic<int> count{0};
+        for (int i = 0; i < 10000; ++i)
+        {
+            ASSERT_OK(pool->Spawn([&]
+                                  { count.fetch_add(1); }));
+        }
+        pool->WaitForIdle();
+        ASSERT_EQ(10000, count.load());
+        auto future = pool->Submit([](int a, int b)
+                                   { return a + b; },
+                                   20, 22);
+        ASSERT_EQ(42, future.get());
+    }
+
+    TEST(Executor, SubmitBatchKeepsTheSpawnedTasksFutures)
+    {
+        LimitedExecutor executor(2);
+        std::vector<std::function<int()>> funcs;
+        for (int i = 0; i < 4; ++i)
+        {
+            funcs.push_back([i]
+                            { return i; });
+        }
+        auto futures = executor.SubmitBatch(funcs.begin(), funcs.end());
+        ASSERT_EQ(4, static_cast<int>(futures.size()));
+        ASSERT_EQ(0, futures[0].get());
+        ASSERT_EQ(1, futures[1].get());
+        ASSERT_STATUS(StatusCode::Cancelled, futures[2].status());
+        ASSERT_STATUS(StatusCode::Cancelled, futures[3].status());
+    }
+
+    TEST(ThreadPool, PriorityOrder)
+    {
+        auto pool = MakePool(1);
+        Recorder order;
+        {
+            Blocker blocker(pool.get(), 1);
+            const int priorities[] = {0, -1, 2, 0, 1, -1, 2};
+            for (int i = 0; i < 7; ++i)
+            {
+                TaskHints hints;
+                hints.priority = priorities[i];
+                ASSERT_OK(pool->Spawn(hints, [&, i]
+                                      { order.Add(i); }));
+            }
+            const std::vector<int64_t> depths = pool->GetNumQueuedTasksByPriority();
+            ASSERT_EQ(2, depths[0]);
+            ASSERT_EQ(1, depths[1]);
+            ASSERT_EQ(2, depths[2]);
+            ASSERT_EQ(2, depths[3]);
+        }
+        pool->WaitForIdle();
+        // By band, FIFO within a band
+        ASSERT_TRUE((order.values() == std::vector<int>{2, 6, 4, 0, 3, 1, 5}));
+    }
+
+    TEST(ThreadPool, StrandOrder)
+    {
+        auto pool = MakePool(4);
+        constexpr int kKeys = 4;
+        constexpr int kTasks = 2000;
+        std::vector<Recorder> orders(kKeys);
+        std::vector<std::atomic<int>> running(kKeys);
+        std::atomic<bool> overlapped{false};
+        for (int i = 0; i < kTasks; ++i)
+        {
+            TaskHints hints;
+            hints.external_id = i % kKeys;
+            ASSERT_OK(pool->Spawn(hints, [&, i]
+                                  {
+                const int key = i % kKeys;
+                if (running[key].fetch_add(1) != 0)
+                {
+                    overlapped.store(true);
+                }
+                orders[key].Add(i);
+                running[key].fetch_sub(1); }));
+        }
+        pool->WaitForIdle();
+        ASSERT_FALSE(overlapped.load());
+        for (int key = 0; key < kKeys; ++key)
+        {
+            const std::vector<int> values = orders[key].values();
+            ASSERT_EQ(static_cast<size_t>(kTasks / kKeys), values.size());
+            ASSERT_TRUE(std::is_sorted(values.begin(), values.end()));
+        }
+    }
+
+    TEST(ThreadPool, MixedIOBatchKeepsItsOrder)
+    {
+        auto pool = MakePool(1);
+        auto io_pool = MakePool(1);
+        pool->SetIOExecutor(io_pool.get());
+        Recorder keyed;
+        Recorder plain;
+        {
+            Blocker blocker(pool.get(), 1);
+            std::vector<Executor::BatchTask> tasks;
+            for (int i = 0; i < 12; ++i)
+            {
+                Executor::BatchTask task;
+                if (i % 2 == 1)
+                {
+                    task.hints.io_size = 4096;
+                    task.callable = [] {};
+                }
+                else if (i % 4 == 0)
+                {
+                    task.hints.external_id = 7;
+                    task.callable = [&keyed, i]
+                    { keyed.Add(i); };
+                }
+                else
+                {
+                    task.callable = [&plain, i]
+                    { plain.Add(i); };
+                }
+                tasks.push_back(std::move(task));
+            }
+            ASSERT_OK(pool->SpawnBatch(std::move(tasks)));
+        }
+        pool->WaitForIdle();
+        io_pool->WaitForIdle();
+        ASSERT_TRUE(keyed.values() == std::vector<int>({0, 4, 8}));
+        ASSERT_TRUE(plain.values() == std::vector<int>({2, 6, 10}));
+    }
+
+    TEST(ThreadPool, LocalBatchRunsLongestFirst)
+    {
+        auto pool = MakePool(1);
+        Recorder order;
+        ASSERT_OK(pool->Spawn([&]
+                              {
+            std::vector<Executor::BatchTask> tasks;
+            for (int cost : {1, 4, 2, 3})
+            {
+                Executor::BatchTask task;
+                task.hints.cpu_cost = cost * 1000000;
+                task.callable = [&order, cost]
+                { order.Add(cost); };
+                tasks.push_back(std::move(task));
+            }
+            DCHECK_OK(pool->SpawnBatch(std::move(tasks))); }));
+        pool->WaitForIdle();
+        ASSERT_TRUE(order.values() == std::vector<int>({4, 3, 2, 1}));
+    }
+
+    TEST(ThreadPool, InliningIsOptIn)
+    {
+        auto pool = MakePool(1);
+        const auto child_ran_before_spawn_returned = [&]
+        {
+            std::atomic<bool> ran{false};
+            std::atomic<bool> ran_inline{false};
+            ASSERT_OK(pool->Spawn([&]
+                                  {
+                TaskHints hints;
+                hints.cpu_cost = 1;
+                DCHECK_OK(pool->Spawn(hints, [&]
+                                      { ran.store(true); }));
+                ran_inline.store(ran.load()); }));
+            pool->WaitForIdle();
+            return ran_inline.load();
+        };
+        ASSERT_FALSE(child_ran_before_spawn_returned());
+        InlineOptions options;
+        options.max_cost_nanos = 1000;
+        ASSERT_OK(pool->SetInlineOptions(options));
+        ASSERT_TRUE(child_ran_before_spawn_returned());
+    }
+
+    TEST(ThreadPool, Timers)
+    {
+        auto pool = MakePool(2);
+        Recorder order;
+        const auto start = Clock::now();
+        std::atomic<int64_t> fired_after_ms{-1};
+        ASSERT_OK(pool->SpawnAfter(std::chrono::milliseconds(30), [&]
+                                   {
+            fired_after_ms.store(std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count());
+            order.Add(2); }));
+        ASSERT_OK(pool->SpawnAt(start + std::chrono::milliseconds(10), [&]
+                                { order.Add(1); }));
+        StopSource never;
+        std::atomic<bool> cancelled_fired{false};
+        ASSERT_OK(pool->SpawnAfter(std::chrono::milliseconds(10), [&]
+                                   { cancelled_fired.store(true); },
+                                   never.token()));
+        never.RequestStop();
+        StopSource every;
+        std::atomic<int> ticks{0};
+        ASSERT_OK(pool->SpawnEvery(std::chrono::milliseconds(5), [&]
+                                   { ticks.fetch_add(1); },
+                                   every.token()));
+        while (ticks.load() < 3 || order.values().size() < 2)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        every.RequestStop();
+        const int ticks_at_stop = ticks.load();
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        ASSERT_TRUE(ticks.load() <= ticks_at_stop + 1);
+        ASSERT_TRUE(fired_after_ms.load() >= 30);
+        ASSERT_TRUE((order.values() == std::vector<int>{1, 2}));
+        ASSERT_FALSE(cancelled_fired.load());
+    }
+
+    TEST(ThreadPool, TimersTakeHints)
+    {
+        auto pool = MakePool(1);
+        Recorder order;
+        {
+            Blocker blocker(pool.get(), 1);
+            const auto due = Clock::now();
+            for (int priority : {-1, 2, 0})
+            {
+                TaskHints hints;
+                hints.priority = priority;
+                ASSERT_OK(pool->SpawnAt(hints, due, [&order, priority]
+                                        { order.Add(priority); }));
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        while (order.values().size() < 3)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        ASSERT_TRUE((order.values() == std::vector<int>{2, 0, -1}));
+    }
+
+    TEST(ThreadPool, CancelQueuedTasks)
+    {
+        auto pool = MakePool(1);
+        StopSource source;
+        std::atomic<int> ran{0};
+        std::atomic<int> stopped{0};
+        Future<int> future;
+        {
+            Blocker blocker(pool.get(), 1);
+            for (int i = 0; i < 100; ++i)
+            {
+                ASSERT_OK(pool->Spawn(
+                    TaskHints{}, [&]
+                    { ran.fetch_add(1); },
+                    source.token(), [&](const Status &status)
+                    {
+                        if (status.code() == StatusCode::Cancelled)
+                        {
+                            stopped.fetch_add(1);
+                        } }));
+            }
+            future = pool->Submit(source.token(), []
+                                  { return 1; });
+            source.RequestStop(Status::Cancelled("stop"));
+        }
+        pool->WaitForIdle();
+        ASSERT_EQ(0, ran.load());
+        ASSERT_EQ(100, stopped.load());
+        ASSERT_STATUS(StatusCode::Cancelled, future.status());
+        // Spawning with a stopped token fails the task right away
+        std::atomic<bool> late_ran{false};
+        ASSERT_OK(pool->Spawn([&]
+                              { late_ran.store(true); },
+                              source.token()));
+        pool->WaitForIdle();
+        ASSERT_FALSE(late_ran.load());
+    }
+
+    TEST(ThreadPool, StopDropsOnlyItsSource)
+    {
+        auto pool = MakePool(1);
+        StopSource stopped_source;
+        StopSource other_source;
+        auto held = std::make_shared<int>(0);
+        std::atomic<int> stopped{0};
+        std::atomic<int> ran{0};
+        std::atomic<bool> timer_fired{false};
+        {
+            Blocker blocker(pool.get(), 1);
+            for (int i = 0; i < 10; ++i)
+            {
+                ASSERT_OK(pool->Spawn(
+                    TaskHints{}, [held]
+                    { *held += 1; },
+                    stopped_source.token(), [&](const Status &)
+                    { stopped.fetch_add(1); }));
+                ASSERT_OK(pool->Spawn([&]
+                                      { ran.fetch_add(1); },
+                                      other_source.token()));
+            }
+            ASSERT_OK(pool->SpawnAfter(std::chrono::hours(1), [held]
+                                       { *held += 1; },
+                                       stopped_source.token()));
+            ASSERT_OK(pool->SpawnAfter(std::chrono::milliseconds(1), [&]
+                                       { timer_fired.store(true); },
+                                       other_source.token()));
+            stopped_source.RequestStop();
+            // The tasks and the timer were dropped before it returned
+            ASSERT_EQ(10, stopped.load());
+            ASSERT_TRUE(held.use_count() == 1);
+        }
+        while (!timer_fired.load())
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        pool->WaitForIdle();
+        ASSERT_EQ(0, *held);
+        ASSERT_EQ(10, ran.load());
+    }
+
+    TEST(ThreadPool, StopRunsManyCallbacksOnce)
+    {
+        auto pool = MakePool(4);
+        StopSource source;
+        std::atomic<int> ran{0};
+        std::atomic<int> stopped{0};
+        for (int i = 0; i < 1000; ++i)
+        {
+            ASSERT_OK(pool->Spawn(
+                TaskHints{}, [&]
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    ran.fetch_add(1); },
+                source.token(), [&](const Status &)
+                { stopped.fetch_add(1); }));
+        }
+        // Idle workers help with the callbacks
+        source.RequestStop();
+        pool->WaitForIdle();
+        ASSERT_EQ(1000, ran.load() + stopped.load());
+        ASSERT_TRUE(stopped.load() >= 500);
+    }
+
+    TEST(ThreadPool, StopSourceIsReusedAfterItsTasksRan)
+    {
+        auto pool = MakePool(2);
+        StopSource source;
+        std::atomic<int> ran{0};
+        std::atomic<int> stopped{0};
+        for (int round = 0; round < 3; ++round)
+        {
+            for (int i = 0; i < 200; ++i)
+            {
+                ASSERT_OK(pool->Spawn(
+                    TaskHints{}, [&]
+                    { ran.fetch_add(1); },
+                    source.token(), [&](const Status &)
+                    { stopped.fetch_add(1); }));
+            }
+            pool->WaitForIdle();
+        }
+        ASSERT_EQ(600, ran.load());
+        // Nothing left to drop
+        source.RequestStop();
+        ASSERT_EQ(0, stopped.load());
+        // A reset source gets a group again
+        source.Reset();
+        {
+            Blocker blocker(pool.get(), 2);
+            for (int i = 0; i < 10; ++i)
+            {
+                ASSERT_OK(pool->Spawn(
+                    TaskHints{}, [&]
+                    { ran.fetch_add(1); },
+                    source.token(), [&](const Status &)
+                    { stopped.fetch_add(1); }));
+            }
+            source.RequestStop();
+            ASSERT_EQ(10, stopped.load());
+        }
+        pool->WaitForIdle();
+        ASSERT_EQ(600, ran.load());
+    }
+
+    TEST(ThreadPool, RunningTaskSeesStopCallback)
+    {
+        auto pool = MakePool(2);
+        StopSource source;
+        StopToken token = source.token();
+        std::atomic<bool> started{false};
+        std::atomic<bool> aborted{false};
+        ASSERT_OK(pool->Spawn([&]
+                              {
+            std::atomic<bool> stop{false};
+            StopRegistration registration = token.RegisterCallback([&](const Status &)
+                                                                   { stop.store(true); });
+            started.store(true);
+            while (!stop.load())
+            {
+                std::this_thread::yield();
+            }
+            aborted.store(true); }));
+        while (!started.load())
+        {
+            std::this_thread::yield();
+        }
+        source.RequestStop();
+        pool->WaitForIdle();
+        ASSERT_TRUE(aborted.load());
+    }
+
+    TEST(ThreadPool, QuickShutdownDropsKeyedTasks)
+    {
+        auto pool = MakePool(1);
+        std::vector<Future<>> futures;
+        Blocker blocker(pool.get(), 1);
+        for (int i = 0; i < 4; ++i)
+        {
+            TaskHints hints;
+            if (i % 2 == 0)
+            {
+                hints.external_id = 3;
+            }
+            else
+            {
+                hints.tenant_id = 5;
+            }
+            futures.push_back(pool->Submit(hints, [] {}));
+        }
+        // The worker only sees the shutdown once released
+        std::thread releaser([&]
+                             {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            blocker.Release(); });
+        ASSERT_OK(pool->Shutdown(/*wait=*/false));
+        releaser.join();
+        for (auto &future : futures)
+        {
+            ASSERT_TRUE(future.is_finished());
+            ASSERT_STATUS(StatusCode::Cancelled, future.status());
+        }
+    }
+
+    TEST(ThreadPool, AutoscalingGrowsOnQueueWait)
+    {
+        auto pool = MakePool(1);
+        AutoscaleOptions options;
+        options.max_threads = 3;
+        options.grow_queue_wait_us = 1000;
+        ASSERT_OK(pool->EnableAutoscaling(options));
+        ASSERT_EQ(1, pool->GetCapacity());
+        for (int i = 0; i < 50; ++i)
+        {
+            ASSERT_OK(pool->Spawn([]
+                                  { std::this_thread::sleep_for(std::chrono::milliseconds(2)); }));
+        }
+        ASSERT_TRUE(WaitUntil([&]
+                              { return pool->GetCapacity() > 1; }));
+        pool->WaitForIdle();
+        ASSERT_TRUE(pool->GetCapacity() <= 3);
+    }
+
+    TEST(ThreadPool, AutoscalingRetiresIdleWorkers)
+    {
+        auto pool = MakePool(3);
+        {
+            // Launch all the workers
+            Blocker blocker(pool.get(), 3);
+        }
+        AutoscaleOptions options;
+        options.min_threads = 1;
+        options.max_threads = 3;
+        options.idle_timeout_ms = 20;
+        ASSERT_OK(pool->EnableAutoscaling(options));
+        ASSERT_TRUE(WaitUntil([&]
+                              { return pool->GetCapacity() == 1; }));
+        // The survivor still runs tasks
+        ASSERT_EQ(1, pool->Submit([]
+                                  { return 1; })
+                         .get());
+        ASSERT_EQ(1, pool->GetCapacity());
+    }
+
+    TEST(ThreadPool, AutoscalingKeepsCompensationOnTop)
+    {
+        auto pool = MakePool(2);
+        Blocker blocker(pool.get(), 1, /*blocking=*/true);
+        AutoscaleOptions options;
+        options.min_threads = 1;
+        options.max_threads = 2;
+        options.idle_timeout_ms = 10000;
+        ASSERT_OK(pool->EnableAutoscaling(options));
+        // The worker added for the blocked one does not count against
+        // max_threads
+        ASSERT_EQ(2, pool->GetCapacity());
+        blocker.Release();
+        pool->WaitForIdle();
+        ASSERT_EQ(2, pool->GetCapacity());
+    }
+
+    TEST(ThreadPool, SetMaxQueuedTasks)
+    {
+        auto pool = MakePool(1);
+        ASSERT_EQ(0, pool->GetMaxQueuedTasks());
+        ASSERT_OK(pool->SetMaxQueuedTasks(5));
+        ASSERT_EQ(5, pool->GetMaxQueuedTasks());
+        ASSERT_OK(pool->SetMaxQueuedTasks(-1));
+        ASSERT_EQ(0, pool->GetMaxQueuedTasks());
+        pool->Shutdown();
+        ASSERT_STATUS(StatusCode::INVALID, pool->SetMaxQueuedTasks(5));
+    }
+
+    TEST(ThreadPool, BackpressureFail)
+    {
+        auto pool = MakePool(1);
+        Blocker blocker(pool.get(), 1);
+        ASSERT_OK(pool->SetMaxQueuedTasks(2, BackpressurePolicy::kFail));
+        std::atomic<int> ran{0};
+        // The capacity comes on top of the bound
+        ASSERT_OK(pool->Spawn([&]
+                              { ran.fetch_add(1); }));
+        ASSERT_OK(pool->Spawn([&]
+                              { ran.fetch_add(1); }));
+        ASSERT_STATUS(StatusCode::CapacityError, pool->Spawn([&]
+                                                             { ran.fetch_add(1); }));
+        blocker.Release();
+        pool->WaitForIdle();
+        ASSERT_EQ(2, ran.load());
+        ASSERT_OK(pool->Spawn([&]
+                              { ran.fetch_add(1); }));
+        pool->WaitForIdle();
+        ASSERT_EQ(3, ran.load());
+    }
+
+    TEST(ThreadPool, BackpressureRunInline)
+    {
+        auto pool = MakePool(1);
+        Blocker blocker(pool.get(), 1);
+        ASSERT_OK(pool->SetMaxQueuedTasks(1, BackpressurePolicy::kRunInline));
+        std::thread::id ran_on;
+        ASSERT_OK(pool->Spawn([] {}));
+        ASSERT_OK(pool->Spawn([&]
+                              { ran_on = std::this_thread::get_id(); }));
+        ASSERT_TRUE(ran_on == std::this_thread::get_id());
+    }
+
+    TEST(ThreadPool, BackpressureBlock)
+    {
+        auto pool = MakePool(1);
+        Blocker blocker(pool.get(), 1);
+        ASSERT_OK(pool->SetMaxQueuedTasks(1, BackpressurePolicy::kBlock));
+        ASSERT_OK(pool->Spawn([] {}));
+        std::atomic<bool> spawned{false};
+        std::thread submitter([&]
+                              {
+            DCHECK_OK(pool->Spawn([] {}));
+            spawned.store(true); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        ASSERT_FALSE(spawned.load());
+        blocker.Release();
+        submitter.join();
+        ASSERT_TRUE(spawned.load());
+        pool->WaitForIdle();
+    }
+
+    TEST(ThreadPool, TrySpawnOnFullPool)
+    {
+        auto pool = MakePool(1);
+        Blocker blocker(pool.get(), 1);
+        // Whatever the policy, TrySpawn() neither blocks nor runs inline
+        ASSERT_OK(pool->SetMaxQueuedTasks(1, BackpressurePolicy::kRunInline));
+        std::atomic<int> ran{0};
+        ASSERT_OK(pool->TrySpawn([&]
+                                 { ran.fetch_add(1); }));
+        ASSERT_STATUS(StatusCode::CapacityError, pool->TrySpawn([&]
+                                                                { ran.fetch_add(1); }));
+        ASSERT_OK(pool->SetMaxQueuedTasks(1, BackpressurePolicy::kBlock));
+        ASSERT_STATUS(StatusCode::CapacityError, pool->TrySpawn([&]
+                                                                { ran.fetch_add(1); }));
+        ASSERT_EQ(0, ran.load());
+        blocker.Release();
+        pool->WaitForIdle();
+        ASSERT_EQ(1, ran.load());
+    }
+
+    TEST(ThreadPool, TrySpawnForAnotherIOExecutor)
+    {
+        auto pool = MakePool(1);
+        LimitedExecutor executor(10);
+        pool->SetIOExecutor(&executor);
+        TaskHints hints;
+        hints.io_size = 0;
+        bool ran = false;
+        ASSERT_STATUS(StatusCode::CapacityError, pool->TrySpawn(hints, [&]
+                                                                { ran = true; }));
+        ASSERT_FALSE(ran);
+        ASSERT_OK(pool->Spawn(hints, [&]
+                              { ran = true; }));
+        ASSERT_TRUE(ran);
+    }
+
+    TEST(ThreadPool, MaxInFlightBytesThrottlesIOTasks)
+    {
+        auto pool = MakePool(4);
+        ASSERT_OK(pool->SetMaxInFlightBytes(100));
+        ASSERT_EQ(100, pool->GetMaxInFlightBytes());
+        std::atomic<int64_t> in_flight{0};
+        std::atomic<int64_t> max_in_flight{0};
+        std::atomic<int> ran{0};
+        const auto spawn = [&](int64_t io_size)
+        {
+            TaskHints hints;
+            hints.io_size = io_size;
+            return pool->Spawn(hints, [&, io_size]
+                               {
+                const int64_t now = in_flight.fetch_add(io_size) + io_size;
+                int64_t seen = max_in_flight.load();
+                while (now > seen && !max_in_flight.compare_exchange_weak(seen, now))
+                {
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                in_flight.fetch_sub(io_size);
+                ran.fetch_add(1); });
+        };
+        for (int i = 0; i < 8; ++i)
+        {
+            ASSERT_OK(spawn(40));
+        }
+        pool->WaitForIdle();
+        ASSERT_EQ(8, ran.load());
+        // Two 40-byte tasks fit in the budget, a third does not
+        ASSERT_EQ(80, max_in_flight.load());
+
+        // A task larger than the limit runs alone
+        max_in_flight = 0;
+        ASSERT_OK(spawn(40));
+        ASSERT_OK(spawn(500));
+        ASSERT_OK(spawn(40));
+        pool->WaitForIdle();
+        ASSERT_EQ(11, ran.load());
+        ASSERT_EQ(500, max_in_flight.load());
+
+        // Lifting the limit admits everything
+        ASSERT_OK(pool->SetMaxInFlightBytes(-1));
+        ASSERT_EQ(0, pool->GetMaxInFlightBytes());
+        max_in_flight = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            ASSERT_OK(spawn(40));
+        }
+        pool->WaitForIdle();
+        ASSERT_EQ(15, ran.load());
+    }
+
+    TEST(ThreadPool, BlockedWorkersAreCompensated)
+    {
+        auto pool = MakePool(2);
+        ASSERT_OK(pool->SetMaxCompensationThreads(2));
+        Blocker blocked(pool.get(), 2, /*blocking=*/true);
+        ASSERT_EQ(2, pool->GetMetrics().num_blocked_workers);
+        // New tasks still run, on workers added for the blocked ones
+        ASSERT_EQ(42, pool->Submit([]
+                                   { return 42; })
+                          .get());
+        ASSERT_EQ(2, pool->GetCapacity());
+        blocked.Release();
+        pool->WaitForIdle();
+        ASSERT_EQ(0, pool->GetMetrics().num_blocked_workers);
+    }
+
+    TEST(ThreadPool, CompensationIsCapped)
+    {
+        auto pool = MakePool(2);
+        ASSERT_STATUS(StatusCode::INVALID, pool->SetMaxCompensationThreads(-1));
+        ASSERT_OK(pool->SetMaxCompensationThreads(1));
+        Blocker blocked(pool.get(), 2, /*blocking=*/true);
+        // Takes the only compensating worker
+        Blocker busy(pool.get(), 1);
+        std::atomic<bool> ran{false};
+        ASSERT_OK(pool->Spawn([&]
+                              { ran.store(true); }));
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        ASSERT_FALSE(ran.load());
+        ASSERT_EQ(3, pool->GetMetrics().num_workers);
+        busy.Release();
+        ASSERT_TRUE(WaitUntil([&]
+                              { return ran.load(); }));
+        blocked.Release();
+        pool->WaitForIdle();
+    }
+
+    TEST(ThreadPool, TraceBeginsAndEndsBalance)
+    {
+        auto pool = MakePool(3);
+        ASSERT_OK(pool->EnableTracing(1 << 12));
+        {
+            Blocker blocker(pool.get(), 3);
+        }
+        for (int i = 0; i < 100; ++i)
+        {
+            ASSERT_OK(pool->Spawn([] {}));
+        }
+        pool->WaitForIdle();
+        // Retired workers close their park too
+        AutoscaleOptions options;
+        options.idle_timeout_ms = 10;
+        options.max_threads = 3;
+        ASSERT_OK(pool->EnableAutoscaling(options));
+        ASSERT_TRUE(WaitUntil([&]
+                              { return pool->GetCapacity() == 1; }));
+        // Wakes up the survivor
+        pool->Shutdown();
+        const std::string trace = pool->ExportTrace();
+        std::map<int, int> open;
+        size_t pos = 0;
+        while ((pos = trace.find("\"ph\":\"", pos)) != std::string::npos)
+        {
+            const char phase = trace[pos + 6];
+            const size_t tid = trace.find("\"tid\":", pos);
+            pos = tid;
+            if (phase == 'B' || phase == 'E')
+            {
+                int &depth = open[std::atoi(trace.c_str() + tid + 6)];
+                depth += phase == 'B' ? 1 : -1;
+                ASSERT_TRUE(depth >= 0);
+            }
+        }
+        ASSERT_TRUE(open.size() >= 3);
+        for (const auto &entry : open)
+        {
+            ASSERT_EQ(0, entry.second);
+        }
+    }
+
+    TEST(ThreadPool, ScratchIsReclaimedBetweenTasks)
+    {
+        auto pool = MakePool(1);
+        ASSERT_TRUE(ThreadPool::AllocateScratch(16) == nullptr);
+        std::vector<void *> scratch(3);
+        for (int i = 0; i < 3; ++i)
+        {
+            ASSERT_OK(pool->Spawn([&scratch, i]
+                                  { scratch[i] = ThreadPool::AllocateScratch(1000, 64); }));
+        }
+        pool->WaitForIdle();
+        ASSERT_TRUE(scratch[0] != nullptr);
+        ASSERT_TRUE(scratch[0] == scratch[1]);
+        ASSERT_TRUE(scratch[1] == scratch[2]);
+        ASSERT_EQ(0u, reinterpret_cast<uintptr_t>(scratch[0]) % 64);
+    }
+
+    // Busy-waits for `micros`, as a task using the CPU
+    void Spin(int micros)
+    {
+        const auto end = Clock::now() + std::chrono::microseconds(micros);
+        while (Clock::now() < end)
+        {
+        }
+    }
+
+    TEST(ThreadPool, TenantWeightsShareThroughput)
+    {
+        auto pool = MakePool(1);
+        TenantOptions light;
+        light.weight = 1;
+        TenantOptions heavy;
+        heavy.weight = 3;
+        ASSERT_OK(pool->SetTenantOptions(1, light));
+        ASSERT_OK(pool->SetTenantOptions(2, heavy));
+        std::atomic<int> ran[3] = {};
+        std::atomic<bool> stop{false};
+        {
+            // Queue both backlogs before any of them runs
+            Blocker blocker(pool.get(), 1);
+            for (int i = 0; i < 5000; ++i)
+            {
+                for (int64_t tenant : {1, 2})
+                {
+                    TaskHints hints;
+                    hints.tenant_id = tenant;
+                    ASSERT_OK(pool->Spawn(hints, [&, tenant]
+                                          {
+                        if (!stop.load())
+                        {
+                            Spin(50);
+                            ran[tenant].fetch_add(1);
+                        } }));
+                }
+            }
+        }
+        // Both tenants stay backlogged until then; measure over many quanta
+        // so that preemptions on a loaded machine average out
+        ASSERT_TRUE(WaitUntil([&]
+                              { return ran[1].load() + ran[2].load() >= 4000; }));
+        const double ratio = static_cast<double>(ran[2].load()) / std::max(1, ran[1].load());
+        stop.store(true);
+        pool->WaitForIdle();
+        ASSERT_TRUE(ratio > 2.0 && ratio < 4.5);
+    }
+
+    TEST(ThreadPool, SaturatingTenantDoesNotStarveOthers)
+    {
+        auto pool = MakePool(1);
+        std::atomic<int> busy_ran{0};
+        std::atomic<int> busy_ran_before_other{-1};
+        for (int i = 0; i < 500; ++i)
+        {
+            TaskHints hints;
+            hints.tenant_id = 1;
+            ASSERT_OK(pool->Spawn(hints, [&]
+                                  {
+                Spin(200);
+                busy_ran.fetch_add(1); }));
+        }
+        ASSERT_TRUE(WaitUntil([&]
+                              { return busy_ran.load() >= 10; }));
+        TaskHints hints;
+        hints.tenant_id = 2;
+        ASSERT_OK(pool->Spawn(hints, [&]
+                              { busy_ran_before_other.store(busy_ran.load()); }));
+        pool->WaitForIdle();
+        ASSERT_EQ(500, busy_ran.load());
+        // The newcomer waited about a turn of the busy tenant, not its backlog
+        ASSERT_TRUE(busy_ran_before_other.load() >= 10 && busy_ran_before_other.load() < 100);
+    }
+
+    TEST(LatencyHistogram, BucketBoundaries)
+    {
+        ASSERT_EQ(0, LatencyHistogram::BucketFor(-5));
+        ASSERT_EQ(0, LatencyHistogram::BucketFor(0));
+        ASSERT_EQ(0, LatencyHistogram::BucketFor(1));
+        ASSERT_EQ(1, LatencyHistogram::BucketFor(2));
+        ASSERT_EQ(1, LatencyHistogram::BucketFor(3));
+        ASSERT_EQ(2, LatencyHistogram::BucketFor(4));
+        ASSERT_EQ(9, LatencyHistogram::BucketFor(1023));
+        ASSERT_EQ(10, LatencyHistogram::BucketFor(1024));
+        const int last = LatencyHistogram::kNumBuckets - 1;
+        ASSERT_EQ(last - 1, LatencyHistogram::BucketFor((int64_t{1} << last) - 1));
+        ASSERT_EQ(last, LatencyHistogram::BucketFor(int64_t{1} << last));
+        ASSERT_EQ(last, LatencyHistogram::BucketFor(std::numeric_limits<int64_t>::max()));
+    }
+
+    TEST(LatencyHistogram, CountAndQuantiles)
+    {
+        LatencyHistogram histogram;
+        ASSERT_EQ(0, histogram.Count());
+        ASSERT_EQ(0, histogram.Quantile(0.5));
+        // 90 samples in [1024, 2048), 10 in [2^20, 2^21)
+        histogram.buckets[LatencyHistogram::BucketFor(1500)] += 90;
+        histogram.buckets[LatencyHistogram::BucketFor(1500000)] += 10;
+        ASSERT_EQ(100, histogram.Count());
+        // Quantiles are the upper bound of their bucket
+        ASSERT_EQ(2048, histogram.Quantile(0.0));
+        ASSERT_EQ(2048, histogram.Quantile(0.5));
+        ASSERT_EQ(2048, histogram.Quantile(0.9));
+        ASSERT_EQ(int64_t{1} << 21, histogram.Quantile(0.95));
+        ASSERT_EQ(int64_t{1} << 21, histogram.Quantile(1.0));
+    }
+
+    TEST(WorkerCounters, Add)
+    {
+        WorkerCounters a;
+        a.tasks_executed = 1;
+        a.tasks_cancelled = 2;
+        a.tasks_stolen = 3;
+        a.tasks_inlined = 4;
+        a.parks = 5;
+        a.wakeups = 6;
+        a.busy_nanos = 7;
+        a.idle_nanos = 8;
+        WorkerCounters b = a;
+        b += a;
+        ASSERT_EQ(2, b.tasks_executed);
+        ASSERT_EQ(4, b.tasks_cancelled);
+        ASSERT_EQ(6, b.tasks_stolen);
+        ASSERT_EQ(8, b.tasks_inlined);
+        ASSERT_EQ(10, b.parks);
+        ASSERT_EQ(12, b.wakeups);
+        ASSERT_EQ(14, b.busy_nanos);
+        ASSERT_EQ(16, b.idle_nanos);
+    }
+
+    TEST(ThreadPool, MetricsAfterAKnownWorkload)
+    {
+        auto pool = MakePool(2);
+        for (int i = 0; i < 100; ++i)
+        {
+            ASSERT_OK(pool->Spawn([]
+                                  { Spin(100); }));
+        }
+        pool->WaitForIdle();
+        StopSource source;
+        {
+            Blocker blocker(pool.get(), 2);
+            for (int i = 0; i < 10; ++i)
+            {
+                ASSERT_OK(pool->Spawn([] {}, source.token()));
+            }
+            source.RequestStop();
+        }
+        pool->WaitForIdle();
+        const ThreadPoolMetrics metrics = pool->GetMetrics();
+        // The blockers ran too
+        ASSERT_EQ(102, metrics.total.tasks_executed);
+        ASSERT_EQ(10, metrics.total.tasks_cancelled);
+        ASSERT_EQ(102, metrics.run_time.Count());
+        ASSERT_EQ(102, metrics.queue_wait.Count());
+        // The spinning tasks ran for 100us or more, in buckets ending at
+        // 2^17ns or later
+        ASSERT_TRUE(metrics.run_time.Quantile(0.5) >= (int64_t{1} << 17));
+        ASSERT_TRUE(metrics.total.busy_nanos >= 100 * 100000);
+        ASSERT_EQ(2u, metrics.per_worker.size());
+        WorkerCounters sum;
+        for (const WorkerCounters &counters : metrics.per_worker)
+        {
+            sum += counters;
+        }
+        ASSERT_EQ(metrics.total.tasks_executed, sum.tasks_executed);
+        ASSERT_EQ(metrics.total.busy_nanos, sum.busy_nanos);
+        ASSERT_EQ(0, metrics.num_queued_tasks);
+        ASSERT_EQ(2, metrics.num_workers);
+        ASSERT_EQ(0, metrics.num_blocked_workers);
+        ASSERT_TRUE(metrics.tenants.empty());
+    }
+
+    TEST(ThreadPool, InvalidAffinityIsRejected)
+    {
+        auto pool = MakePool(2);
+        ASSERT_STATUS(StatusCode::INVALID, pool->SetAffinity(ThreadAffinity::kExplicit));
+        ASSERT_STATUS(StatusCode::INVALID, pool->SetAffinity(ThreadAffinity::kExplicit, {-1}));
+        const std::vector<int> allowed = internal::GetAllowedCpus();
+        ASSERT_STATUS(StatusCode::INVALID,
+                      pool->SetAffinity(ThreadAffinity::kExplicit, {allowed.back() + 1}));
+        ASSERT_STATUS(StatusCode::INVALID,
+                      pool->SetAffinity(ThreadAffinity::kExplicit, {allowed.front(), 1 << 20}));
+    }
+
+    TEST(ThreadPool, PinnedWorkersRunTasks)
+    {
+        auto pool = MakePool(2);
+        const std::vector<int> allowed = internal::GetAllowedCpus();
+        for (ThreadAffinity affinity : {ThreadAffinity::kCompact, ThreadAffinity::kScatter,
+                                        ThreadAffinity::kNone})
+        {
+            ASSERT_OK(pool->SetAffinity(affinity));
+            ASSERT_EQ(1, pool->Submit([]
+                                      { return 1; })
+                             .get());
+        }
+        const int cpu = allowed.back();
+        ASSERT_OK(pool->SetAffinity(ThreadAffinity::kExplicit, {cpu}));
+        std::atomic<int> ran_on{-2};
+        // Workers re-pin themselves before their next task
+        ASSERT_OK(pool->Spawn([&]
+                              {
+#ifdef __linux__
+            ran_on.store(sched_getcpu());
+#else
+            ran_on.store(cpu);
+#endif
+        }));
+        pool->WaitForIdle();
+        ASSERT_EQ(cpu, ran_on.load());
+    }
+
+    TEST(ThreadPool, InvalidParkingOptionsAreRejected)
+    {
+        auto pool = MakePool(2);
+        ASSERT_STATUS(StatusCode::INVALID, pool->SetParkingOptions(ParkingOptions{-1, 8}));
+        ASSERT_STATUS(StatusCode::INVALID, pool->SetParkingOptions(ParkingOptions{64, -1}));
+        ASSERT_OK(pool->SetParkingOptions(ParkingOptions{16, 2}));
+        const ParkingOptions options = pool->GetParkingOptions();
+        ASSERT_EQ(16, options.spin_rounds);
+        ASSERT_EQ(2, options.yield_rounds);
+    }
+
+    TEST(ThreadPool, ParkedPoolWakesForAnExternalSpawn)
+    {
+        auto pool = MakePool(2);
+        for (ParkingOptions options : {ParkingOptions{0, 0}, ParkingOptions{64, 8}})
+        {
+            ASSERT_OK(pool->SetParkingOptions(options));
+            ASSERT_OK(pool->Spawn([] {}));
+            pool->WaitForIdle();
+            ASSERT_TRUE(WaitUntil([&]
+                                  {
+                auto metrics = pool->GetMetrics();
+                return metrics.num_workers > 0 && metrics.num_parked_workers == metrics.num_workers; }));
+            const int64_t wakeups = pool->GetMetrics().total.wakeups;
+            auto future = pool->Submit([]
+                                       { return 42; });
+            ASSERT_EQ(42, future.get());
+            ASSERT_TRUE(pool->GetMetrics().total.wakeups > wakeups);
+        }
+    }
+
+    TEST(TaskGroup, FirstErrorCancelsTheGroup)
+    {
+        auto pool = MakePool(2);
+        TaskGroup group(pool.get());
+        std::atomic<int> ran{0};
+        ASSERT_OK(group.Spawn([]
+                              { return Status::Invalid("first"); }));
+        for (int i = 0; i < 100; ++i)
+        {
+            Status status = group.Spawn([&]
+                                        { ran.fetch_add(1); });
+            // Once cancelled, spawning fails with the group's error
+            ASSERT_TRUE(status.ok() || status.code() == StatusCode::INVALID);
+        }
+        ASSERT_STATUS(StatusCode::INVALID, group.Wait());
+        ASSERT_TRUE(group.IsCancelled());
+        ASSERT_TRUE(ran.load() <= 100);
+    }
+
+    TEST(TaskGroup, StopCallbacksMayUseTheGroup)
+    {
+        auto pool = MakePool(2);
+        TaskGroup group(pool.get());
+        TaskGroup child(&group);
+        std::atomic<int> callbacks{0};
+        // Both callbacks run on the cancelling thread and take the groups' locks
+        StopRegistration group_stop = group.stop_token().RegisterCallback([&](const Status &)
+                                                                           {
+            ASSERT_STATUS(StatusCode::Cancelled, group.Spawn([] {}));
+            callbacks.fetch_add(1); });
+        StopRegistration child_stop = child.stop_token().RegisterCallback([&](const Status &)
+                                                                           {
+            ASSERT_STATUS(StatusCode::Cancelled, child.Spawn([] {}));
+            callbacks.fetch_add(1); });
+        group.Cancel();
+        ASSERT_EQ(2, callbacks.load());
+        ASSERT_TRUE(child.IsCancelled());
+        ASSERT_STATUS(StatusCode::Cancelled, child.Wait());
+    }
+}
+
+int main() { return arrow::testing::RunAllTests(); }
@@ -0,0 +1,164 @@
+#include "timer_wheel.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace arrow
+{
+    namespace internal
+    {
+        void TimerWheel::Insert(Node *node)
+        {
+            node->tick = std::max(node->tick, current_ + 1);
+            Place(node);
+            ++size_;
+        }
+
+        void TimerWheel::Remove(Node *node)
+        {
+            if (node->slot < 0)
+            {
+                return;
+            }
+            Unlink(node);
+            --size_;
+        }
+
+        void TimerWheel::Advance(int64_t now_tick, std::vector<Node *> *expired)
+        {
+            while (current_ < now_tick)
+            {
+                const int64_t next = NextEventTick();
+                if (next > now_tick)
+                {
+                    current_ = now_tick;
+                    return;
+                }
+                current_ = next;
+                // Move down the nodes of the levels whose slot starts at this
+                // tick, then expire the level 0 slot
+                for (int level = 1; level < kLevels; ++level)
+                {
+                    const int shift = kSlotBits * level;
+                    if ((current_ & ((int64_t{1} << shift) - 1)) != 0)
+                    {
+                        break;
+                    }
+                    Node *node = TakeSlot(level * kSlots + ((current_ >> shift) & (kSlots - 1)));
+                    while (node != nullptr)
+                    {
+                        Node *next_node = node->next;
+                        Place(node);
+                        node = next_node;
+                    }
+                }
+                Node *node = TakeSlot(current_ & (kSlots - 1));
+                while (node != nullptr)
+                {
+                    Node *next_node = node->next;
+                    node->prev = node->next = nullptr;
+                    node->slot = -1;
+                    --size_;
+                    expired->push_back(node);
+                    node = next_node;
+                }
+            }
+        }
+
+        void TimerWheel::Clear(std::vector<Node *> *out)
+        {
+            for (int slot = 0; slot < kLevels * kSlots; ++slot)
+            {
+                Node *node = TakeSlot(slot);
+                while (node != nullptr)
+                {
+                    Node *next_node = node->next;
+                    node->prev = node->next = nullptr;
+                    node->slot = -1;
+                    out->push_back(node);
+                    node = next_node;
+                }
+            }
+            size_ = 0;
+        }
+
+        int64_t TimerWheel::NextEventTick() const
+        {
+            int64_t next = std::numeric_limits<int64_t>::max();
+            for (int level = 0; level < kLevels; ++level)
+            {
+                const uint64_t bits = occupied_[level];
+                if (bits == 0)
+                {
+                    continue;
+                }
+                // The slots come around in order starting after the current one
+                const int shift = kSlotBits * level;
+                const int64_t base = current_ >> shift;
+                const int from = static_cast<int>((base + 1) & (kSlots - 1));
+                const uint64_t rotated = from == 0 ? bits : (bits >> from) | (bits << (kSlots - from));
+                const int64_t ahead = __builtin_ctzll(rotated) + 1;
+                next = std::min(next, (base + ahead) << shift);
+            }
+            return next;
+        }
+
+        void TimerWheel::Place(Node *node)
+        {
+            // Nodes beyond the span of the top level wait in its farthest slot
+            const int64_t span = int64_t{1} << (kSlotBits * kLevels);
+            const int64_t tick = std::min(node->tick, current_ + span - 1);
+            const int64_t distance = tick - current_;
+            int level = 0;
+            while (level < kLevels - 1 && distance >= (int64_t{1} << (kSlotBits * (level + 1))))
+            {
+                ++level;
+            }
+            Link(node, level * kSlots + ((tick >> (kSlotBits * level)) & (kSlots - 1)));
+        }
+
+        void TimerWheel::Link(Node *node, int slot)
+        {
+            node->slot = slot;
+            node->prev = nullptr;
+            node->next = heads_[slot];
+            if (node->next != nullptr)
+            {
+                node->next->prev = node;
+            }
+            heads_[slot] = node;
+            occupied_[slot / kSlots] |= uint64_t{1} << (slot % kSlots);
+        }
+
+        void TimerWheel::Unlink(Node *node)
+        {
+            const int slot = node->slot;
+            if (node->prev != nullptr)
+            {
+                node->prev->next = node->next;
+            }
+            else
+            {
+                heads_[slot] = node->next;
+            }
+            if (node->next != nullptr)
+            {
+                node->next->prev = node->prev;
+            }
+            if (heads_[slot] == nullptr)
+            {
+                occupied_[slot / kSlots] &= ~(uint64_t{1} << (slot % kSlots));
+            }
+            node->prev = node->next = nullptr;
+            node->slot = -1;
+        }
+
+        TimerWheel::Node *TimerWheel::TakeSlot(int slot)
+        {
+            Node *head = heads_[slot];
+            heads_[slot] = nullptr;
+            occupied_[slot / kSlots] &= ~(uint64_t{1} << (slot % kSlots));
+            return head;
+        }
+    }
+}
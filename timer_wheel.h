@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "visibility.h"
+
+namespace arrow
+{
+    namespace internal
+    {
+        // Hierarchical timing wheel. Level l has kSlots slots of 64^l ticks
+        // each; a timer goes to the lowest level whose span covers its
+        // distance to the current tick and moves down a level each time its
+        // slot comes around, until it expires from level 0. Insert and Remove
+        // are O(1), and Advance() jumps over empty stretches using per-level
+        // occupancy bitmaps. Not thread-safe.
+        class ARROW_EXPORT TimerWheel
+        {
+        public:
+            // Intrusive list node, embedded in the caller's timer objects
+            struct Node
+            {
+                // Tick at which the timer is due
+                int64_t tick = 0;
+                Node *prev = nullptr;
+                Node *next = nullptr;
+                // Slot the node is linked in, -1 if none
+                int slot = -1;
+            };
+
+            static constexpr int kSlotBits = 6;
+            static constexpr int kSlots = 1 << kSlotBits;
+            static constexpr int kLevels = 4;
+
+            explicit TimerWheel(int64_t now_tick = 0) : current_(now_tick) {}
+
+            TimerWheel(const TimerWheel &) = delete;
+            TimerWheel &operator=(const TimerWheel &) = delete;
+
+            // A node due at or before the current tick expires on the next one
+            void Insert(Node *node);
+            // Does nothing if the node is not in the wheel
+            void Remove(Node *node);
+            // Move to now_tick, appending the nodes that are due by then to
+            // *expired in tick order
+            void Advance(int64_t now_tick, std::vector<Node *> *expired);
+            // Remove all nodes, appending them to *out
+            void Clear(std::vector<Node *> *out);
+            // First tick at which Advance() has something to do (expire or
+            // move nodes down a level), INT64_MAX if the wheel is empty
+            int64_t NextEventTick() const;
+
+            bool empty() const { return size_ == 0; }
+            size_t size() const { return size_; }
+            int64_t current_tick() const { return current_; }
+
+        private:
+            // Link the node in the slot matching its tick
+            void Place(Node *node);
+            void Link(Node *node, int slot);
+            void Unlink(Node *node);
+            // Unlink the whole list of a slot and return its head
+            Node *TakeSlot(int slot);
+
+            int64_t current_;
+            size_t size_ = 0;
+            Node *heads_[kLevels * kSlots] = {};
+            uint64_t occupied_[kLevels] = {};
+        };
+    }
+}
@@ -0,0 +1,86 @@
+#include "tracing.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace arrow
+{
+    namespace internal
+    {
+        std::string ExportChromeTrace(const std::vector<std::pair<int, const TraceBuffer *>> &threads,
+                                      uint64_t base_ticks, double ticks_per_us)
+        {
+            std::string out = "{\"traceEvents\":[";
+            bool first = true;
+            char buf[320];
+            const auto append = [&](int n)
+            {
+                out += first ? "\n" : ",\n";
+                out.append(buf, std::min<size_t>(n, sizeof(buf) - 1));
+                first = false;
+            };
+            for (const auto &entry : threads)
+            {
+                const int tid = entry.first;
+                const std::string name = tid == 0 ? "outside threads" : "worker " + std::to_string(tid - 1);
+                append(snprintf(buf, sizeof(buf),
+                                "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                                "\"args\":{\"name\":\"%s\"}}",
+                                tid, name.c_str()));
+                for (const TraceEvent &event : entry.second->Snapshot())
+                {
+                    const double ts =
+                        static_cast<int64_t>(event.ticks - base_ticks) / ticks_per_us;
+                    const unsigned long long id = event.task;
+                    switch (event.type)
+                    {
+                    case TraceEvent::kEnqueue:
+                        append(snprintf(buf, sizeof(buf),
+                                        "{\"name\":\"enqueue\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,"
+                                        "\"pid\":1,\"tid\":%d,\"args\":{\"task\":\"0x%llx\",\"priority\":%d,"
+                                        "\"band\":%d,\"external_id\":%lld,\"tenant_id\":%lld}}",
+                                        ts, tid, id, event.priority, event.band,
+                                        static_cast<long long>(event.external_id),
+                                        static_cast<long long>(event.tenant_id)));
+                        append(snprintf(buf, sizeof(buf),
+                                        "{\"name\":\"task\",\"cat\":\"task\",\"ph\":\"s\",\"id\":\"0x%llx\","
+                                        "\"ts\":%.3f,\"pid\":1,\"tid\":%d}",
+                                        id, ts, tid));
+                        break;
+                    case TraceEvent::kStart:
+                        append(snprintf(buf, sizeof(buf),
+                                        "{\"name\":\"%s\",\"ph\":\"B\",\"ts\":%.3f,\"pid\":1,\"tid\":%d,"
+                                        "\"args\":{\"task\":\"0x%llx\",\"band\":%d}}",
+                                        id != 0 ? "task" : "inline task", ts, tid, id, event.band));
+                        if (id != 0)
+                        {
+                            append(snprintf(buf, sizeof(buf),
+                                            "{\"name\":\"task\",\"cat\":\"task\",\"ph\":\"f\",\"bp\":\"e\","
+                                            "\"id\":\"0x%llx\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}",
+                                            id, ts, tid));
+                        }
+                        break;
+                    case TraceEvent::kEnd:
+                    case TraceEvent::kWake:
+                        append(snprintf(buf, sizeof(buf),
+                                        "{\"ph\":\"E\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}", ts, tid));
+                        break;
+                    case TraceEvent::kPark:
+                        append(snprintf(buf, sizeof(buf),
+                                        "{\"name\":\"parked\",\"ph\":\"B\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}",
+                                        ts, tid));
+                        break;
+                    case TraceEvent::kSteal:
+                    case TraceEvent::kCancel:
+                        append(snprintf(buf, sizeof(buf),
+                                        "{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,"
+                                        "\"tid\":%d,\"args\":{\"task\":\"0x%llx\"}}",
+                                        event.type == TraceEvent::kSteal ? "steal" : "cancel", ts, tid, id));
+                        break;
+                    }
+                }
+            }
+            return out + "\n],\"displayTimeUnit\":\"ns\"}\n";
+        }
+    }
+}
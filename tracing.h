@@ -0,0 +1,114 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "visibility.h"
+
+namespace arrow
+{
+    namespace internal
+    {
+        // Timestamp of trace events: the TSC where there is one, as it is
+        // cheaper to read than the steady clock, else steady clock nanoseconds
+        inline uint64_t TraceTicks()
+        {
+#if defined(__x86_64__) || defined(__i386__)
+            return __rdtsc();
+#else
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                             std::chrono::steady_clock::now().time_since_epoch())
+                                             .count());
+#endif
+        }
+
+        // See ThreadPool::EnableTracing()
+        struct TraceEvent
+        {
+            enum Type : uint8_t
+            {
+                kEnqueue,
+                kStart,
+                kEnd,
+                kSteal,
+                kPark,
+                kWake,
+                kCancel,
+            };
+
+            uint64_t ticks;
+            // Address of the task, pairing its enqueue, start and end; 0 for
+            // tasks run inline and for parks
+            uintptr_t task;
+            // Hints of enqueued tasks
+            int64_t external_id;
+            int64_t tenant_id;
+            int32_t priority;
+            // Priority band, -1 if unknown
+            int8_t band;
+            Type type;
+        };
+
+        // The last events of one thread, or of all outside threads. Writers
+        // never wait and overwrite the oldest events; a snapshot taken
+        // meanwhile may see some of them torn.
+        class TraceBuffer
+        {
+        public:
+            // capacity is a power of 2
+            explicit TraceBuffer(size_t capacity)
+                : events_(new TraceEvent[capacity]), mask_(capacity - 1) {}
+
+            // Single writer
+            void Record(const TraceEvent &event)
+            {
+                const uint64_t i = next_.load(std::memory_order_relaxed);
+                events_[i & mask_] = event;
+                next_.store(i + 1, std::memory_order_release);
+            }
+
+            // Any number of writers
+            void RecordShared(const TraceEvent &event)
+            {
+                const uint64_t i = next_.fetch_add(1, std::memory_order_acq_rel);
+                events_[i & mask_] = event;
+            }
+
+            // Oldest first
+            std::vector<TraceEvent> Snapshot() const
+            {
+                const uint64_t end = next_.load(std::memory_order_acquire);
+                const uint64_t begin = end > mask_ ? end - mask_ - 1 : 0;
+                std::vector<TraceEvent> events;
+                events.reserve(end - begin);
+                for (uint64_t i = begin; i < end; ++i)
+                {
+                    events.push_back(events_[i & mask_]);
+                }
+                return events;
+            }
+
+        private:
+            std::unique_ptr<TraceEvent[]> events_;
+            const uint64_t mask_;
+            std::atomic<uint64_t> next_{0};
+        };
+
+        // The events of each thread as Chrome trace JSON, threads given by
+        // their id (0 for the outside threads) and ring. Timestamps are in
+        // microseconds since base_ticks.
+        ARROW_EXPORT std::string ExportChromeTrace(
+            const std::vector<std::pair<int, const TraceBuffer *>> &threads, uint64_t base_ticks,
+            double ticks_per_us);
+    }
+}
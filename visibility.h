@@ -1,4 +1,4 @@
 #pragma once
 #ifndef ARROW_EXPORT
 #define ARROW_EXPORT __attribute__((visibility("default")))
-#endif
\ No newline at end of file
+#endif
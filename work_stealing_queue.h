@@ -0,0 +1,141 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace arrow
+{
+    namespace internal
+    {
+        // A Chase-Lev work-stealing deque of T* (see "Correct and Efficient
+        // Work-Stealing for Weak Memory Models", Le et al., PPoPP 2013).
+        //
+        // The owning thread pushes and pops at the bottom (LIFO), any other
+        // thread may steal from the top (FIFO). Push() and Pop() must only be
+        // called from the owner; Steal() and Size() are safe from any thread.
+        template <typename T>
+        class WorkStealingQueue
+        {
+        public:
+            explicit WorkStealingQueue(int64_t capacity = 256)
+                : array_(new Array(capacity))
+            {
+            }
+
+            ~WorkStealingQueue()
+            {
+                delete array_.load(std::memory_order_relaxed);
+            }
+
+            WorkStealingQueue(const WorkStealingQueue &) = delete;
+            WorkStealingQueue &operator=(const WorkStealingQueue &) = delete;
+
+            void Push(T *item)
+            {
+                int64_t b = bottom_.load(std::memory_order_relaxed);
+                int64_t t = top_.load(std::memory_order_acquire);
+                Array *a = array_.load(std::memory_order_relaxed);
+                if (b - t > a->capacity - 1)
+                {
+                    a = Grow(a, b, t);
+                }
+                a->Put(b, item);
+                bottom_.store(b + 1, std::memory_order_release);
+            }
+
+            T *Pop()
+            {
+                int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+                Array *a = array_.load(std::memory_order_relaxed);
+                bottom_.store(b, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                int64_t t = top_.load(std::memory_order_relaxed);
+                if (t > b)
+                {
+                    // Empty
+                    bottom_.store(b + 1, std::memory_order_relaxed);
+                    return nullptr;
+                }
+                T *item = a->Get(b);
+                if (t == b)
+                {
+                    // Last item: race against thieves
+                    if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                      std::memory_order_relaxed))
+                    {
+                        item = nullptr;
+                    }
+                    bottom_.store(b + 1, std::memory_order_relaxed);
+                }
+                return item;
+            }
+
+            T *Steal()
+            {
+                int64_t t = top_.load(std::memory_order_acquire);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                int64_t b = bottom_.load(std::memory_order_acquire);
+                if (t >= b)
+                {
+                    return nullptr;
+                }
+                Array *a = array_.load(std::memory_order_acquire);
+                T *item = a->Get(t);
+                if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                  std::memory_order_relaxed))
+                {
+                    // Lost the race against the owner or another thief
+                    return nullptr;
+                }
+                return item;
+            }
+
+            // Approximate number of queued items
+            int64_t Size() const
+            {
+                int64_t b = bottom_.load(std::memory_order_relaxed);
+                int64_t t = top_.load(std::memory_order_relaxed);
+                return b > t ? b - t : 0;
+            }
+
+            bool Empty() const { return Size() == 0; }
+
+        private:
+            struct Array
+            {
+                explicit Array(int64_t cap)
+                    : capacity(cap), mask(cap - 1), items(new std::atomic<T *>[cap])
+                {
+                }
+
+                T *Get(int64_t i) const { return items[i & mask].load(std::memory_order_relaxed); }
+                void Put(int64_t i, T *item) { items[i & mask].store(item, std::memory_order_relaxed); }
+
+                const int64_t capacity;
+                const int64_t mask;
+                std::unique_ptr<std::atomic<T *>[]> items;
+            };
+
+            Array *Grow(Array *a, int64_t b, int64_t t)
+            {
+                Array *bigger = new Array(a->capacity * 2);
+                for (int64_t i = t; i < b; ++i)
+                {
+                    bigger->Put(i, a->Get(i));
+                }
+                // Thieves may still be reading from the old array, keep it alive
+                // until the queue is destroyed.
+                retired_.emplace_back(a);
+                array_.store(bigger, std::memory_order_release);
+                return bigger;
+            }
+
+            alignas(64) std::atomic<int64_t> top_{0};
+            alignas(64) std::atomic<int64_t> bottom_{0};
+            std::atomic<Array *> array_;
+            std::vector<std::unique_ptr<Array>> retired_;
+        };
+    }
+}
@@ -0,0 +1,149 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "mpmc_queue.h"
+#include "test_util.h"
+#include "work_stealing_queue.h"
+
+namespace arrow
+{
+    namespace internal
+    {
+        TEST(WorkStealingQueue, OwnerIsLifoThievesAreFifo)
+        {
+            WorkStealingQueue<int> queue(4);
+            std::vector<int> items(10);
+            for (int i = 0; i < 10; ++i)
+            {
+                items[i] = i;
+                queue.Push(&items[i]);
+            }
+            ASSERT_EQ(10, queue.Size());
+            ASSERT_EQ(0, *queue.Steal());
+            ASSERT_EQ(1, *queue.Steal());
+            ASSERT_EQ(9, *queue.Pop());
+            ASSERT_EQ(8, *queue.Pop());
+            ASSERT_EQ(6, queue.Size());
+            for (int i = 7; i >= 2; --i)
+            {
+                ASSERT_EQ(i, *queue.Pop());
+            }
+            ASSERT_TRUE(queue.Pop() == nullptr);
+            ASSERT_TRUE(queue.Steal() == nullptr);
+        }
+
+        // Every item is taken exactly once while the owner pushes and pops,
+        // growing the array, and thieves steal concurrently
+        TEST(WorkStealingQueue, StealRace)
+        {
+            constexpr int kItems = 200000;
+            constexpr int kThieves = 3;
+            WorkStealingQueue<int> queue(2);
+            std::vector<int> items(kItems);
+            std::vector<std::atomic<int>> taken(kItems);
+            std::atomic<bool> done{false};
+            std::vector<std::thread> thieves;
+            for (int t = 0; t < kThieves; ++t)
+            {
+                thieves.emplace_back([&]
+                                     {
+                    while (!done.load())
+                    {
+                        if (int *item = queue.Steal())
+                        {
+                            taken[*item].fetch_add(1);
+                        }
+                    } });
+            }
+            for (int i = 0; i < kItems; ++i)
+            {
+                items[i] = i;
+                queue.Push(&items[i]);
+                if (i % 3 == 0)
+                {
+                    if (int *item = queue.Pop())
+                    {
+                        taken[*item].fetch_add(1);
+                    }
+                }
+            }
+            while (int *item = queue.Pop())
+            {
+                taken[*item].fetch_add(1);
+            }
+            done.store(true);
+            for (auto &thief : thieves)
+            {
+                thief.join();
+            }
+            for (int i = 0; i < kItems; ++i)
+            {
+                ASSERT_EQ(1, taken[i].load());
+            }
+        }
+
+        TEST(MpmcRing, FifoAndBounded)
+        {
+            MpmcRing<std::string> ring(3);
+            ASSERT_EQ(4u, ring.capacity());
+            for (int i = 0; i < 4; ++i)
+            {
+                ASSERT_TRUE(ring.TryPush(std::to_string(i)));
+            }
+            std::string extra = "x";
+            ASSERT_FALSE(ring.TryPush(std::move(extra)));
+            ASSERT_TRUE(extra == "x");
+            std::string out;
+            for (int i = 0; i < 4; ++i)
+            {
+                ASSERT_TRUE(ring.TryPop(&out));
+                ASSERT_TRUE(out == std::to_string(i));
+            }
+            ASSERT_FALSE(ring.TryPop(&out));
+            // Values left in the ring are destroyed with it
+            ASSERT_TRUE(ring.TryPush(std::string(100, 'y')));
+        }
+
+        TEST(MpmcRing, ConcurrentProducersAndConsumers)
+        {
+            constexpr int kPerProducer = 50000;
+            constexpr int kThreads = 2;
+            MpmcRing<int> ring(64);
+            std::atomic<int64_t> sum{0};
+            std::atomic<int> popped{0};
+            std::vector<std::thread> threads;
+            for (int t = 0; t < kThreads; ++t)
+            {
+                threads.emplace_back([&]
+                                     {
+                    for (int i = 1; i <= kPerProducer; ++i)
+                    {
+                        int value = i;
+                        while (!ring.TryPush(std::move(value)))
+                        {
+                            std::this_thread::yield();
+                        }
+                    } });
+                threads.emplace_back([&]
+                                     {
+                    int value;
+                    while (popped.load() < kThreads * kPerProducer)
+                    {
+                        if (ring.TryPop(&value))
+                        {
+                            sum.fetch_add(value);
+                            popped.fetch_add(1);
+                        }
+                    } });
+            }
+            for (auto &thread : threads)
+            {
+                thread.join();
+            }
+            ASSERT_EQ(int64_t{kThreads} * kPerProducer * (kPerProducer + 1) / 2, sum.load());
+        }
+    }
+}
+
+int main() { return arrow::testing::RunAllTests(); }